@@ -0,0 +1,363 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+#include "parser.h"
+#include "swwm.h"
+
+/*
+ * Headless benchmark mode (swwm -B script, or swwm_bench_run from libswwm).
+ *
+ * The script is a list of actions, one per line, '#' starts a comment:
+ *
+ *   output 1920x1080        add a headless output
+ *   client foot -e true     command spawned by `map` (one window per spawn)
+ *   settle 50               ms to run the event loop after each action
+ *   map 20                  spawn the client 20 times, wait for each to map
+ *   workspace 2 1           switch workspace (arguments are cycled)
+ *   move 3                  move focused window to workspace (cycled)
+ *   float                   toggle floating on the focused window
+ *   master + | master -     grow / shrink the master area
+ *   reload                  reload the config file
+ *   repeat 100 <action>     run an action 100 times
+ *
+ * For every action type we report p50/p99 of the time spent in the
+ * compositor handler, plus configures sent and frames committed during the
+ * action and its settle period. For `map` the latency is spawn to map.
+ */
+
+enum bench_action {
+	BENCH_MAP,
+	BENCH_WORKSPACE,
+	BENCH_MOVE,
+	BENCH_FLOAT,
+	BENCH_MASTER,
+	BENCH_RELOAD,
+	BENCH_ACTION_COUNT,
+};
+
+static const char *const bench_action_names[BENCH_ACTION_COUNT] = {
+	"map", "workspace", "move", "float", "master", "reload",
+};
+
+struct bench_series {
+	uint64_t *samples_ns;
+	size_t n, cap;
+	uint64_t configures;
+	uint64_t frames;
+};
+
+struct bench {
+	struct swwm_server *server;
+	struct wl_event_loop *loop;
+	struct bench_series series[BENCH_ACTION_COUNT];
+	const char **client_cmd;
+	struct config_arena client_arena; // Backs client_cmd
+	int settle_ms;
+	int lineno;
+};
+
+static void bench_pump(struct bench *b, int ms)
+{
+	uint64_t deadline = frame_stats_now_ns() + (uint64_t)ms * 1000000ull;
+	for (;;) {
+		wl_display_flush_clients(b->server->wl_display);
+		uint64_t now = frame_stats_now_ns();
+		if (now >= deadline) {
+			break;
+		}
+		wl_event_loop_dispatch(b->loop, (int)((deadline - now) / 1000000ull) + 1);
+	}
+}
+
+static uint64_t frames_committed(struct swwm_server *server)
+{
+	uint64_t total = 0;
+	struct swwm_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		total += output->wlr_output->commit_seq;
+	}
+	return total;
+}
+
+static void series_add(struct bench_series *s, uint64_t ns)
+{
+	if (s->n == s->cap) {
+		size_t cap = s->cap ? s->cap * 2 : 64;
+		uint64_t *samples = realloc(s->samples_ns, cap * sizeof(*samples));
+		if (!samples) {
+			return;
+		}
+		s->samples_ns = samples;
+		s->cap = cap;
+	}
+	s->samples_ns[s->n++] = ns;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t series_percentile(const struct bench_series *s, unsigned pct)
+{
+	size_t rank = (s->n * pct + 99) / 100; // nearest-rank, samples are sorted
+	return s->samples_ns[rank ? rank - 1 : 0];
+}
+
+static bool bench_map(struct bench *b, int count)
+{
+	if (!b->client_cmd) {
+		fprintf(stderr, "bench:%d: 'map' needs a 'client' command first\n", b->lineno);
+		return false;
+	}
+	struct swwm_server *server = b->server;
+	for (int i = 0; i < count; i++) {
+		uint64_t configures = server->configures_sent;
+		uint64_t frames = frames_committed(server);
+		uint64_t mapped = server->toplevels_mapped;
+		uint64_t start = frame_stats_now_ns();
+		uint64_t deadline = start + 10000000000ull;
+
+		spawn_swwm(server, b->client_cmd);
+		while (server->toplevels_mapped == mapped) {
+			uint64_t now = frame_stats_now_ns();
+			if (now >= deadline) {
+				fprintf(stderr, "bench:%d: client did not map a window within 10s\n", b->lineno);
+				return false;
+			}
+			wl_display_flush_clients(server->wl_display);
+			wl_event_loop_dispatch(b->loop, (int)((deadline - now) / 1000000ull) + 1);
+		}
+		uint64_t latency = frame_stats_now_ns() - start;
+		bench_pump(b, b->settle_ms);
+
+		struct bench_series *s = &b->series[BENCH_MAP];
+		series_add(s, latency);
+		s->configures += server->configures_sent - configures;
+		s->frames += frames_committed(server) - frames;
+	}
+	return true;
+}
+
+// Run a single handler-driven action and account for it
+static bool bench_action(struct bench *b, enum bench_action action, const char *arg)
+{
+	struct swwm_server *server = b->server;
+	uint64_t configures = server->configures_sent;
+	uint64_t frames = frames_committed(server);
+	uint64_t start = frame_stats_now_ns();
+
+	switch (action) {
+	case BENCH_WORKSPACE:
+		change_workspace_action(server, (void *)(intptr_t)(atoi(arg) - 1));
+		break;
+	case BENCH_MOVE:
+		move_to_workspace_action(server, (void *)(intptr_t)(atoi(arg) - 1));
+		break;
+	case BENCH_FLOAT:
+		toggle_floating_swwm(server, NULL);
+		break;
+	case BENCH_MASTER:
+		if (arg[0] == '-') {
+			resize_master_sub_swwm(server, NULL);
+		} else {
+			resize_master_add_swwm(server, NULL);
+		}
+		break;
+	case BENCH_RELOAD:
+		config_reload(server); // Synchronous, so the sample covers the parse
+		break;
+	default:
+		return false;
+	}
+
+	uint64_t latency = frame_stats_now_ns() - start;
+	bench_pump(b, b->settle_ms);
+
+	struct bench_series *s = &b->series[action];
+	series_add(s, latency);
+	s->configures += server->configures_sent - configures;
+	s->frames += frames_committed(server) - frames;
+	return true;
+}
+
+// Split `s` in place on whitespace
+static int split_args(char *s, char **argv, int max)
+{
+	int n = 0;
+	while (*s && n < max) {
+		while (isspace((unsigned char)*s)) {
+			s++;
+		}
+		if (!*s) {
+			break;
+		}
+		argv[n++] = s;
+		while (*s && !isspace((unsigned char)*s)) {
+			s++;
+		}
+		if (*s) {
+			*s++ = '\0';
+		}
+	}
+	return n;
+}
+
+static bool bench_line(struct bench *b, char *line)
+{
+	char *comment = strchr(line, '#');
+	if (comment) {
+		*comment = '\0';
+	}
+
+	char *rest = line;
+	while (isspace((unsigned char)*rest)) {
+		rest++;
+	}
+
+	// `client` takes the remainder of the line verbatim
+	if (!strncmp(rest, "client", 6) && isspace((unsigned char)rest[6])) {
+		char *cmd = rest + 7;
+		cmd[strcspn(cmd, "\r\n")] = '\0';
+		config_arena_release(&b->client_arena);
+		b->client_cmd = build_argv(&b->client_arena, cmd);
+		return b->client_cmd != NULL;
+	}
+
+	char *argv[32];
+	int argc = split_args(rest, argv, LENGTH(argv));
+	if (argc == 0) {
+		return true;
+	}
+
+	int repeat = 1;
+	if (!strcmp(argv[0], "repeat")) {
+		if (argc < 3 || (repeat = atoi(argv[1])) <= 0) {
+			fprintf(stderr, "bench:%d: usage: repeat <count> <action>\n", b->lineno);
+			return false;
+		}
+		memmove(argv, argv + 2, (argc - 2) * sizeof(*argv));
+		argc -= 2;
+	}
+
+	if (!strcmp(argv[0], "output")) {
+		int w, h;
+		if (argc < 2 || sscanf(argv[1], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+			fprintf(stderr, "bench:%d: usage: output <width>x<height>\n", b->lineno);
+			return false;
+		}
+		for (int i = 0; i < repeat; i++) {
+			if (!swwm_server_add_headless_output(b->server, w, h)) {
+				fprintf(stderr, "bench:%d: failed to add headless output\n", b->lineno);
+				return false;
+			}
+		}
+		bench_pump(b, b->settle_ms);
+		return true;
+	}
+	if (!strcmp(argv[0], "settle")) {
+		b->settle_ms = argc > 1 ? atoi(argv[1]) : 0;
+		if (b->settle_ms < 0) {
+			b->settle_ms = 0;
+		}
+		return true;
+	}
+	if (!strcmp(argv[0], "map")) {
+		int count = argc > 1 ? atoi(argv[1]) : 1;
+		for (int i = 0; i < repeat; i++) {
+			if (!bench_map(b, count)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	enum bench_action action = BENCH_ACTION_COUNT;
+	for (int i = BENCH_WORKSPACE; i < BENCH_ACTION_COUNT; i++) {
+		if (!strcmp(argv[0], bench_action_names[i])) {
+			action = i;
+			break;
+		}
+	}
+	if (action == BENCH_ACTION_COUNT) {
+		fprintf(stderr, "bench:%d: unknown action '%s'\n", b->lineno, argv[0]);
+		return false;
+	}
+	if ((action == BENCH_WORKSPACE || action == BENCH_MOVE || action == BENCH_MASTER) && argc < 2) {
+		fprintf(stderr, "bench:%d: '%s' needs an argument\n", b->lineno, argv[0]);
+		return false;
+	}
+
+	for (int i = 0; i < repeat; i++) {
+		// Cycle through the arguments so `repeat 100 workspace 1 2` flicks
+		const char *arg = argc > 1 ? argv[1 + i % (argc - 1)] : "";
+		bench_action(b, action, arg);
+	}
+	return true;
+}
+
+static void bench_report(struct bench *b, FILE *f)
+{
+	fprintf(f, "%-10s %7s %10s %10s %10s %13s %10s\n", "action", "count",
+		"p50_us", "p99_us", "max_us", "configures/op", "frames/op");
+	for (int i = 0; i < BENCH_ACTION_COUNT; i++) {
+		struct bench_series *s = &b->series[i];
+		if (s->n == 0) {
+			continue;
+		}
+		qsort(s->samples_ns, s->n, sizeof(*s->samples_ns), cmp_u64);
+		fprintf(f, "%-10s %7zu %10.1f %10.1f %10.1f %13.2f %10.2f\n",
+			bench_action_names[i], s->n,
+			series_percentile(s, 50) / 1000.0,
+			series_percentile(s, 99) / 1000.0,
+			s->samples_ns[s->n - 1] / 1000.0,
+			(double)s->configures / s->n,
+			(double)s->frames / s->n);
+	}
+}
+
+int swwm_bench_run(struct swwm_server *server, const char *script_path)
+{
+	FILE *script = fopen(script_path, "r");
+	if (!script) {
+		wlr_log_errno(WLR_ERROR, "cannot open benchmark script %s", script_path);
+		return 1;
+	}
+
+	struct bench b = {
+		.server = server,
+		.loop = wl_display_get_event_loop(server->wl_display),
+		.settle_ms = 50,
+	};
+
+	int ret = 0;
+	char *line = NULL;
+	size_t line_cap = 0;
+	while (getline(&line, &line_cap, script) != -1) {
+		b.lineno++;
+		if (!bench_line(&b, line)) {
+			ret = 1;
+			break;
+		}
+	}
+	free(line);
+	fclose(script);
+
+	if (ret == 0) {
+		bench_report(&b, stdout);
+	}
+
+	for (int i = 0; i < BENCH_ACTION_COUNT; i++) {
+		free(b.series[i].samples_ns);
+	}
+	config_arena_release(&b.client_arena);
+	return ret;
+}
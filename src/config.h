@@ -3,54 +3,81 @@
 #include <xkbcommon/xkbcommon-keysyms.h> // For XKB_KEY_*
 #include "defs.h" // Uses SWM_MOD_* now
 
+/*
+ * Built-in configuration. init_default_config starts from the options below
+ * and swwmrc overrides them; with `make STATIC_CONFIG=1` this file is the
+ * whole configuration (binds and window_rules included) and swwmrc is never
+ * read. Rebuild after editing, and `make clean` when switching modes.
+ */
+
+// Options
+#define CONFIG_MODKEY               SWM_MOD_LOGO
+#define CONFIG_GAPS                 10
+#define CONFIG_BORDER_WIDTH         1
+#define CONFIG_FOCUSED_COLOUR       0xFFFF0000 // AARRGGBB
+#define CONFIG_UNFOCUSED_COLOUR     0xFF888888
+#define CONFIG_SWAP_COLOUR          0xFFFFFF00
+#define CONFIG_MASTER_WIDTH         0.5f // Fraction of the output
+#define CONFIG_MOTION_THROTTLE_HZ   60
+#define CONFIG_RESIZE_MASTER_AMOUNT 5    // Percent
+#define CONFIG_SNAP_DISTANCE        10   // Pixels
+
 CMD(terminal, "st"); // Example, replace with your Wayland terminal e.g. "foot" or "kitty"
 CMD(browser, "firefox");
+CMD(menu, "dmenu_run"); // dmenu might need Wayland alternative like wofi or bemenu
+
+// Window rules, STATIC_CONFIG=1 only (swwmrc has its own); see rules.h
+const struct rule window_rules[] = {
+    { .match = { [RULE_APP_ID] = "st" }, .result = { .set = RULE_SET_FLOAT, .floating = true } },
+};
 
+// Keybinds, also used when swwmrc is missing or broken at startup. Unique
+// (mods, keysym) pairs; STATIC_CONFIG=1 checks that at build time
 const Binding binds[] = {
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_e, {.fn = quit_swwm}, TYPE_FUNC, NULL},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_q, {.fn = close_focused_swwm}, TYPE_FUNC, NULL},
-
-    {SWM_MOD_LOGO, XKB_KEY_j, {.fn = focus_next_swwm}, TYPE_FUNC, NULL},
-    {SWM_MOD_LOGO, XKB_KEY_k, {.fn = focus_prev_swwm}, TYPE_FUNC, NULL},
-
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_j, {.fn = move_master_next_swwm}, TYPE_FUNC, NULL}, // Move focused to next in stack
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_k, {.fn = move_master_prev_swwm}, TYPE_FUNC, NULL}, // Move focused to prev in stack / make master
-
-    {SWM_MOD_LOGO, XKB_KEY_l, {.fn = resize_master_add_swwm}, TYPE_FUNC, NULL},
-    {SWM_MOD_LOGO, XKB_KEY_h, {.fn = resize_master_sub_swwm}, TYPE_FUNC, NULL},
-
-    {SWM_MOD_LOGO, XKB_KEY_equal, {.fn = inc_gaps_swwm}, TYPE_FUNC, NULL},
-    {SWM_MOD_LOGO, XKB_KEY_minus, {.fn = dec_gaps_swwm}, TYPE_FUNC, NULL},
-
-    {SWM_MOD_LOGO, XKB_KEY_space, {.fn = toggle_floating_swwm}, TYPE_FUNC, NULL},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_space, {.fn = toggle_floating_global_swwm}, TYPE_FUNC, NULL},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_f, {.fn = toggle_fullscreen_swwm}, TYPE_FUNC, NULL},
-
-    {SWM_MOD_LOGO, XKB_KEY_Return, {.cmd = terminal}, TYPE_CMD, (void*)terminal},
-    {SWM_MOD_LOGO, XKB_KEY_b, {.cmd = browser}, TYPE_CMD, (void*)browser},
-    {SWM_MOD_LOGO, XKB_KEY_p, {.cmd = (const char *[]){"dmenu_run", NULL}}, TYPE_CMD, (void*)((const char *[]){"dmenu_run", NULL})}, // dmenu might need Wayland alternative like wofi or bemenu
-
-    {SWM_MOD_LOGO, XKB_KEY_r, {.fn = reload_config_swwm}, TYPE_FUNC, NULL},
-
-    {SWM_MOD_LOGO, XKB_KEY_1, {.ws = 0}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_1, {.ws = 0}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_2, {.ws = 1}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_2, {.ws = 1}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_3, {.ws = 2}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_3, {.ws = 2}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_4, {.ws = 3}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_4, {.ws = 3}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_5, {.ws = 4}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_5, {.ws = 4}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_6, {.ws = 5}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_6, {.ws = 5}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_7, {.ws = 6}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_7, {.ws = 6}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_8, {.ws = 7}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_8, {.ws = 7}, TYPE_MWKSP},
-    {SWM_MOD_LOGO, XKB_KEY_9, {.ws = 8}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_9, {.ws = 8}, TYPE_MWKSP},
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_e, .type = TYPE_FUNC, .action.fn = quit_swwm },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_q, .type = TYPE_FUNC, .action.fn = close_focused_swwm },
+
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_j, .type = TYPE_FUNC, .action.fn = focus_next_swwm },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_k, .type = TYPE_FUNC, .action.fn = focus_prev_swwm },
+
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_j, .type = TYPE_FUNC, .action.fn = move_master_next_swwm }, // Move focused to next in stack
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_k, .type = TYPE_FUNC, .action.fn = move_master_prev_swwm }, // Move focused to prev in stack / make master
+
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_l, .type = TYPE_FUNC, .action.fn = resize_master_add_swwm },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_h, .type = TYPE_FUNC, .action.fn = resize_master_sub_swwm },
+
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_equal, .type = TYPE_FUNC, .action.fn = inc_gaps_swwm },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_minus, .type = TYPE_FUNC, .action.fn = dec_gaps_swwm },
+
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_space, .type = TYPE_FUNC, .action.fn = toggle_floating_swwm },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_space, .type = TYPE_FUNC, .action.fn = toggle_floating_global_swwm },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_f, .type = TYPE_FUNC, .action.fn = toggle_fullscreen_swwm },
+
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_Return, .type = TYPE_CMD, .action.cmd = terminal, .arg = terminal },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_b, .type = TYPE_CMD, .action.cmd = browser, .arg = browser },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_p, .type = TYPE_CMD, .action.cmd = menu, .arg = menu },
+
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_r, .type = TYPE_FUNC, .action.fn = reload_config_swwm },
+
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_1, .type = TYPE_CWKSP, .action.ws = 0, .arg = (void *)0 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_1, .type = TYPE_MWKSP, .action.ws = 0, .arg = (void *)0 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_2, .type = TYPE_CWKSP, .action.ws = 1, .arg = (void *)1 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_2, .type = TYPE_MWKSP, .action.ws = 1, .arg = (void *)1 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_3, .type = TYPE_CWKSP, .action.ws = 2, .arg = (void *)2 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_3, .type = TYPE_MWKSP, .action.ws = 2, .arg = (void *)2 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_4, .type = TYPE_CWKSP, .action.ws = 3, .arg = (void *)3 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_4, .type = TYPE_MWKSP, .action.ws = 3, .arg = (void *)3 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_5, .type = TYPE_CWKSP, .action.ws = 4, .arg = (void *)4 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_5, .type = TYPE_MWKSP, .action.ws = 4, .arg = (void *)4 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_6, .type = TYPE_CWKSP, .action.ws = 5, .arg = (void *)5 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_6, .type = TYPE_MWKSP, .action.ws = 5, .arg = (void *)5 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_7, .type = TYPE_CWKSP, .action.ws = 6, .arg = (void *)6 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_7, .type = TYPE_MWKSP, .action.ws = 6, .arg = (void *)6 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_8, .type = TYPE_CWKSP, .action.ws = 7, .arg = (void *)7 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_8, .type = TYPE_MWKSP, .action.ws = 7, .arg = (void *)7 },
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_9, .type = TYPE_CWKSP, .action.ws = 8, .arg = (void *)8 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_9, .type = TYPE_MWKSP, .action.ws = 8, .arg = (void *)8 },
     // Workspace 10 example (0-indexed 9)
-    {SWM_MOD_LOGO, XKB_KEY_0, {.ws = 9}, TYPE_CWKSP},
-    {SWM_MOD_LOGO | SWM_MOD_SHIFT, XKB_KEY_0, {.ws = 9}, TYPE_MWKSP},
+    { .mods = SWM_MOD_LOGO, .keysym = XKB_KEY_0, .type = TYPE_CWKSP, .action.ws = 9, .arg = (void *)9 },
+    { .mods = SWM_MOD_LOGO | SWM_MOD_SHIFT, .keysym = XKB_KEY_0, .type = TYPE_MWKSP, .action.ws = 9, .arg = (void *)9 },
 };
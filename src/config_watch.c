@@ -0,0 +1,326 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+
+#include "frame_stats.h"
+#include "ipc.h"
+#include "parser.h"
+#include "swwm.h"
+
+/*
+ * The event loop owns the inotify fd and the debounce timer; the worker only
+ * parses. They share the request flag and the parsed result under
+ * watch->lock: the event loop wakes the worker with the condition variable,
+ * the worker wakes the event loop with an eventfd. The worker never touches
+ * server state, the parsed Config is applied on the event loop.
+ */
+
+struct swwm_config_watch {
+	struct swwm_server *server;
+	char path[PATH_MAX]; // swwmrc as resolved at startup
+	const char *name;    // Its basename, matched against inotify events
+	int inotify_fd;
+	int wd;       // The one directory watched, see config_watch_dir
+	bool own_dir; // wd is path's directory, not an ancestor waiting for it
+	int done_fd; // eventfd, worker -> event loop: a parse finished
+	struct wl_event_source *inotify_source;
+	struct wl_event_source *debounce_timer;
+	struct wl_event_source *done_source;
+
+	pthread_t thread;
+	pthread_mutex_t lock; // Guards the fields below
+	pthread_cond_t cond;
+	bool requested; // Reload asked for since the worker last started one
+	bool stop;
+	bool result_ready;
+	Config *result; // NULL if the parse failed
+	uint64_t parse_ns;
+};
+
+static void *config_watch_worker(void *data)
+{
+	struct swwm_config_watch *watch = data;
+
+	pthread_mutex_lock(&watch->lock);
+	for (;;) {
+		while (!watch->requested && !watch->stop) {
+			pthread_cond_wait(&watch->cond, &watch->lock);
+		}
+		if (watch->stop) {
+			break;
+		}
+		watch->requested = false;
+		pthread_mutex_unlock(&watch->lock);
+
+		uint64_t start = frame_stats_now_ns();
+		Config *next = malloc(sizeof(*next));
+		if (next) {
+			init_default_config(next);
+			// The watched file, not whatever config_find_path would pick now
+			if (parse_config_file(watch->path, next) != 0) {
+				config_free(next);
+				free(next);
+				next = NULL;
+			}
+		}
+		uint64_t parse_ns = frame_stats_now_ns() - start;
+
+		pthread_mutex_lock(&watch->lock);
+		// A newer parse replaces one the event loop has not picked up yet
+		if (watch->result) {
+			config_free(watch->result);
+			free(watch->result);
+		}
+		watch->result = next;
+		watch->result_ready = true;
+		watch->parse_ns = parse_ns;
+		eventfd_write(watch->done_fd, 1);
+	}
+	pthread_mutex_unlock(&watch->lock);
+	return NULL;
+}
+
+static int config_watch_handle_done(int fd, uint32_t mask, void *data)
+{
+	struct swwm_config_watch *watch = data;
+	eventfd_t count;
+	eventfd_read(fd, &count);
+
+	pthread_mutex_lock(&watch->lock);
+	bool ready = watch->result_ready;
+	Config *next = watch->result;
+	uint64_t parse_ns = watch->parse_ns;
+	watch->result_ready = false;
+	watch->result = NULL;
+	pthread_mutex_unlock(&watch->lock);
+
+	if (!ready) {
+		return 0;
+	}
+	if (!next) {
+		wlr_log(WLR_ERROR, "Failed to parse config file, keeping the current config.");
+		ipc_event_config(watch->server, false);
+		return 0;
+	}
+	wlr_log(WLR_DEBUG, "Config parsed in %.3f ms on the reload worker", parse_ns / 1e6);
+	config_reload_apply(watch->server, next);
+	return 0;
+}
+
+static int config_watch_handle_debounce(void *data)
+{
+	struct swwm_config_watch *watch = data;
+	wlr_log(WLR_INFO, "%s changed, reloading config", watch->path);
+	config_watch_request(watch->server);
+	return 0;
+}
+
+#define CONFIG_WATCH_EVENTS (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE)
+
+// Watch the directory, not the file: editors save by renaming a new file
+// over it and config managers swap symlinks, either of which would leave
+// a watch on the old inode behind. While the directory does not exist, its
+// nearest existing ancestor is watched instead and the watch moves down as
+// directories are created.
+static bool config_watch_dir(struct swwm_config_watch *watch)
+{
+	char dir[PATH_MAX];
+	snprintf(dir, sizeof(dir), "%s", watch->path);
+	bool own = true;
+	for (;;) {
+		char *slash = strrchr(dir, '/');
+		if (!slash) {
+			return false;
+		}
+		if (slash == dir) {
+			slash[1] = '\0'; // "/swwmrc"
+		} else {
+			*slash = '\0';
+		}
+		int wd = inotify_add_watch(watch->inotify_fd, dir, CONFIG_WATCH_EVENTS);
+		if (wd >= 0) {
+			if (watch->wd >= 0 && watch->wd != wd) {
+				inotify_rm_watch(watch->inotify_fd, watch->wd);
+			}
+			watch->wd = wd;
+			watch->own_dir = own;
+			if (!own) {
+				wlr_log(WLR_INFO, "config watch: %s has no directory yet, watching %s", watch->path, dir);
+			}
+			return true;
+		}
+		if (errno != ENOENT || slash == dir) {
+			wlr_log_errno(WLR_ERROR, "config watch: cannot watch %s", dir);
+			return false;
+		}
+		own = false;
+	}
+}
+
+static int config_watch_handle_inotify(int fd, uint32_t mask, void *data)
+{
+	struct swwm_config_watch *watch = data;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false, rewatch = false;
+
+	ssize_t len;
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + len; ) {
+			const struct inotify_event *event = (const struct inotify_event *)p;
+			if (event->mask & IN_Q_OVERFLOW) {
+				changed = true;
+				rewatch |= !watch->own_dir;
+			} else if (event->wd != watch->wd) {
+				// A watch given up in config_watch_dir
+			} else if (event->mask & IN_IGNORED) {
+				rewatch = true; // The watched directory was removed
+			} else if (!watch->own_dir) {
+				// An ancestor: only a new directory can be the next step down
+				rewatch |= (event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO));
+			} else if (event->len && !strcmp(event->name, watch->name)) {
+				changed = true;
+			}
+			p += sizeof(*event) + event->len;
+		}
+	}
+	if (rewatch) {
+		bool was_own = watch->own_dir;
+		if (!config_watch_dir(watch)) {
+			watch->wd = -1;
+			watch->own_dir = false;
+		}
+		// The file may have been written before the watch got there
+		if (watch->own_dir && !was_own && access(watch->path, F_OK) == 0) {
+			changed = true;
+		}
+	}
+	if (changed) {
+		// A save is often several events (write, close, rename); restart
+		// the timer on each so the file is parsed once, after the last
+		wl_event_source_timer_update(watch->debounce_timer, CONFIG_WATCH_DEBOUNCE_MS);
+	}
+	return 0;
+}
+
+void config_watch_request(struct swwm_server *server)
+{
+	struct swwm_config_watch *watch = server->config_watch;
+	pthread_mutex_lock(&watch->lock);
+	watch->requested = true;
+	pthread_cond_signal(&watch->cond);
+	pthread_mutex_unlock(&watch->lock);
+}
+
+bool config_watch_start(struct swwm_server *server)
+{
+	struct swwm_config_watch *watch = calloc(1, sizeof(*watch));
+	if (!watch) {
+		return false;
+	}
+	watch->server = server;
+	watch->inotify_fd = watch->done_fd = watch->wd = -1;
+	pthread_mutex_init(&watch->lock, NULL);
+	pthread_cond_init(&watch->cond, NULL);
+
+	if (!config_find_path(watch->path, sizeof(watch->path))) {
+		// No config yet: watch where parser() looks first, so creating it
+		// (and its directory) loads it
+		const char *xdg_config_home = getenv("XDG_CONFIG_HOME");
+		const char *home = getenv("HOME");
+		if (xdg_config_home) {
+			snprintf(watch->path, sizeof(watch->path), "%s/swwm/swwmrc", xdg_config_home);
+		} else if (home) {
+			snprintf(watch->path, sizeof(watch->path), "%s/.config/swwm/swwmrc", home);
+		} else {
+			wlr_log(WLR_ERROR, "config watch: HOME not set, nothing to watch");
+			goto error;
+		}
+	}
+
+	if (!strchr(watch->path, '/')) {
+		goto error;
+	}
+	watch->name = strrchr(watch->path, '/') + 1;
+
+	watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	watch->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (watch->inotify_fd < 0 || watch->done_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "config watch: failed to create fds");
+		goto error;
+	}
+	if (!config_watch_dir(watch)) {
+		goto error;
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(server->wl_display);
+	watch->inotify_source = wl_event_loop_add_fd(loop, watch->inotify_fd, WL_EVENT_READABLE,
+		config_watch_handle_inotify, watch);
+	watch->done_source = wl_event_loop_add_fd(loop, watch->done_fd, WL_EVENT_READABLE,
+		config_watch_handle_done, watch);
+	watch->debounce_timer = wl_event_loop_add_timer(loop, config_watch_handle_debounce, watch);
+	// The worker inherits our mask, and the event loop only blocks the
+	// signals it handles later on: block everything so SIGCHLD and the
+	// reload signals are never delivered to the worker.
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&watch->thread, NULL, config_watch_worker, watch);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		wlr_log(WLR_ERROR, "config watch: failed to start worker thread");
+		wl_event_source_remove(watch->inotify_source);
+		wl_event_source_remove(watch->done_source);
+		wl_event_source_remove(watch->debounce_timer);
+		goto error;
+	}
+
+	server->config_watch = watch;
+	wlr_log(WLR_INFO, "Watching %s for changes", watch->path);
+	return true;
+
+error:
+	if (watch->inotify_fd >= 0) close(watch->inotify_fd);
+	if (watch->done_fd >= 0) close(watch->done_fd);
+	pthread_cond_destroy(&watch->cond);
+	pthread_mutex_destroy(&watch->lock);
+	free(watch);
+	return false;
+}
+
+void config_watch_stop(struct swwm_server *server)
+{
+	struct swwm_config_watch *watch = server->config_watch;
+	if (!watch) {
+		return;
+	}
+	// An in-flight parse is finished (and dropped below) before the join returns
+	pthread_mutex_lock(&watch->lock);
+	watch->stop = true;
+	pthread_cond_signal(&watch->cond);
+	pthread_mutex_unlock(&watch->lock);
+	pthread_join(watch->thread, NULL);
+
+	wl_event_source_remove(watch->inotify_source);
+	wl_event_source_remove(watch->done_source);
+	wl_event_source_remove(watch->debounce_timer);
+	close(watch->inotify_fd);
+	close(watch->done_fd);
+	if (watch->result) {
+		config_free(watch->result);
+		free(watch->result);
+	}
+	pthread_cond_destroy(&watch->cond);
+	pthread_mutex_destroy(&watch->lock);
+	free(watch);
+	server->config_watch = NULL;
+}
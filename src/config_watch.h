@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+
+struct swwm_server;
+
+// Automatic config reload (config_watch.c). The directory holding swwmrc is
+// watched with inotify from the event loop; a change to the file (written in
+// place, or replaced by rename or a new symlink, as editors and config
+// managers do) arms a debounce timer. When it fires, a worker thread parses
+// the file into a fresh Config, which the event loop then applies with
+// config_reload_apply. A slow or huge config never stalls frames or input.
+
+#define CONFIG_WATCH_DEBOUNCE_MS 100
+
+bool config_watch_start(struct swwm_server *server);
+void config_watch_stop(struct swwm_server *server);
+// Queue a reload on the worker, e.g. from the reload_config bind
+void config_watch_request(struct swwm_server *server);
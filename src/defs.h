@@ -7,7 +7,7 @@
 #include <wlr/types/wlr_box.h>          // For wlr_box
 #include <wlr/types/wlr_keyboard.h>     // For wlr_keyboard_modifiers definition
 
-extern const Binding binds[];
+#include "rules.h"
 
 // Forward declarations from swwm.c
 struct swwm_server;
@@ -55,6 +55,18 @@ typedef struct {
     const void *arg; // Optional argument for functions (e.g. for spawn)
 } Binding;
 
+extern const Binding binds[];             // Built-in, config.h
+extern const struct rule window_rules[]; // Built-in, config.h
+
+// Memory a Config points into (bind argvs, window rules), bump
+// allocated and released in one call, see parser.c
+struct config_arena_block;
+struct config_arena {
+    struct config_arena_block *blocks;
+    size_t used;     // Bytes handed out
+    size_t reserved; // Bytes in blocks
+};
+
 // Configuration structure
 typedef struct {
     uint32_t modkey;       // Default modifier (e.g., SWM_MOD_LOGO)
@@ -70,11 +82,22 @@ typedef struct {
     int resize_master_amt;            // Percentage to resize master by
     int snap_distance;                // For floating windows (visuals not fully implemented)
 
+    // Per-output scale ("output_scale : eDP-1 1.5"), fractional values allowed
+    struct {
+        char name[64];
+        float scale;
+    } output_scales[MAX_MONITORS];
+    int output_scalesn;
+
     Binding binds[256]; // Max bindings
     int bindsn;         // Number of active bindings
 
-    char **should_float[256]; // app_id patterns that should float
-    int should_floatn;
+    struct rule *rules;      // Window rules in file order, see rules.h
+    struct rule *rules_last; // Tail, for appending while parsing
+    int rulesn;
+    struct rule_matcher *matcher; // rules compiled, NULL if there are none
+
+    struct config_arena arena; // Owns the argvs, rules and matcher tables above
 } Config;
 
 
@@ -108,6 +131,13 @@ void toggle_fullscreen_swwm(struct swwm_server *server, const void *arg);
 void reload_config_swwm(struct swwm_server *server, const void *arg);
 void spawn_swwm(struct swwm_server *server, const void *arg_cmd_array);
 
+// Config reload (swwm.c). config_reload parses on the calling thread;
+// config_reload_apply applies a parsed Config to the running server and
+// takes ownership of it.
+void init_default_config(Config *config);
+void config_reload(struct swwm_server *server);
+void config_reload_apply(struct swwm_server *server, Config *next);
+
 // Internal functions not directly in call_table but used by bindings
 void change_workspace_action(struct swwm_server *server, const void *arg_ws_idx);
 void move_to_workspace_action(struct swwm_server *server, const void *arg_ws_idx);
@@ -122,5 +152,3 @@ struct swwm_output *get_focused_output(struct swwm_server *server);
 #define WORKSPACE_NAMES "1\0" "2\0" "3\0" "4\0" "5\0" "6\0" "7\0" "8\0" "9\0" "10\0"
 #define MF_MIN 0.05f
 #define MF_MAX 0.95f
-
-#endif // DEFS_H
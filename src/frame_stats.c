@@ -0,0 +1,116 @@
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <time.h>
+
+#include "frame_stats.h"
+
+uint64_t frame_stats_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void frame_stats_reset_missed(struct frame_stats *st)
+{
+	memset(st->missed, 0, sizeof(st->missed));
+	st->missed_total = 0;
+	st->last_frame_ns = 0;
+}
+
+static int bucket_for(uint64_t us)
+{
+	if (us == 0) {
+		return 0;
+	}
+	int b = 64 - __builtin_clzll(us); // 1us -> 1, 2-3us -> 2, 4-7us -> 3 ...
+	return b < FRAME_STATS_BUCKETS ? b : FRAME_STATS_BUCKETS - 1;
+}
+
+void frame_histogram_add(struct frame_histogram *h, uint64_t us)
+{
+	h->buckets[bucket_for(us)]++;
+	h->count++;
+	h->sum_us += us;
+	if (us > h->max_us) {
+		h->max_us = us;
+	}
+}
+
+void frame_stats_record(struct frame_stats *st, uint64_t frame_start_ns,
+		uint64_t commit_ns, int refresh_mhz, bool committed)
+{
+	st->frames++;
+	if (committed) {
+		frame_histogram_add(&st->commit, commit_ns / 1000);
+	}
+
+	if (st->last_frame_ns != 0 && frame_start_ns > st->last_frame_ns) {
+		uint64_t interval_ns = frame_start_ns - st->last_frame_ns;
+		frame_histogram_add(&st->interval, interval_ns / 1000);
+
+		if (refresh_mhz > 0) {
+			uint64_t period_ns = 1000000000000ull / (uint64_t)refresh_mhz;
+			// Round to the nearest whole refresh so scheduling jitter does
+			// not register as a miss
+			uint64_t periods = (interval_ns + period_ns / 2) / period_ns;
+			uint64_t missed = periods > 1 ? periods - 1 : 0;
+			st->missed[missed < FRAME_STATS_MISSED_BUCKETS ? missed : FRAME_STATS_MISSED_BUCKETS - 1]++;
+			st->missed_total += missed;
+		}
+	}
+	// Nothing to draw: the output goes idle and no frame is scheduled until
+	// new damage, so the gap to the next frame is not a miss
+	st->last_frame_ns = committed ? frame_start_ns : 0;
+}
+
+// Upper bound of the bucket containing the given percentile
+uint64_t frame_histogram_percentile(const struct frame_histogram *h, unsigned pct)
+{
+	if (h->count == 0) {
+		return 0;
+	}
+	uint64_t target = (h->count * pct + 99) / 100;
+	uint64_t seen = 0;
+	for (int i = 0; i < FRAME_STATS_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target) {
+			uint64_t upper = i == 0 ? 1 : 1ull << i;
+			return upper < h->max_us ? upper : h->max_us;
+		}
+	}
+	return h->max_us;
+}
+
+void frame_histogram_dump(const struct frame_histogram *h, const char *label, FILE *f)
+{
+	fprintf(f, "  %s: n=%llu avg=%lluus p50<=%lluus p99<=%lluus max=%lluus\n", label,
+		(unsigned long long)h->count,
+		(unsigned long long)(h->count ? h->sum_us / h->count : 0),
+		(unsigned long long)frame_histogram_percentile(h, 50),
+		(unsigned long long)frame_histogram_percentile(h, 99),
+		(unsigned long long)h->max_us);
+	for (int i = 0; i < FRAME_STATS_BUCKETS; i++) {
+		if (!h->buckets[i]) {
+			continue;
+		}
+		uint64_t lo = i == 0 ? 0 : 1ull << (i - 1);
+		uint64_t hi = i == 0 ? 1 : 1ull << i;
+		fprintf(f, "    [%8llu, %8llu) us %llu\n", (unsigned long long)lo,
+			(unsigned long long)hi, (unsigned long long)h->buckets[i]);
+	}
+}
+
+void frame_stats_dump(const struct frame_stats *st, const char *name, FILE *f)
+{
+	fprintf(f, "output %s: frames=%llu missed_refreshes=%llu\n", name,
+		(unsigned long long)st->frames, (unsigned long long)st->missed_total);
+	frame_histogram_dump(&st->commit, "commit", f);
+	frame_histogram_dump(&st->interval, "interval", f);
+	fprintf(f, "  missed per frame:");
+	for (int i = 0; i < FRAME_STATS_MISSED_BUCKETS; i++) {
+		fprintf(f, " %d%s=%llu", i, i == FRAME_STATS_MISSED_BUCKETS - 1 ? "+" : "",
+			(unsigned long long)st->missed[i]);
+	}
+	fprintf(f, "\n");
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Per-output frame timing, recorded from output_frame.
+// Histograms use fixed power-of-two microsecond buckets so recording is a
+// couple of integer ops with no allocation; everything runs on the event
+// loop thread, so there is a single writer and no locking.
+
+#define FRAME_STATS_BUCKETS 24 // [0,1us) [1,2us) [2,4us) ... up to ~8s
+#define FRAME_STATS_MISSED_BUCKETS 8 // 0, 1, 2, ... 7+ refreshes missed per frame
+
+struct frame_histogram {
+	uint64_t buckets[FRAME_STATS_BUCKETS];
+	uint64_t count;
+	uint64_t sum_us;
+	uint64_t max_us;
+};
+
+struct frame_stats {
+	struct frame_histogram commit;   // Time spent in wlr_scene_output_commit
+	struct frame_histogram interval; // Time between consecutive frame events
+	uint64_t missed[FRAME_STATS_MISSED_BUCKETS]; // Refreshes skipped between frames
+	uint64_t missed_total;
+	uint64_t frames;
+	uint64_t last_frame_ns; // Start of the previous frame, 0 before the first or when idle
+};
+
+uint64_t frame_stats_now_ns(void);
+// Clears the missed-refresh counters, which only make sense against one
+// refresh rate; the timing histograms are kept
+void frame_stats_reset_missed(struct frame_stats *st);
+// frame_start_ns: when the frame event was handled, commit_ns: commit duration,
+// refresh_mhz: output refresh rate (0 if unknown, disables missed accounting),
+// committed: whether the frame drew anything (false skips the commit sample
+// and ends the busy period)
+void frame_stats_record(struct frame_stats *st, uint64_t frame_start_ns,
+		uint64_t commit_ns, int refresh_mhz, bool committed);
+void frame_stats_dump(const struct frame_stats *st, const char *name, FILE *f);
+
+// The histogram itself, for other timings that want the same buckets
+void frame_histogram_add(struct frame_histogram *h, uint64_t us);
+// Upper bound (us) of the bucket holding the given percentile
+uint64_t frame_histogram_percentile(const struct frame_histogram *h, unsigned pct);
+void frame_histogram_dump(const struct frame_histogram *h, const char *label, FILE *f);
@@ -0,0 +1,189 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+#include "input_record.h"
+#include "swwm.h"
+
+#define REPLAY_SETTLE_MS 500 // Let startup clients map before replaying
+
+struct input_recorder {
+	FILE *f;
+	uint64_t count;
+};
+
+struct input_recorder *input_recorder_create(const char *path)
+{
+	struct input_recorder *rec = calloc(1, sizeof(*rec));
+	if (!rec) {
+		return NULL;
+	}
+	rec->f = fopen(path, "wb");
+	if (!rec->f) {
+		wlr_log_errno(WLR_ERROR, "cannot open input recording %s", path);
+		free(rec);
+		return NULL;
+	}
+	// Events are small and frequent; let stdio batch the writes
+	setvbuf(rec->f, NULL, _IOFBF, 1 << 16);
+	fwrite(INPUT_RECORD_MAGIC, 1, strlen(INPUT_RECORD_MAGIC), rec->f);
+	return rec;
+}
+
+void input_recorder_destroy(struct input_recorder *rec)
+{
+	if (!rec) {
+		return;
+	}
+	wlr_log(WLR_INFO, "Recorded %llu input events", (unsigned long long)rec->count);
+	fclose(rec->f);
+	free(rec);
+}
+
+void input_recorder_add(struct input_recorder *rec, enum input_record_type type,
+		uint32_t time_msec, uint32_t code, bool state, double x, double y)
+{
+	struct input_record r = {
+		.type = (uint8_t)type,
+		.state = state,
+		.time_msec = time_msec,
+		.code = code,
+		.x = (float)x,
+		.y = (float)y,
+	};
+	if (fwrite(&r, sizeof(r), 1, rec->f) == 1) {
+		rec->count++;
+	}
+}
+
+bool swwm_record_start(struct swwm_server *server, const char *path)
+{
+	if (server->recorder) {
+		return false;
+	}
+	server->recorder = input_recorder_create(path);
+	if (!server->recorder) {
+		return false;
+	}
+	// Replay recreates the same output sizes on the headless backend
+	struct swwm_output *output;
+	wl_list_for_each_reverse(output, &server->outputs, link) {
+		input_recorder_add(server->recorder, INPUT_REC_OUTPUT, 0,
+			(uint32_t)output->wlr_output->width << 16 | (uint32_t)(output->wlr_output->height & 0xffff),
+			false, 0, 0);
+	}
+	return true;
+}
+
+void swwm_record_stop(struct swwm_server *server)
+{
+	input_recorder_destroy(server->recorder);
+	server->recorder = NULL;
+}
+
+// Runs the event loop until the monotonic deadline
+static void replay_wait_until(struct swwm_server *server, uint64_t deadline)
+{
+	uint64_t now;
+	while ((now = frame_stats_now_ns()) < deadline) {
+		swwm_server_dispatch(server, (int)((deadline - now) / 1000000ull) + 1);
+	}
+}
+
+static const char *const record_type_names[INPUT_REC_TYPE_COUNT] = {
+	"output", "key", "motion", "motion_abs", "button", "axis", "frame",
+};
+
+int swwm_replay_run(struct swwm_server *server, const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		wlr_log_errno(WLR_ERROR, "cannot open input recording %s", path);
+		return 1;
+	}
+	char magic[sizeof(INPUT_RECORD_MAGIC) - 1];
+	if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+			memcmp(magic, INPUT_RECORD_MAGIC, sizeof(magic)) != 0) {
+		wlr_log(WLR_ERROR, "%s is not an swwm input recording", path);
+		fclose(f);
+		return 1;
+	}
+
+	struct frame_histogram timings[INPUT_REC_TYPE_COUNT] = {0};
+	bool settled = false;
+	bool started = false; // first_msec and start_ns are set
+	uint32_t first_msec = 0;
+	uint64_t start_ns = 0;
+	uint64_t events = 0;
+	struct input_record r;
+
+	while (fread(&r, sizeof(r), 1, f) == 1) {
+		if (r.type >= INPUT_REC_TYPE_COUNT) {
+			wlr_log(WLR_ERROR, "%s: bad record type %u after %llu events", path,
+				r.type, (unsigned long long)events);
+			break;
+		}
+		if (r.type == INPUT_REC_OUTPUT) {
+			swwm_server_add_headless_output(server, (int)(r.code >> 16), (int)(r.code & 0xffff));
+			continue;
+		}
+		if (!settled) {
+			replay_wait_until(server, frame_stats_now_ns() + REPLAY_SETTLE_MS * 1000000ull);
+			settled = true;
+		}
+
+		// Pace events by their recorded deltas so clients get the same time
+		// to react between them. Frame records carry no timestamp of their own.
+		if (r.type != INPUT_REC_FRAME) {
+			if (!started) {
+				first_msec = r.time_msec;
+				start_ns = frame_stats_now_ns();
+				started = true;
+			}
+			// Unsigned difference: time_msec wraps after ~49 days
+			replay_wait_until(server, start_ns + (uint64_t)(uint32_t)(r.time_msec - first_msec) * 1000000ull);
+		}
+
+		// Handlers such as the motion throttle still see exactly the
+		// timestamps they saw when recording
+		uint64_t start = frame_stats_now_ns();
+		switch (r.type) {
+		case INPUT_REC_KEY:
+			swwm_inject_key(server, r.time_msec, r.code, r.state);
+			break;
+		case INPUT_REC_MOTION:
+			swwm_inject_motion(server, r.time_msec, r.x, r.y);
+			break;
+		case INPUT_REC_MOTION_ABSOLUTE:
+			swwm_inject_motion_absolute(server, r.time_msec, r.x, r.y);
+			break;
+		case INPUT_REC_BUTTON:
+			swwm_inject_button(server, r.time_msec, r.code, r.state);
+			break;
+		case INPUT_REC_AXIS:
+			swwm_inject_axis(server, r.time_msec, r.state, r.x, (int32_t)r.code);
+			break;
+		case INPUT_REC_FRAME:
+			swwm_inject_frame(server);
+			break;
+		}
+		frame_histogram_add(&timings[r.type], (frame_stats_now_ns() - start) / 1000);
+		events++;
+
+		// Flush what the event produced (configures) before the next wait
+		swwm_server_dispatch(server, 0);
+	}
+	fclose(f);
+
+	printf("replayed %llu input events from %s\n", (unsigned long long)events, path);
+	for (int i = INPUT_REC_KEY; i < INPUT_REC_TYPE_COUNT; i++) {
+		if (timings[i].count) {
+			frame_histogram_dump(&timings[i], record_type_names[i], stdout);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+struct swwm_server;
+
+// Input recording (-R) and replay (-P). Every key, motion, button, axis and
+// frame event swwm handles is appended to a compact binary file; replay feeds
+// the file back through the same handlers on the headless backend.
+
+#define INPUT_RECORD_MAGIC "SWWMREC1"
+
+enum input_record_type {
+	INPUT_REC_OUTPUT, // code = width << 16 | height, outputs present while recording
+	INPUT_REC_KEY,    // code = evdev keycode, state = pressed
+	INPUT_REC_MOTION, // x, y = delta
+	INPUT_REC_MOTION_ABSOLUTE, // x, y = 0..1 layout coordinates
+	INPUT_REC_BUTTON, // code = BTN_*, state = pressed
+	INPUT_REC_AXIS,   // code = discrete delta, state = horizontal, x = delta
+	INPUT_REC_FRAME,
+	INPUT_REC_TYPE_COUNT,
+};
+
+// On-disk record, host byte order, 20 bytes
+struct input_record {
+	uint8_t type;
+	uint8_t state;
+	uint16_t reserved;
+	uint32_t time_msec; // Event timestamp as delivered by the backend
+	uint32_t code;
+	float x, y;
+};
+
+struct input_recorder;
+
+struct input_recorder *input_recorder_create(const char *path);
+void input_recorder_destroy(struct input_recorder *rec);
+void input_recorder_add(struct input_recorder *rec, enum input_record_type type,
+		uint32_t time_msec, uint32_t code, bool state, double x, double y);
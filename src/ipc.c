@@ -0,0 +1,608 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/log.h>
+
+#include "ipc.h"
+#include "parser.h"
+#include "swwm.h"
+#include "trace.h"
+
+/*
+ * Everything runs on the event loop. A client's requests are handled as
+ * soon as a whole frame is in; replies and events are queued on the client
+ * and written as the socket accepts them, so a slow bar never stalls the
+ * compositor, and one that stops reading altogether is dropped at
+ * IPC_MAX_PENDING.
+ */
+
+struct ipc_buf {
+	char *data;
+	size_t len, cap;
+};
+
+struct ipc_client {
+	struct wl_list link; // swwm_ipc::clients
+	struct swwm_ipc *ipc;
+	int fd;
+	struct wl_event_source *source;
+	uint32_t events; // IPC_EVENT_* subscribed to
+	bool dispatching; // In its own request handler, freed by that on return
+	bool dead; // Write failed or overflowed; freed once not dispatching
+	uint8_t in[IPC_HEADER_SIZE + IPC_MAX_PAYLOAD];
+	size_t in_len;
+	struct ipc_buf out;
+};
+
+struct swwm_ipc {
+	struct swwm_server *server;
+	int listen_fd;
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	struct wl_event_source *listen_source;
+	struct wl_list clients; // ipc_client::link
+	uint32_t subscribed; // Union of the clients' events
+	struct ipc_buf scratch; // Reply or event being formatted
+};
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool buf_reserve(struct ipc_buf *b, size_t n)
+{
+	if (b->len + n <= b->cap) {
+		return true;
+	}
+	size_t cap = b->cap ? b->cap : 1024;
+	while (cap < b->len + n) {
+		cap *= 2;
+	}
+	char *data = realloc(b->data, cap);
+	if (!data) {
+		return false;
+	}
+	b->data = data;
+	b->cap = cap;
+	return true;
+}
+
+static void buf_append(struct ipc_buf *b, const void *data, size_t n)
+{
+	if (buf_reserve(b, n)) {
+		memcpy(b->data + b->len, data, n);
+		b->len += n;
+	}
+}
+
+static void buf_printf(struct ipc_buf *b, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	int n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n < 0 || !buf_reserve(b, (size_t)n + 1)) {
+		return;
+	}
+	va_start(ap, fmt);
+	vsnprintf(b->data + b->len, (size_t)n + 1, fmt, ap);
+	va_end(ap);
+	b->len += (size_t)n;
+}
+
+// A string field: tabs and newlines would split the record
+static void buf_field(struct ipc_buf *b, const char *s)
+{
+	size_t start = b->len;
+	buf_append(b, s ? s : "", s ? strlen(s) : 0);
+	for (size_t i = start; i < b->len; i++) {
+		if (b->data[i] == '\t' || b->data[i] == '\n') {
+			b->data[i] = ' ';
+		}
+	}
+}
+
+// --- Clients ---
+
+static void ipc_update_subscribed(struct swwm_ipc *ipc)
+{
+	ipc->subscribed = 0;
+	struct ipc_client *client;
+	wl_list_for_each(client, &ipc->clients, link) {
+		if (!client->dead) {
+			ipc->subscribed |= client->events;
+		}
+	}
+}
+
+static void client_destroy(struct ipc_client *client)
+{
+	struct swwm_ipc *ipc = client->ipc;
+	wl_list_remove(&client->link);
+	wl_event_source_remove(client->source);
+	close(client->fd);
+	free(client->out.data);
+	free(client);
+	ipc_update_subscribed(ipc);
+}
+
+static void client_flush(struct ipc_client *client)
+{
+	size_t off = 0;
+	while (off < client->out.len) {
+		ssize_t n = send(client->fd, client->out.data + off, client->out.len - off, MSG_NOSIGNAL);
+		if (n > 0) {
+			off += (size_t)n;
+		} else if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else {
+			client->dead = true;
+			break;
+		}
+	}
+	memmove(client->out.data, client->out.data + off, client->out.len - off);
+	client->out.len -= off;
+	if (client->out.len > IPC_MAX_PENDING) {
+		wlr_log(WLR_ERROR, "ipc: dropping a client that stopped reading");
+		client->dead = true;
+	}
+	if (!client->dead) {
+		// Only wait for writability while something is queued
+		wl_event_source_fd_update(client->source,
+			WL_EVENT_READABLE | (client->out.len ? WL_EVENT_WRITABLE : 0));
+	}
+}
+
+static void client_send(struct ipc_client *client, uint32_t type, const struct ipc_buf *payload)
+{
+	if (client->dead) {
+		return;
+	}
+	uint8_t header[IPC_HEADER_SIZE];
+	put32(header, (uint32_t)payload->len);
+	put32(header + 4, type);
+	size_t len = client->out.len;
+	buf_append(&client->out, header, sizeof(header));
+	buf_append(&client->out, payload->data, payload->len);
+	if (client->out.len != len + sizeof(header) + payload->len) {
+		client->dead = true; // Out of memory, the stream would be corrupt
+		return;
+	}
+	client_flush(client);
+}
+
+// --- Queries ---
+
+static void format_toplevel(struct ipc_buf *b, struct swwm_toplevel *toplevel)
+{
+	struct swwm_server *server = toplevel->server;
+	buf_printf(b, "%u\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t", toplevel->id, toplevel->ws_idx + 1,
+		toplevel->floating, toplevel->fullscreen, toplevel == server->focused_toplevel,
+		toplevel->geom.x, toplevel->geom.y, toplevel->geom.width, toplevel->geom.height);
+	buf_field(b, toplevel->xdg_toplevel->app_id);
+	buf_append(b, "\t", 1);
+	buf_field(b, toplevel->xdg_toplevel->title);
+}
+
+static void format_outputs(struct swwm_server *server, struct ipc_buf *b)
+{
+	struct swwm_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct wlr_box box;
+		wlr_output_layout_get_box(server->output_layout, output->wlr_output, &box);
+		buf_field(b, output->wlr_output->name);
+		buf_printf(b, "\t%d\t%d\t%d\t%d\t%.2f\t%d\n", box.x, box.y, box.width, box.height,
+			output->wlr_output->scale, output->active_ws + 1);
+	}
+}
+
+static void format_workspaces(struct swwm_server *server, struct ipc_buf *b)
+{
+	for (int i = 0; i < NUM_WORKSPACES; i++) {
+		struct swwm_workspace_info info;
+		if (!swwm_get_workspace_info(server, i, &info)) {
+			continue;
+		}
+		buf_printf(b, "%d\t%d\t%d\t", i + 1, info.visible, i == server->current_ws_idx);
+		buf_field(b, info.output_name);
+		buf_printf(b, "\t%d\t%d\n", info.tiled, info.floating);
+	}
+}
+
+static void format_toplevels(struct swwm_server *server, struct ipc_buf *b)
+{
+	for (int i = 0; i < NUM_WORKSPACES; i++) {
+		struct swwm_workspace *ws = &server->workspaces[i];
+		struct wl_list *lists[] = { &ws->toplevels, &ws->floating_toplevels };
+		for (size_t l = 0; l < LENGTH(lists); l++) {
+			struct swwm_toplevel *toplevel;
+			wl_list_for_each(toplevel, lists[l], workspace_link) {
+				format_toplevel(b, toplevel);
+				buf_append(b, "\n", 1);
+			}
+		}
+	}
+}
+
+// --- Commands ---
+
+static void run_command(struct swwm_server *server, char *line, struct ipc_buf *reply)
+{
+	char *save;
+	char *verb = strtok_r(line, " \t", &save);
+	if (!verb) {
+		return; // Blank line
+	}
+	if (!strcmp(verb, "call")) {
+		char *name = strtok_r(NULL, " \t", &save);
+		config_call_fn fn = name ? config_find_call(name, strlen(name)) : NULL;
+		if (!fn) {
+			buf_printf(reply, "error: unknown function '%s'\n", name ? name : "");
+			return;
+		}
+		fn(server, NULL);
+	} else if (!strcmp(verb, "workspace")) {
+		char *action = strtok_r(NULL, " \t", &save);
+		char *num = strtok_r(NULL, " \t", &save);
+		int ws = num ? atoi(num) : 0;
+		bool move = action && !strcmp(action, "move");
+		if ((!move && (!action || strcmp(action, "swap") != 0)) || ws < 1 || ws > NUM_WORKSPACES) {
+			buf_printf(reply, "error: expected 'workspace move|swap 1-%d'\n", NUM_WORKSPACES);
+			return;
+		}
+		if (move) {
+			change_workspace_action(server, (void *)(intptr_t)(ws - 1));
+		} else {
+			move_to_workspace_action(server, (void *)(intptr_t)(ws - 1));
+		}
+	} else if (!strcmp(verb, "trace")) {
+		char *action = strtok_r(NULL, " \t", &save);
+		char *path = strtok_r(NULL, "", &save);
+		if (action && !strcmp(action, "start")) {
+			if (!trace_start()) {
+				buf_printf(reply, "error: cannot allocate the trace buffer\n");
+				return;
+			}
+		} else if (action && (!strcmp(action, "stop") || !strcmp(action, "dump"))) {
+			if (!strcmp(action, "stop")) {
+				trace_stop();
+			}
+			if (!trace_dump(path)) {
+				buf_printf(reply, "error: cannot write %s\n", path ? path : trace_default_path());
+				return;
+			}
+			buf_printf(reply, "ok %s\n", path ? path : trace_default_path());
+			return;
+		} else {
+			buf_printf(reply, "error: expected 'trace start|stop|dump [path]'\n");
+			return;
+		}
+	} else {
+		buf_printf(reply, "error: unknown command '%s'\n", verb);
+		return;
+	}
+	buf_printf(reply, "ok\n");
+}
+
+static void run_commands(struct swwm_server *server, char *payload, struct ipc_buf *reply)
+{
+	// Layout changes from all lines are applied once, at the end
+	swwm_arrange_begin(server);
+	char *save;
+	for (char *line = strtok_r(payload, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		run_command(server, line, reply);
+	}
+	swwm_arrange_end(server);
+}
+
+static void subscribe(struct ipc_client *client, char *payload, struct ipc_buf *reply)
+{
+	static const struct { const char *name; uint32_t event; } events[] = {
+		{"focus", IPC_EVENT_FOCUS},
+		{"workspace", IPC_EVENT_WORKSPACE},
+		{"window", IPC_EVENT_WINDOW},
+		{"config", IPC_EVENT_CONFIG},
+	};
+	uint32_t mask = 0;
+	char *save;
+	for (char *name = strtok_r(payload, " \t\n", &save); name; name = strtok_r(NULL, " \t\n", &save)) {
+		size_t i = 0;
+		while (i < LENGTH(events) && strcmp(name, events[i].name) != 0) {
+			i++;
+		}
+		if (i == LENGTH(events)) {
+			buf_printf(reply, "error: unknown event '%s'\n", name);
+			return;
+		}
+		mask |= events[i].event;
+	}
+	client->events |= mask;
+	client->ipc->subscribed |= mask;
+	buf_printf(reply, "ok\n");
+}
+
+static void client_handle_message(struct ipc_client *client, uint32_t type, const uint8_t *data, uint32_t len)
+{
+	struct swwm_ipc *ipc = client->ipc;
+	struct swwm_server *server = ipc->server;
+	// A reply of its own: commands can emit events, which use ipc->scratch
+	struct ipc_buf reply = {0};
+	char *payload = malloc(len + 1);
+	if (!payload) {
+		client->dead = true;
+		return;
+	}
+	memcpy(payload, data, len);
+	payload[len] = '\0';
+
+	switch (type) {
+	case IPC_COMMAND:
+		run_commands(server, payload, &reply);
+		break;
+	case IPC_GET_OUTPUTS:
+		format_outputs(server, &reply);
+		break;
+	case IPC_GET_WORKSPACES:
+		format_workspaces(server, &reply);
+		break;
+	case IPC_GET_TOPLEVELS:
+		format_toplevels(server, &reply);
+		break;
+	case IPC_SUBSCRIBE:
+		subscribe(client, payload, &reply);
+		break;
+	default:
+		buf_printf(&reply, "error: unknown message type %u\n", type);
+		break;
+	}
+	client_send(client, type, &reply);
+	free(reply.data);
+	free(payload);
+}
+
+static void client_read(struct ipc_client *client)
+{
+	for (;;) {
+		ssize_t n = recv(client->fd, client->in + client->in_len, sizeof(client->in) - client->in_len, 0);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+			client->dead = true;
+			return;
+		}
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		client->in_len += (size_t)n;
+
+		size_t off = 0;
+		while (!client->dead && client->in_len - off >= IPC_HEADER_SIZE) {
+			uint32_t len = get32(client->in + off);
+			uint32_t type = get32(client->in + off + 4);
+			if (len > IPC_MAX_PAYLOAD) {
+				wlr_log(WLR_ERROR, "ipc: %u byte request exceeds the limit, dropping client", len);
+				client->dead = true;
+				return;
+			}
+			if (client->in_len - off < IPC_HEADER_SIZE + len) {
+				break;
+			}
+			client_handle_message(client, type, client->in + off + IPC_HEADER_SIZE, len);
+			off += IPC_HEADER_SIZE + len;
+		}
+		memmove(client->in, client->in + off, client->in_len - off);
+		client->in_len -= off;
+		if (client->dead) {
+			return;
+		}
+	}
+}
+
+static int client_handle_fd(int fd, uint32_t mask, void *data)
+{
+	struct ipc_client *client = data;
+	client->dispatching = true;
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		client->dead = true;
+	}
+	if (!client->dead && (mask & WL_EVENT_READABLE)) {
+		client_read(client);
+	}
+	if (!client->dead && (mask & WL_EVENT_WRITABLE)) {
+		client_flush(client);
+	}
+	client->dispatching = false;
+	if (client->dead) {
+		client_destroy(client);
+	}
+	return 0;
+}
+
+static int ipc_handle_listen(int fd, uint32_t mask, void *data)
+{
+	struct swwm_ipc *ipc = data;
+	int client_fd = accept(fd, NULL, NULL);
+	if (client_fd < 0) {
+		return 0;
+	}
+	fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+	fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+	struct ipc_client *client = calloc(1, sizeof(*client));
+	if (!client) {
+		close(client_fd);
+		return 0;
+	}
+	client->ipc = ipc;
+	client->fd = client_fd;
+	client->source = wl_event_loop_add_fd(wl_display_get_event_loop(ipc->server->wl_display),
+		client_fd, WL_EVENT_READABLE, client_handle_fd, client);
+	if (!client->source) {
+		close(client_fd);
+		free(client);
+		return 0;
+	}
+	wl_list_insert(&ipc->clients, &client->link);
+	return 0;
+}
+
+// --- Events ---
+
+static bool ipc_wants(struct swwm_server *server, uint32_t event)
+{
+	return server->ipc && (server->ipc->subscribed & event);
+}
+
+// Sends ipc->scratch to every client subscribed to event
+static void ipc_broadcast(struct swwm_ipc *ipc, uint32_t event)
+{
+	struct ipc_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &ipc->clients, link) {
+		if (client->events & event) {
+			client_send(client, IPC_EVENT_FLAG | event, &ipc->scratch);
+		}
+		if (client->dead && !client->dispatching) {
+			client_destroy(client);
+		}
+	}
+	ipc->scratch.len = 0;
+}
+
+void ipc_event_focus(struct swwm_server *server)
+{
+	if (!ipc_wants(server, IPC_EVENT_FOCUS)) {
+		return;
+	}
+	if (server->focused_toplevel) {
+		format_toplevel(&server->ipc->scratch, server->focused_toplevel);
+	}
+	ipc_broadcast(server->ipc, IPC_EVENT_FOCUS);
+}
+
+void ipc_event_workspace(struct swwm_server *server)
+{
+	if (!ipc_wants(server, IPC_EVENT_WORKSPACE)) {
+		return;
+	}
+	format_workspaces(server, &server->ipc->scratch);
+	ipc_broadcast(server->ipc, IPC_EVENT_WORKSPACE);
+}
+
+void ipc_event_window(struct swwm_server *server, struct swwm_toplevel *toplevel, const char *change)
+{
+	if (!ipc_wants(server, IPC_EVENT_WINDOW)) {
+		return;
+	}
+	buf_printf(&server->ipc->scratch, "%s\t", change);
+	format_toplevel(&server->ipc->scratch, toplevel);
+	ipc_broadcast(server->ipc, IPC_EVENT_WINDOW);
+}
+
+void ipc_event_config(struct swwm_server *server, bool ok)
+{
+	if (!ipc_wants(server, IPC_EVENT_CONFIG)) {
+		return;
+	}
+	buf_printf(&server->ipc->scratch, "%s", ok ? "reloaded" : "failed");
+	ipc_broadcast(server->ipc, IPC_EVENT_CONFIG);
+}
+
+// --- Lifecycle ---
+
+bool swwm_ipc_start(struct swwm_server *server, const char *path)
+{
+	if (server->ipc) {
+		return false;
+	}
+	struct swwm_ipc *ipc = calloc(1, sizeof(*ipc));
+	if (!ipc) {
+		return false;
+	}
+	ipc->server = server;
+	wl_list_init(&ipc->clients);
+
+	int n;
+	if (path) {
+		n = snprintf(ipc->path, sizeof(ipc->path), "%s", path);
+	} else {
+		// Next to the Wayland socket, one per compositor instance
+		const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+		const char *display = getenv("WAYLAND_DISPLAY");
+		if (!runtime_dir) {
+			wlr_log(WLR_ERROR, "ipc: XDG_RUNTIME_DIR not set");
+			free(ipc);
+			return false;
+		}
+		n = snprintf(ipc->path, sizeof(ipc->path), "%s/swwm-ipc.%s.sock", runtime_dir, display ? display : "0");
+	}
+	if (n < 0 || (size_t)n >= sizeof(ipc->path)) {
+		wlr_log(WLR_ERROR, "ipc: socket path too long");
+		free(ipc);
+		return false;
+	}
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	memcpy(addr.sun_path, ipc->path, (size_t)n + 1);
+	ipc->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	unlink(ipc->path); // Stale socket from a previous run
+	if (ipc->listen_fd < 0 || bind(ipc->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(ipc->listen_fd, 16) < 0) {
+		wlr_log_errno(WLR_ERROR, "ipc: cannot listen on %s", ipc->path);
+		if (ipc->listen_fd >= 0) close(ipc->listen_fd);
+		free(ipc);
+		return false;
+	}
+	ipc->listen_source = wl_event_loop_add_fd(wl_display_get_event_loop(server->wl_display),
+		ipc->listen_fd, WL_EVENT_READABLE, ipc_handle_listen, ipc);
+	if (!ipc->listen_source) {
+		close(ipc->listen_fd);
+		unlink(ipc->path);
+		free(ipc);
+		return false;
+	}
+
+	server->ipc = ipc;
+	setenv("SWWMSOCK", ipc->path, true);
+	wlr_log(WLR_INFO, "IPC listening on %s", ipc->path);
+	return true;
+}
+
+void swwm_ipc_stop(struct swwm_server *server)
+{
+	struct swwm_ipc *ipc = server->ipc;
+	if (!ipc) {
+		return;
+	}
+	struct ipc_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &ipc->clients, link) {
+		client_destroy(client);
+	}
+	wl_event_source_remove(ipc->listen_source);
+	close(ipc->listen_fd);
+	unlink(ipc->path);
+	free(ipc->scratch.data);
+	free(ipc);
+	server->ipc = NULL;
+	unsetenv("SWWMSOCK");
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+struct swwm_server;
+struct swwm_toplevel;
+
+/*
+ * IPC (ipc.c): a Unix stream socket, served from the event loop without
+ * blocking. Its path is exported as SWWMSOCK. Every message in either
+ * direction is an 8-byte header, payload length then type (both uint32,
+ * big-endian), followed by that many bytes of text. Replies carry the
+ * request's type.
+ *
+ * IPC_COMMAND       one command per line:
+ *                     call <function>          any `call` name from swwmrc
+ *                     workspace move|swap <N>  as the swwmrc binding
+ *                     trace start|stop|dump [path]
+ *                                              handler tracing (trace.h);
+ *                                              stop and dump reply "ok <path>"
+ *                   All lines run before a single relayout. The reply has a
+ *                   line per command, "ok" or "error: <reason>".
+ * IPC_GET_OUTPUTS   name x y width height scale workspace
+ * IPC_GET_WORKSPACES  number visible focused output tiled floating
+ * IPC_GET_TOPLEVELS id workspace floating fullscreen focused x y width height app_id title
+ * IPC_SUBSCRIBE     space-separated event names (focus workspace window
+ *                   config); replies "ok", then events arrive with type
+ *                   IPC_EVENT_FLAG | IPC_EVENT_*. Events a command causes
+ *                   arrive before its reply.
+ *
+ * Query replies have a line per object, fields separated by tabs (tabs and
+ * newlines in titles become spaces); workspaces are numbered from 1 as in
+ * swwmrc. Events: focus is the focused toplevel's line (empty for none),
+ * workspace is the IPC_GET_WORKSPACES reply, window is "<change>\t" and the
+ * toplevel's line (change: new close title app_id floating fullscreen move),
+ * config is "reloaded" or "failed".
+ */
+
+enum ipc_message_type {
+	IPC_COMMAND = 0,
+	IPC_GET_OUTPUTS = 1,
+	IPC_GET_WORKSPACES = 2,
+	IPC_GET_TOPLEVELS = 3,
+	IPC_SUBSCRIBE = 4,
+};
+
+#define IPC_EVENT_FLAG 0x80000000u
+
+enum ipc_event {
+	IPC_EVENT_FOCUS = 1 << 0,
+	IPC_EVENT_WORKSPACE = 1 << 1,
+	IPC_EVENT_WINDOW = 1 << 2,
+	IPC_EVENT_CONFIG = 1 << 3,
+};
+
+#define IPC_HEADER_SIZE 8
+#define IPC_MAX_PAYLOAD 65536     // Longest request; replies and events may be longer
+#define IPC_MAX_PENDING (4 << 20) // Unsent bytes before a client that stopped reading is dropped
+
+// Event sources in swwm.c; free when nobody subscribed to the event
+void ipc_event_focus(struct swwm_server *server);
+void ipc_event_workspace(struct swwm_server *server);
+void ipc_event_window(struct swwm_server *server, struct swwm_toplevel *toplevel, const char *change);
+void ipc_event_config(struct swwm_server *server, bool ok);
@@ -0,0 +1,111 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// libswwm: the compositor core as a library. main.c is a thin wrapper around
+// this; benchmark and regression harnesses link the same code and drive it
+// in-process (create a server, inject input, step the event loop, inspect state).
+
+struct swwm_server;
+
+enum swwm_backend_type {
+	SWWM_BACKEND_AUTO,     // wlr_backend_autocreate (DRM, Wayland, X11, ...)
+	SWWM_BACKEND_HEADLESS, // Headless backend + pixman, no GPU or session needed.
+	                       // Setting WLR_RENDERER (e.g. gles2 on Mesa llvmpipe)
+	                       // picks that renderer instead, to exercise dmabuf paths.
+};
+
+struct swwm_server_options {
+	enum swwm_backend_type backend;
+	bool load_config;             // Parse the user's swwmrc
+};
+
+struct swwm_workspace_info {
+	int id;
+	int tiled;
+	int floating;
+	bool visible;
+	const char *output_name; // NULL if not assigned to an output
+};
+
+struct swwm_toplevel_info {
+	const char *app_id; // May be NULL
+	const char *title;  // May be NULL
+	int workspace;
+	bool floating;
+	bool fullscreen;
+	bool focused;
+	int x, y, width, height;
+};
+
+// Lifecycle. options may be NULL (autodetected backend, config loaded).
+struct swwm_server *swwm_server_create(const struct swwm_server_options *options);
+// Opens the Wayland socket, starts the backend and exports WAYLAND_DISPLAY.
+// Returns the socket name, or NULL on failure.
+const char *swwm_server_start(struct swwm_server *server);
+void swwm_server_run(struct swwm_server *server);
+// Flush clients and dispatch pending events once, waiting at most timeout_ms
+// (-1 blocks). Returns the wl_event_loop_dispatch result.
+int swwm_server_dispatch(struct swwm_server *server, int timeout_ms);
+void swwm_server_terminate(struct swwm_server *server);
+void swwm_server_destroy(struct swwm_server *server);
+// Only works on the headless backend
+bool swwm_server_add_headless_output(struct swwm_server *server, int width, int height);
+
+// Input injection through a virtual keyboard/pointer. Keycodes are evdev
+// (KEY_*), buttons are BTN_*, absolute coordinates are 0..1 over the layout.
+void swwm_inject_key(struct swwm_server *server, uint32_t time_msec, uint32_t keycode, bool pressed);
+void swwm_inject_motion(struct swwm_server *server, uint32_t time_msec, double dx, double dy);
+void swwm_inject_motion_absolute(struct swwm_server *server, uint32_t time_msec, double x, double y);
+void swwm_inject_button(struct swwm_server *server, uint32_t time_msec, uint32_t button, bool pressed);
+void swwm_inject_axis(struct swwm_server *server, uint32_t time_msec, bool horizontal,
+		double delta, int32_t delta_discrete);
+void swwm_inject_frame(struct swwm_server *server);
+
+// Run a command through /bin/sh -c, like the -s startup command.
+// Returns false if it could not be started.
+bool swwm_spawn_command(struct swwm_server *server, const char *command);
+
+// State queries
+int swwm_current_workspace(struct swwm_server *server);
+bool swwm_get_workspace_info(struct swwm_server *server, int idx, struct swwm_workspace_info *info);
+// Fills up to max entries, returns the total number of toplevels
+size_t swwm_get_toplevels(struct swwm_server *server, struct swwm_toplevel_info *infos, size_t max);
+
+// Individual handlers, for timing them in isolation
+void swwm_arrange_workspace(struct swwm_server *server, int idx);
+// Defers relayouts until the matching end, then arranges each workspace
+// that asked for one once. Nests.
+void swwm_arrange_begin(struct swwm_server *server);
+void swwm_arrange_end(struct swwm_server *server);
+
+void swwm_dump_frame_stats(struct swwm_server *server, FILE *f);
+
+// Input recording and deterministic replay (input_record.c). Replay expects a
+// headless server; it recreates the recorded outputs, feeds every event
+// through the normal handlers with the recorded timestamps, paced by their
+// recorded deltas, and prints per-event-type handler timings. Returns the
+// process exit code.
+bool swwm_record_start(struct swwm_server *server, const char *path);
+void swwm_record_stop(struct swwm_server *server);
+int swwm_replay_run(struct swwm_server *server, const char *path);
+// Built-in VNC server (vnc.c). Adds a width x height headless output and
+// serves it over RFB, encoding only damaged regions on a worker thread; input
+// from viewers goes through swwm_inject_*. listen_on is a Unix socket path, or
+// a TCP port number bound to 127.0.0.1. Needs the headless backend.
+bool swwm_vnc_start(struct swwm_server *server, const char *listen_on, int width, int height);
+void swwm_vnc_stop(struct swwm_server *server);
+// IPC socket (ipc.c, protocol in ipc.h). path NULL means
+// $XDG_RUNTIME_DIR/swwm-ipc.$WAYLAND_DISPLAY.sock; the path is exported as
+// SWWMSOCK.
+bool swwm_ipc_start(struct swwm_server *server, const char *path);
+void swwm_ipc_stop(struct swwm_server *server);
+// Shared-memory state snapshot (snapshot.c, layout in snapshot.h). path NULL
+// means $XDG_RUNTIME_DIR/swwm-state.$WAYLAND_DISPLAY; exported as SWWMSTATE.
+bool swwm_snapshot_start(struct swwm_server *server, const char *path);
+void swwm_snapshot_stop(struct swwm_server *server);
+// Headless benchmark mode (bench.c), see the script format there.
+// Returns the process exit code.
+int swwm_bench_run(struct swwm_server *server, const char *script_path);
@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+
+#include "libswwm.h"
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_INFO, NULL); // Changed to INFO for less verbosity
+	char *startup_cmd = NULL;
+	char *frame_stats_path = NULL;
+	char *bench_script = NULL;
+	char *record_path = NULL;
+	char *replay_path = NULL;
+	char *vnc_listen = NULL;
+	char *ipc_path = NULL;
+	int vnc_width = 1280, vnc_height = 720;
+
+	int c;
+	while ((c = getopt(argc, argv, "s:S:B:R:P:V:G:I:h")) != -1) {
+		switch (c) {
+		case 's':
+			startup_cmd = optarg;
+			break;
+		case 'S':
+			frame_stats_path = optarg;
+			break;
+		case 'B':
+			bench_script = optarg;
+			break;
+		case 'R':
+			record_path = optarg;
+			break;
+		case 'P':
+			replay_path = optarg;
+			break;
+		case 'V':
+			vnc_listen = optarg;
+			break;
+		case 'I':
+			ipc_path = optarg;
+			break;
+		case 'G':
+			if (sscanf(optarg, "%dx%d", &vnc_width, &vnc_height) != 2) {
+				fprintf(stderr, "Bad VNC output size '%s', expected WIDTHxHEIGHT\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("Usage: %s [-s startup command] [-S frame stats file] [-B benchmark script]\n"
+			       "       [-R record input file] [-P replay input file]\n"
+			       "       [-V VNC socket path or port] [-G VNC output size, e.g. 1280x720]\n"
+			       "       [-I IPC socket path]\n", argv[0]);
+			return 0;
+		}
+	}
+	if (optind < argc) {
+		printf("Usage: %s [-s startup command] [-S frame stats file] [-B benchmark script]\n"
+			       "       [-R record input file] [-P replay input file]\n"
+			       "       [-V VNC socket path or port] [-G VNC output size, e.g. 1280x720]\n"
+			       "       [-I IPC socket path]\n", argv[0]);
+		return 0;
+	}
+
+	struct swwm_server_options options = {
+		.backend = (bench_script || replay_path || vnc_listen) ? SWWM_BACKEND_HEADLESS : SWWM_BACKEND_AUTO,
+		.load_config = true,
+	};
+	struct swwm_server *server = swwm_server_create(&options);
+	if (!server) {
+		return 1;
+	}
+
+	const char *socket = swwm_server_start(server);
+	if (!socket) {
+		swwm_server_destroy(server);
+		return 1;
+	}
+
+	// Before the startup command, so its clients see the output
+	if (vnc_listen && !swwm_vnc_start(server, vnc_listen, vnc_width, vnc_height)) {
+		swwm_server_destroy(server);
+		return 1;
+	}
+
+	// Also before it, so it inherits SWWMSOCK and SWWMSTATE; swwm works
+	// without either
+	swwm_ipc_start(server, ipc_path);
+	swwm_snapshot_start(server, NULL);
+
+	if (startup_cmd) {
+		swwm_spawn_command(server, startup_cmd);
+	}
+
+	if (record_path && !swwm_record_start(server, record_path)) {
+		swwm_server_destroy(server);
+		return 1;
+	}
+
+	int ret = 0;
+	if (bench_script) {
+		ret = swwm_bench_run(server, bench_script);
+	} else if (replay_path) {
+		ret = swwm_replay_run(server, replay_path);
+	} else {
+		wlr_log(WLR_INFO, "Running Wayland compositor on WAYLAND_DISPLAY=%s", socket);
+		swwm_server_run(server);
+	}
+
+    if (frame_stats_path) {
+        FILE *stats_file = fopen(frame_stats_path, "w");
+        if (stats_file) {
+            swwm_dump_frame_stats(server, stats_file);
+            fclose(stats_file);
+        } else {
+            wlr_log_errno(WLR_ERROR, "cannot write frame stats to %s", frame_stats_path);
+        }
+    }
+
+	swwm_server_destroy(server);
+	return ret;
+}
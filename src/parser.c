@@ -1,11 +1,15 @@
 #define _POSIX_C_SOURCE 200809L
 #include <ctype.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include <xkbcommon/xkbcommon.h>
 #include <xkbcommon/xkbcommon-keysyms.h>
 
@@ -36,65 +40,349 @@ static const struct {
     {NULL, NULL}
 };
 
+/*
+ * The config is read into one buffer and parsed in place: lines, keys and
+ * values are (pointer, length) spans into it, nothing else is copied
+ * until a value is stored (command argv, rule values) or handed to
+ * an API that wants a C string (xkb keysym names, strtof).
+ */
+struct span {
+	const char *p;
+	size_t n;
+};
 
-static void remap_and_dedupe_binds(Config *cfg)
+enum config_key {
+	CFG_MOD_KEY,
+	CFG_GAPS,
+	CFG_BORDER_WIDTH,
+	CFG_FOCUSED_BORDER_COLOUR,
+	CFG_UNFOCUSED_BORDER_COLOUR,
+	CFG_SWAP_BORDER_COLOUR,
+	CFG_MASTER_WIDTH,
+	CFG_MOTION_THROTTLE,
+	CFG_MOTION_THROTTLE_HZ,
+	CFG_RESIZE_MASTER_AMOUNT,
+	CFG_SNAP_DISTANCE,
+	CFG_OUTPUT_SCALE,
+	CFG_SHOULD_FLOAT,
+	CFG_RULE,
+	CFG_CALL,
+	CFG_BIND,
+	CFG_WORKSPACE,
+	CFG_KEY_COUNT,
+};
+
+static const char *const config_key_names[CFG_KEY_COUNT] = {
+	[CFG_MOD_KEY] = "mod_key",
+	[CFG_GAPS] = "gaps",
+	[CFG_BORDER_WIDTH] = "border_width",
+	[CFG_FOCUSED_BORDER_COLOUR] = "focused_border_colour",
+	[CFG_UNFOCUSED_BORDER_COLOUR] = "unfocused_border_colour",
+	[CFG_SWAP_BORDER_COLOUR] = "swap_border_colour",
+	[CFG_MASTER_WIDTH] = "master_width",
+	[CFG_MOTION_THROTTLE] = "motion_throttle", // What default_swwmrc ships
+	[CFG_MOTION_THROTTLE_HZ] = "motion_throttle_hz",
+	[CFG_RESIZE_MASTER_AMOUNT] = "resize_master_amount",
+	[CFG_SNAP_DISTANCE] = "snap_distance",
+	[CFG_OUTPUT_SCALE] = "output_scale",
+	[CFG_SHOULD_FLOAT] = "should_float",
+	[CFG_RULE] = "rule",
+	[CFG_CALL] = "call",
+	[CFG_BIND] = "bind",
+	[CFG_WORKSPACE] = "workspace",
+};
+
+// Modifier names in a combo, matched case-insensitively. A zero mask means
+// "mod", i.e. whatever mod_key is set to.
+static const char *const mod_names[] = {
+	"mod", "shift", "ctrl", "alt", "super", "caps", "mod2", "mod3", "mod5",
+};
+static const uint32_t mod_masks[] = {
+	0, SWM_MOD_SHIFT, SWM_MOD_CTRL, SWM_MOD_ALT, SWM_MOD_LOGO,
+	SWM_MOD_CAPS, SWM_MOD_MOD2, SWM_MOD_MOD3, SWM_MOD_MOD5,
+};
+
+/*
+ * Perfect hash over a fixed table of names. The seed is searched once so
+ * that every name lands in a slot of its own; a lookup is then one hash and
+ * one compare against the only candidate.
+ */
+#define PHASH_SLOTS 64
+
+struct phash {
+	const void *base; // Address of the first name pointer
+	size_t stride;    // Bytes between consecutive name pointers
+	size_t n;
+	bool fold_case;
+	uint32_t seed;
+	uint8_t slot[PHASH_SLOTS]; // Name index + 1, 0 for an empty slot
+};
+
+static struct phash config_key_hash = {
+	config_key_names, sizeof(config_key_names[0]), CFG_KEY_COUNT, false, 0, {0},
+};
+static struct phash mod_hash = {
+	mod_names, sizeof(mod_names[0]), sizeof(mod_names) / sizeof(mod_names[0]), true, 0, {0},
+};
+static struct phash call_hash = {
+	&call_table[0].name, sizeof(call_table[0]), sizeof(call_table) / sizeof(call_table[0]) - 1, false, 0, {0},
+};
+static bool phash_ready;
+static pthread_once_t phash_once = PTHREAD_ONCE_INIT;
+
+static const char *phash_name(const struct phash *h, size_t i)
 {
-	for (int i = 0; i < cfg->bindsn; i++) {
-		for (int j = i + 1; j < cfg->bindsn; j++) {
-			if (cfg->binds[i].mods == cfg->binds[j].mods && cfg->binds[i].keysym == cfg->binds[j].keysym) {
-				// Free duplicated command arrays if any
-                if (cfg->binds[j].type == TYPE_CMD && cfg->binds[j].action.cmd) {
-                    for(int k=0; cfg->binds[j].action.cmd[k] != NULL; ++k) {
-                        free((void*)cfg->binds[j].action.cmd[k]);
-                    }
-                    free(cfg->binds[j].action.cmd);
-                }
-				memmove(&cfg->binds[j], &cfg->binds[j + 1], sizeof(Binding) * (cfg->bindsn - j - 1));
-				cfg->bindsn--;
-				j--;
+	return *(const char *const *)((const char *)h->base + i * h->stride);
+}
+
+static uint32_t phash_fnv(const char *s, size_t n, uint32_t seed, bool fold_case)
+{
+	uint32_t h = 2166136261u ^ seed;
+	for (size_t i = 0; i < n; i++) {
+		unsigned char c = (unsigned char)s[i];
+		if (fold_case && c >= 'A' && c <= 'Z') {
+			c |= 0x20;
+		}
+		h = (h ^ c) * 16777619u;
+	}
+	return h ^ (h >> 15);
+}
+
+static bool phash_build(struct phash *h)
+{
+	if (h->n > PHASH_SLOTS) {
+		return false;
+	}
+	for (uint32_t seed = 1; seed < (1u << 20); seed++) {
+		memset(h->slot, 0, sizeof(h->slot));
+		size_t i;
+		for (i = 0; i < h->n; i++) {
+			const char *name = phash_name(h, i);
+			uint32_t s = phash_fnv(name, strlen(name), seed, h->fold_case) % PHASH_SLOTS;
+			if (h->slot[s]) {
+				break;
 			}
+			h->slot[s] = (uint8_t)(i + 1);
+		}
+		if (i == h->n) {
+			h->seed = seed;
+			return true;
+		}
+	}
+	return false;
+}
+
+static int phash_find(const struct phash *h, struct span s)
+{
+	int i = h->slot[phash_fnv(s.p, s.n, h->seed, h->fold_case) % PHASH_SLOTS] - 1;
+	if (i < 0) {
+		return -1;
+	}
+	const char *name = phash_name(h, i);
+	if (strlen(name) != s.n) {
+		return -1;
+	}
+	int diff = h->fold_case ? strncasecmp(name, s.p, s.n) : memcmp(name, s.p, s.n);
+	return diff ? -1 : i;
+}
+
+static void phash_build_all(void)
+{
+	if (!phash_build(&config_key_hash) || !phash_build(&mod_hash) || !phash_build(&call_hash)) {
+		fprintf(stderr, "swwm: cannot build config name tables\n");
+		return;
+	}
+	phash_ready = true;
+}
+
+// Built on first use; the reload worker (config_watch.c) may get there first
+static bool phash_init(void)
+{
+	pthread_once(&phash_once, phash_build_all);
+	return phash_ready;
+}
+
+static struct span span_trim(struct span s)
+{
+	while (s.n && isspace((unsigned char)*s.p)) {
+		s.p++;
+		s.n--;
+	}
+	while (s.n && isspace((unsigned char)s.p[s.n - 1])) {
+		s.n--;
+	}
+	return s;
+}
+
+// Split at the first c; both halves are trimmed
+static bool span_split(struct span s, char c, struct span *head, struct span *tail)
+{
+	const char *sep = memchr(s.p, c, s.n);
+	if (!sep) {
+		return false;
+	}
+	size_t at = (size_t)(sep - s.p);
+	*head = span_trim((struct span){s.p, at});
+	*tail = span_trim((struct span){sep + 1, s.n - at - 1});
+	return true;
+}
+
+// Next token of *s delimited by any byte in delims; an empty span at the end
+static struct span span_token(struct span *s, const char *delims)
+{
+	while (s->n && strchr(delims, *s->p)) {
+		s->p++;
+		s->n--;
+	}
+	struct span tok = {s->p, 0};
+	while (tok.n < s->n && !strchr(delims, s->p[tok.n])) {
+		tok.n++;
+	}
+	s->p += tok.n;
+	s->n -= tok.n;
+	return tok;
+}
+
+static bool span_eq(struct span s, const char *str)
+{
+	return strlen(str) == s.n && memcmp(s.p, str, s.n) == 0;
+}
+
+// atoi() on a span: optional sign, leading digits, anything after is ignored
+static int span_atoi(struct span s)
+{
+	size_t i = 0;
+	bool neg = false;
+	long v = 0;
+	if (i < s.n && (s.p[i] == '-' || s.p[i] == '+')) {
+		neg = s.p[i++] == '-';
+	}
+	for (; i < s.n && isdigit((unsigned char)s.p[i]); i++) {
+		v = v * 10 + (s.p[i] - '0');
+		if (v > INT_MAX) {
+			v = INT_MAX;
 		}
 	}
+	return (int)(neg ? -v : v);
 }
 
-static char *strip(char *s)
+// NUL-terminated copy for APIs that need one; false if it does not fit
+static bool span_cstr(struct span s, char *buf, size_t size)
 {
-	while (*s && isspace((unsigned char)*s)) {
-		s++;
+	if (s.n >= size) {
+		return false;
 	}
-	char *e = s + strlen(s) - 1;
-	while (e > s && isspace((unsigned char)*e)) {
-		*e-- = '\0';
+	memcpy(buf, s.p, s.n);
+	buf[s.n] = '\0';
+	return true;
+}
+
+// A '#' at the start of a word begins a comment. Colours ("#c0cbff") start
+// the value itself, so a '#' right after the ':' is kept.
+static struct span strip_comment(struct span s)
+{
+	for (size_t i = 1; i < s.n; i++) {
+		if (s.p[i] == '#' && isspace((unsigned char)s.p[i - 1])) {
+			return span_trim((struct span){s.p, i});
+		}
 	}
 	return s;
 }
 
-static char *strip_quotes(char *s)
+static struct span strip_quotes(struct span s)
 {
-	size_t L = strlen(s);
-	if (L > 0 && s[0] == '"') {
-		s++;
-		L--;
+	if (s.n > 0 && s.p[0] == '"') {
+		s.p++;
+		s.n--;
 	}
-	if (L > 0 && s[L - 1] == '"') {
-		s[L - 1] = '\0';
+	if (s.n > 0 && s.p[s.n - 1] == '"') {
+		s.n--;
 	}
 	return s;
 }
 
+/*
+ * Everything a Config points to (bind argvs and their words, window rules
+ * and the matcher compiled from them) is bump-allocated from cfg->arena: a short list of blocks that
+ * double in size, released all at once by config_free. Overwritten and
+ * deduplicated binds just leave their bytes behind until then.
+ */
+#define CONFIG_ARENA_BLOCK 4096
+
+struct config_arena_block {
+	struct config_arena_block *next;
+	size_t size, used;
+	char data[];
+};
+
+void *config_arena_alloc(struct config_arena *arena, size_t n, size_t align)
+{
+	struct config_arena_block *block = arena->blocks;
+	if (block) {
+		size_t off = (block->used + align - 1) & ~(align - 1);
+		if (off + n <= block->size) {
+			arena->used += off + n - block->used;
+			block->used = off + n;
+			return block->data + off;
+		}
+	}
+	size_t size = block ? block->size * 2 : CONFIG_ARENA_BLOCK;
+	while (size < n) {
+		size *= 2;
+	}
+	block = malloc(sizeof(*block) + size);
+	if (!block) {
+		perror("swwm: config arena");
+		return NULL;
+	}
+	block->next = arena->blocks;
+	block->size = size;
+	block->used = 0;
+	arena->blocks = block;
+	arena->reserved += size;
+	return config_arena_alloc(arena, n, align);
+}
+
+static char *arena_strndup(struct config_arena *arena, const char *s, size_t n)
+{
+	char *copy = config_arena_alloc(arena, n + 1, 1);
+	if (copy) {
+		memcpy(copy, s, n);
+		copy[n] = '\0';
+	}
+	return copy;
+}
+
+void config_arena_release(struct config_arena *arena)
+{
+	struct config_arena_block *block = arena->blocks;
+	while (block) {
+		struct config_arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->blocks = NULL;
+	arena->used = arena->reserved = 0;
+}
+
+static void remap_and_dedupe_binds(Config *cfg)
+{
+	for (int i = 0; i < cfg->bindsn; i++) {
+		for (int j = i + 1; j < cfg->bindsn; j++) {
+			if (cfg->binds[i].mods == cfg->binds[j].mods && cfg->binds[i].keysym == cfg->binds[j].keysym) {
+				memmove(&cfg->binds[j], &cfg->binds[j + 1], sizeof(Binding) * (cfg->bindsn - j - 1));
+				cfg->bindsn--;
+				j--;
+			}
+		}
+	}
+}
+
 static Binding *alloc_bind(Config *cfg, uint32_t mods, xkb_keysym_t ks)
 {
 	for (int i = 0; i < cfg->bindsn; i++) {
 		if (cfg->binds[i].mods == mods && cfg->binds[i].keysym == ks) {
-            // Free old command if overwriting
-            if (cfg->binds[i].type == TYPE_CMD && cfg->binds[i].action.cmd) {
-                 for(int k=0; cfg->binds[i].action.cmd[k] != NULL; ++k) {
-                    free((void*)cfg->binds[i].action.cmd[k]);
-                }
-                free(cfg->binds[i].action.cmd);
-                cfg->binds[i].action.cmd = NULL;
-            }
-			return &cfg->binds[i];
+			return &cfg->binds[i]; // Overwritten; an old argv stays in the arena
 		}
 	}
 	if (cfg->bindsn >= (int)(sizeof(cfg->binds)/sizeof(cfg->binds[0]))) {
@@ -110,294 +398,528 @@ static Binding *alloc_bind(Config *cfg, uint32_t mods, xkb_keysym_t ks)
 	return b;
 }
 
-uint32_t parse_mods_str(const char *combo, Config *cfg)
+static xkb_keysym_t parse_keysym_span(struct span s)
 {
-	uint32_t m = 0;
-	char buf[256];
-	strncpy(buf, combo, sizeof buf - 1);
-    buf[sizeof buf -1] = '\0';
+	char name[64];
+	if (!span_cstr(s, name, sizeof(name))) {
+		fprintf(stderr, "swwm: unknown keysym '%.*s'\n", (int)s.n, s.p);
+		return XKB_KEY_NoSymbol;
+	}
+	return parse_keysym_str(name);
+}
 
-	for (char *p = buf; *p; p++) { // Normalize separators to '+'
-		if (*p == '+' || isspace((unsigned char)*p)) {
-			*p = '+';
+// One pass over "mod + shift + Return": modifier names are ORed into the
+// mask, the first other token that names a keysym goes to *ks (if wanted).
+static uint32_t parse_combo(struct span combo, const Config *cfg, xkb_keysym_t *ks)
+{
+	uint32_t m = 0;
+	for (struct span tok = span_token(&combo, "+ \t"); tok.n; tok = span_token(&combo, "+ \t")) {
+		int mod = phash_find(&mod_hash, tok);
+		if (mod >= 0) {
+			m |= mod_masks[mod] ? mod_masks[mod] : cfg->modkey; // modkey is already a SWM_MOD_* value
+		} else if (ks && *ks == XKB_KEY_NoSymbol) {
+			*ks = parse_keysym_span(tok);
 		}
 	}
+	return m;
+}
 
-	char *tok_ptr;
-	for (char *tok = strtok_r(buf, "+", &tok_ptr); tok; tok = strtok_r(NULL, "+", &tok_ptr)) {
-		// Convert token to lower case for matching
-        for (char *q = tok; *q; q++) {
-            *q = tolower((unsigned char)*q);
+uint32_t parse_mods_str(const char *combo, Config *cfg)
+{
+	if (!phash_init()) {
+		return 0;
+	}
+	return parse_combo((struct span){combo, strlen(combo)}, cfg, NULL);
+}
+
+static unsigned long parse_col_span(struct span s)
+{
+    // Colours are #RRGGBB (given full alpha) or #AARRGGBB, stored as AARRGGBB
+    // for the scene (see colour_to_rgba in swwm.c).
+    if (s.n == 0 || s.p[0] != '#') return 0; // Invalid format
+    unsigned long val = 0;
+    for (size_t i = 1; i < s.n; i++) {
+        int c = (unsigned char)s.p[i] | 0x20;
+        if (s.p[i] >= '0' && s.p[i] <= '9') {
+            val = val << 4 | (unsigned long)(s.p[i] - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            val = val << 4 | (unsigned long)(c - 'a' + 10);
+        } else {
+            fprintf(stderr, "swwm: invalid color string '%.*s'\n", (int)s.n, s.p);
+            return 0; // Or a default color
         }
-		if (!strcmp(tok, "mod"))    m |= cfg->modkey; // modkey is already a SWM_MOD_* value
-		else if (!strcmp(tok, "shift")) m |= SWM_MOD_SHIFT;
-		else if (!strcmp(tok, "ctrl"))  m |= SWM_MOD_CTRL;
-		else if (!strcmp(tok, "alt"))   m |= SWM_MOD_ALT;
-		else if (!strcmp(tok, "super")) m |= SWM_MOD_LOGO;
-        else if (!strcmp(tok, "caps")) m |= SWM_MOD_CAPS;
-        else if (!strcmp(tok, "mod2")) m |= SWM_MOD_MOD2;
-        else if (!strcmp(tok, "mod3")) m |= SWM_MOD_MOD3;
-        else if (!strcmp(tok, "mod5")) m |= SWM_MOD_MOD5;
-        // Keysym part is handled separately
+    }
+    if (s.n - 1 == 6) { // RRGGBB
+        val |= 0xFF000000;
+    }
+    return val;
+}
+
+static void parse_output_scale(Config *cfg, int lineno, struct span rest)
+{
+	// <output name> <scale>
+	struct span name = span_token(&rest, " \t");
+	char num[32], *end;
+	float scale = 0.0f;
+	if (name.n && span_cstr(span_trim(rest), num, sizeof(num))) {
+		scale = strtof(num, &end);
+		if (end == num) {
+			scale = 0.0f;
+		}
 	}
-	return m;
+	if (scale <= 0.0f) {
+		fprintf(stderr, "swwmrc:%d: output_scale expects '<output> <scale>'\n", lineno);
+		return;
+	}
+	if (name.n >= sizeof(cfg->output_scales[0].name)) {
+		name.n = sizeof(cfg->output_scales[0].name) - 1;
+	}
+	int i;
+	for (i = 0; i < cfg->output_scalesn; i++) {
+		if (span_eq(name, cfg->output_scales[i].name)) break;
+	}
+	if (i == cfg->output_scalesn) {
+		if (cfg->output_scalesn >= MAX_MONITORS) {
+			fprintf(stderr, "swwmrc:%d: too many output_scale entries\n", lineno);
+			return;
+		}
+		cfg->output_scalesn++;
+	}
+	memcpy(cfg->output_scales[i].name, name.p, name.n);
+	cfg->output_scales[i].name[name.n] = '\0';
+	cfg->output_scales[i].scale = scale;
 }
 
-static xkb_keysym_t parse_keysym_part(const char *combo) {
-    xkb_keysym_t ks = XKB_KEY_NoSymbol;
-    char buf[256];
-    strncpy(buf, combo, sizeof buf - 1);
-    buf[sizeof buf - 1] = '\0';
+static const char *const rule_field_names[RULE_FIELDS] = {
+	[RULE_APP_ID] = "app_id",
+	[RULE_TITLE] = "title",
+	[RULE_PARENT] = "parent",
+};
+
+// Appends a copy of nr to cfg->rules
+static bool add_rule(Config *cfg, int lineno, const struct rule *nr)
+{
+	if (cfg->rulesn >= RULES_MAX) {
+		fprintf(stderr, "swwmrc:%d: too many rules, max %d\n", lineno, RULES_MAX);
+		return false;
+	}
+	struct rule *rule = config_arena_alloc(&cfg->arena, sizeof(*rule), sizeof(void *));
+	if (!rule) {
+		return false;
+	}
+	*rule = *nr;
+	rule->next = NULL;
+	if (cfg->rules_last) {
+		cfg->rules_last->next = rule;
+	} else {
+		cfg->rules = rule;
+	}
+	cfg->rules_last = rule;
+	cfg->rulesn++;
+	return true;
+}
 
-    for (char *p = buf; *p; p++) {
-		if (*p == '+' || isspace((unsigned char)*p)) {
-			*p = '+';
+static void parse_should_float(Config *cfg, int lineno, struct span rest)
+{
+	// app_id,app_id2: one float rule each
+	for (struct span tok = span_token(&rest, ","); tok.n; tok = span_token(&rest, ",")) {
+		struct span app_id = span_trim(tok);
+		if (!app_id.n) {
+			continue;
+		}
+		struct rule nr = { .result = { .set = RULE_SET_FLOAT, .floating = true } };
+		nr.match[RULE_APP_ID] = arena_strndup(&cfg->arena, app_id.p, app_id.n);
+		if (!nr.match[RULE_APP_ID] || !add_rule(cfg, lineno, &nr)) {
+			break;
 		}
 	}
-    
-    char *tok_ptr;
-    for (char *tok = strtok_r(buf, "+", &tok_ptr); tok; tok = strtok_r(NULL, "+", &tok_ptr)) {
-        // try parsing current token as keysym if it's not a known modifier string
-        // (this is a bit naive, assumes keysym is the last non-modifier part)
-        char lower_tok[256];
-        strncpy(lower_tok, tok, sizeof(lower_tok)-1);
-        lower_tok[sizeof(lower_tok)-1] = '\0';
-        for(char *q = lower_tok; *q; ++q) *q = tolower((unsigned char)*q);
-
-        if (strcmp(lower_tok, "mod") != 0 && strcmp(lower_tok, "shift") != 0 &&
-            strcmp(lower_tok, "ctrl") != 0 && strcmp(lower_tok, "alt") != 0 &&
-            strcmp(lower_tok, "super") != 0 && strcmp(lower_tok, "caps") != 0 &&
-            strcmp(lower_tok, "mod2") != 0 && strcmp(lower_tok, "mod3") != 0 &&
-            strcmp(lower_tok, "mod5") != 0) {
-            ks = parse_keysym_str(tok);
-            if (ks != XKB_KEY_NoSymbol) break; // Found a keysym
-        }
-    }
-    return ks;
 }
 
+static bool parse_rule_actions(struct rule *nr, int lineno, struct span acts)
+{
+	for (struct span tok = span_token(&acts, " \t"); tok.n; tok = span_token(&acts, " \t")) {
+		if (span_eq(tok, "float") || span_eq(tok, "tile")) {
+			nr->result.set |= RULE_SET_FLOAT;
+			nr->result.floating = tok.p[0] == 'f';
+		} else if (span_eq(tok, "workspace")) {
+			struct span num = span_token(&acts, " \t");
+			int ws = span_atoi(num);
+			if (!num.n || !isdigit((unsigned char)num.p[0]) || ws < 1 || ws > NUM_WORKSPACES) {
+				fprintf(stderr, "swwmrc:%d: rule workspace expects 1-%d\n", lineno, NUM_WORKSPACES);
+				return false;
+			}
+			nr->result.set |= RULE_SET_WORKSPACE;
+			nr->result.workspace = ws - 1; // 0-indexed
+		} else if (span_eq(tok, "output")) {
+			struct span name = span_token(&acts, " \t");
+			if (!name.n || !span_cstr(name, nr->result.output, sizeof(nr->result.output))) {
+				fprintf(stderr, "swwmrc:%d: rule output expects an output name\n", lineno);
+				return false;
+			}
+			nr->result.set |= RULE_SET_OUTPUT;
+		} else if (span_eq(tok, "size")) {
+			struct span size = span_token(&acts, " \t");
+			const char *x = memchr(size.p, 'x', size.n);
+			int w = x ? span_atoi((struct span){size.p, (size_t)(x - size.p)}) : 0;
+			int h = x ? span_atoi((struct span){x + 1, (size_t)(size.p + size.n - x - 1)}) : 0;
+			if (w <= 0 || h <= 0) {
+				fprintf(stderr, "swwmrc:%d: rule size expects WIDTHxHEIGHT\n", lineno);
+				return false;
+			}
+			nr->result.set |= RULE_SET_SIZE;
+			nr->result.width = w;
+			nr->result.height = h;
+		} else {
+			fprintf(stderr, "swwmrc:%d: unknown rule action '%.*s'\n", lineno, (int)tok.n, tok.p);
+			return false;
+		}
+	}
+	if (!nr->result.set) {
+		fprintf(stderr, "swwmrc:%d: rule has no action\n", lineno);
+		return false;
+	}
+	return true;
+}
 
-int parser(struct swwm_server *server, Config *cfg)
+// rule : <field>=<value> ... : <action> ...
+static void parse_rule(Config *cfg, int lineno, struct span rest)
 {
-	char path[PATH_MAX];
-	const char *home = getenv("HOME");
-	if (!home) {
-		fprintf(stderr, "swwm: HOME not set, cannot find config\n");
-		return -1;
+	// Split at the last ':', a regex condition may hold one
+	const char *sep = NULL;
+	for (size_t i = rest.n; i-- > 0;) {
+		if (rest.p[i] == ':') {
+			sep = rest.p + i;
+			break;
+		}
+	}
+	if (!sep) {
+		fprintf(stderr, "swwmrc:%d: rule expects '<conditions> : <actions>'\n", lineno);
+		return;
 	}
+	struct span conds = {rest.p, (size_t)(sep - rest.p)};
+	struct span acts = span_trim((struct span){sep + 1, (size_t)(rest.p + rest.n - sep - 1)});
 
-	const char *xdg_config_home = getenv("XDG_CONFIG_HOME");
-    bool found_path = false;
+	struct rule nr = {0};
+	for (conds = span_trim(conds); conds.n; conds = span_trim(conds)) {
+		const char *eq = memchr(conds.p, '=', conds.n);
+		struct span name = span_trim((struct span){conds.p, eq ? (size_t)(eq - conds.p) : conds.n});
+		int f = 0;
+		while (f < RULE_FIELDS && !span_eq(name, rule_field_names[f])) {
+			f++;
+		}
+		if (!eq || f == RULE_FIELDS) {
+			fprintf(stderr, "swwmrc:%d: rule condition '%.*s' is not app_id=, title= or parent=\n",
+				lineno, (int)name.n, name.p);
+			return;
+		}
+		conds = span_trim((struct span){eq + 1, (size_t)(conds.p + conds.n - eq - 1)});
 
-	if (xdg_config_home) {
-		snprintf(path, sizeof path, "%s/swwm/swwmrc", xdg_config_home);
-		if (access(path, R_OK) == 0) { found_path = true; goto found; }
-        snprintf(path, sizeof path, "%s/swwmrc", xdg_config_home); // Old sxwm location
-		if (access(path, R_OK) == 0) { found_path = true; goto found; }
+		struct span value;
+		if (conds.n && conds.p[0] == '"') {
+			const char *quote = memchr(conds.p + 1, '"', conds.n - 1);
+			if (!quote) {
+				fprintf(stderr, "swwmrc:%d: unterminated quote in rule\n", lineno);
+				return;
+			}
+			value = (struct span){conds.p + 1, (size_t)(quote - conds.p - 1)};
+			conds.n -= (size_t)(quote + 1 - conds.p);
+			conds.p = quote + 1;
+		} else {
+			value = span_token(&conds, " \t");
+		}
+		if (!value.n) {
+			fprintf(stderr, "swwmrc:%d: empty value for rule %s\n", lineno, rule_field_names[f]);
+			return;
+		}
+		nr.match[f] = arena_strndup(&cfg->arena, value.p, value.n);
+		if (!nr.match[f]) {
+			return;
+		}
 	}
 
-	snprintf(path, sizeof path, "%s/.config/swwm/swwmrc", home);
-	if (access(path, R_OK) == 0) { found_path = true; goto found; }
-    snprintf(path, sizeof path, "%s/.config/sxwmrc", home); // Old sxwm location
-	if (access(path, R_OK) == 0) { found_path = true; goto found; }
-    
-	// Fallback to system-wide, e.g. /usr/local/share/swwm/swwmrc or /etc/swwmrc
-	snprintf(path, sizeof path, "/usr/local/share/swwm/swwmrc");
-	if (access(path, R_OK) == 0) { found_path = true; goto found; }
+	if (parse_rule_actions(&nr, lineno, acts)) {
+		add_rule(cfg, lineno, &nr);
+	}
+}
 
+static const char **build_argv_n(struct config_arena *arena, const char *cmd, size_t len);
 
-found:;
-    if (!found_path) {
-        fprintf(stderr, "swwm: no config file found.\n");
-        return -1; // No config found is an error for this parser
-    }
-    
-	FILE *f = fopen(path, "r");
-	if (!f) {
-		fprintf(stderr, "swwm: cannot open config %s: %s\n", path, strerror(errno));
-		return -1;
+// call / bind / workspace : <combo> : <action>
+static void parse_binding(Config *cfg, int lineno, enum config_key key, struct span rest)
+{
+	struct span combo, act;
+	if (!span_split(rest, ':', &combo, &act)) {
+		if (key == CFG_WORKSPACE) {
+			fprintf(stderr, "swwmrc:%d: workspace binding missing action part (e.g., 'move 1' or 'swap 1')\n", lineno);
+		} else {
+			fprintf(stderr, "swwmrc:%d: '%s' missing action/command part after keys\n", lineno, config_key_names[key]);
+		}
+		return;
 	}
-    fprintf(stdout, "swwm: loading config from %s\n", path);
 
+	xkb_keysym_t ks = XKB_KEY_NoSymbol;
+	uint32_t mods = parse_combo(combo, cfg, &ks);
+	if (ks == XKB_KEY_NoSymbol) {
+		fprintf(stderr, "swwmrc:%d: bad key in combo '%.*s'\n", lineno, (int)combo.n, combo.p);
+		return;
+	}
 
-	char line[512];
-	int lineno = 0;
-	
-    // Initialize should_float related parts of cfg
-    cfg->should_floatn = 0;
-    for (int j = 0; j < 256; j++) {
-		cfg->should_float[j] = NULL; // Will be allocated by build_argv logic if needed
+	// Resolve the action before taking a slot so a bad line leaves binds alone
+	Binding nb = { .mods = mods, .keysym = ks };
+	if (key == CFG_BIND) { // "bind" is for external commands
+		act = strip_quotes(act);
+		nb.type = TYPE_CMD;
+		nb.action.cmd = build_argv_n(&cfg->arena, act.p, act.n);
+		if (!nb.action.cmd) {
+			return;
+		}
+		nb.arg = (void *)nb.action.cmd; // For spawn_swwm
+	} else if (key == CFG_CALL) { // "call" is for internal functions
+		int fn = phash_find(&call_hash, act);
+		if (fn < 0) {
+			fprintf(stderr, "swwmrc:%d: unknown function '%.*s'\n", lineno, (int)act.n, act.p);
+			return;
+		}
+		nb.type = TYPE_FUNC;
+		nb.action.fn = call_table[fn].fn;
+	} else { // "move N" changes the view, "swap N" moves the focused window
+		struct span verb = span_token(&act, " \t");
+		act = span_trim(act);
+		bool move = span_eq(verb, "move");
+		if ((!move && !span_eq(verb, "swap")) || !act.n || !isdigit((unsigned char)act.p[0])) {
+			fprintf(stderr, "swwmrc:%d: invalid workspace action '%.*s'\n", lineno, (int)(act.p + act.n - verb.p), verb.p);
+			return;
+		}
+		int ws_num_parsed = span_atoi(act);
+		if (ws_num_parsed < 1 || ws_num_parsed > NUM_WORKSPACES) {
+			fprintf(stderr, "swwmrc:%d: invalid workspace number '%d' for '%s'\n", lineno, ws_num_parsed, move ? "move" : "swap");
+			return;
+		}
+		nb.type = move ? TYPE_CWKSP : TYPE_MWKSP;
+		nb.action.ws = ws_num_parsed - 1; // 0-indexed
+		nb.arg = (void *)(intptr_t)nb.action.ws;
 	}
 
+	Binding *b = alloc_bind(cfg, mods, ks);
+	if (!b) {
+		// alloc_bind already printed error
+		return;
+	}
+	*b = nb;
+}
 
-	while (fgets(line, sizeof line, f)) {
-		lineno++;
-		char *s = strip(line);
-		if (!*s || *s == '#') {
-			continue;
+static void parse_line(Config *cfg, int lineno, struct span line)
+{
+	struct span key, rest;
+	if (!span_split(line, ':', &key, &rest)) {
+		fprintf(stderr, "swwmrc:%d: missing ':' in line: %.*s\n", lineno, (int)line.n, line.p);
+		return;
+	}
+	rest = strip_comment(rest);
+
+	int k = phash_find(&config_key_hash, key);
+	switch (k) {
+	case CFG_MOD_KEY: {
+		uint32_t m = parse_combo(rest, cfg, NULL);
+		if (m != 0) { // Check if any known modifier was parsed
+			cfg->modkey = m;
+		} else {
+			fprintf(stderr, "swwmrc:%d: unknown mod_key '%.*s'\n", lineno, (int)rest.n, rest.p);
 		}
+		break;
+	}
+	case CFG_GAPS:
+		cfg->gaps = span_atoi(rest);
+		break;
+	case CFG_BORDER_WIDTH:
+		cfg->border_width = span_atoi(rest);
+		break;
+	case CFG_FOCUSED_BORDER_COLOUR:
+		cfg->border_foc_col_val = parse_col_span(rest);
+		break;
+	case CFG_UNFOCUSED_BORDER_COLOUR:
+		cfg->border_ufoc_col_val = parse_col_span(rest);
+		break;
+	case CFG_SWAP_BORDER_COLOUR:
+		cfg->border_swap_col_val = parse_col_span(rest);
+		break;
+	case CFG_MASTER_WIDTH: {
+		float mf = span_atoi(rest) / 100.0f;
+		if (mf < MF_MIN) mf = MF_MIN;
+		if (mf > MF_MAX) mf = MF_MAX;
+		for (int i = 0; i < MAX_MONITORS; i++) {
+			cfg->master_width[i] = mf;
+		}
+		break;
+	}
+	case CFG_MOTION_THROTTLE:
+	case CFG_MOTION_THROTTLE_HZ:
+		cfg->motion_throttle_hz = span_atoi(rest);
+		if (cfg->motion_throttle_hz <= 0) cfg->motion_throttle_hz = 60; // Default
+		break;
+	case CFG_RESIZE_MASTER_AMOUNT:
+		cfg->resize_master_amt = span_atoi(rest);
+		break;
+	case CFG_SNAP_DISTANCE:
+		cfg->snap_distance = span_atoi(rest);
+		break;
+	case CFG_OUTPUT_SCALE:
+		parse_output_scale(cfg, lineno, rest);
+		break;
+	case CFG_SHOULD_FLOAT:
+		parse_should_float(cfg, lineno, rest);
+		break;
+	case CFG_RULE:
+		parse_rule(cfg, lineno, rest);
+		break;
+	case CFG_CALL:
+	case CFG_BIND:
+	case CFG_WORKSPACE:
+		parse_binding(cfg, lineno, k, rest);
+		break;
+	default:
+		fprintf(stderr, "swwmrc:%d: unknown option '%.*s'\n", lineno, (int)key.n, key.p);
+		break;
+	}
+}
 
-		char *sep = strchr(s, ':');
-		if (!sep) {
-			fprintf(stderr, "swwmrc:%d: missing ':' in line: %s\n", lineno, s);
+int parse_config_buffer(const char *buf, size_t len, Config *cfg)
+{
+	if (!phash_init()) {
+		return -1;
+	}
+
+	cfg->rules = cfg->rules_last = NULL;
+	cfg->rulesn = 0;
+	cfg->matcher = NULL;
+
+	struct span rest = {buf, len};
+	int lineno = 0;
+	while (rest.n) {
+		const char *nl = memchr(rest.p, '\n', rest.n);
+		size_t n = nl ? (size_t)(nl - rest.p) : rest.n;
+		struct span line = span_trim((struct span){rest.p, n});
+		n += nl != NULL;
+		rest.p += n;
+		rest.n -= n;
+		lineno++;
+
+		if (!line.n || line.p[0] == '#') {
 			continue;
 		}
-		*sep = '\0';
-		char *key = strip(s);
-		char *rest = strip(sep + 1);
-        
-        // Remove trailing comments from 'rest'
-        char *comment_start = strchr(rest, '#');
-        if (comment_start && (comment_start == rest || isspace((unsigned char)*(comment_start-1)) ) ) {
-            *comment_start = '\0';
-            rest = strip(rest);
-        }
+		parse_line(cfg, lineno, line);
+	}
+
+	remap_and_dedupe_binds(cfg); // Must be done after all binds are potentially allocated
+	cfg->matcher = rules_compile(&cfg->arena, cfg->rules);
+	return 0;
+}
 
+int parse_config_file(const char *path, Config *cfg)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "swwm: cannot open config %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "swwm: cannot stat config %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
 
-		if (!strcmp(key, "mod_key")) {
-			uint32_t m = parse_mods_str(rest, cfg); // parse_mods_str itself doesn't use cfg->modkey
-			if (m != 0) { // Check if any known modifier was parsed
-				cfg->modkey = m;
-			} else {
-				fprintf(stderr, "swwmrc:%d: unknown mod_key '%s'\n", lineno, rest);
-			}
-		} else if (!strcmp(key, "gaps")) {
-			cfg->gaps = atoi(rest);
-		} else if (!strcmp(key, "border_width")) {
-			cfg->border_width = atoi(rest);
-		} else if (!strcmp(key, "focused_border_colour")) {
-			cfg->border_foc_col_val = parse_col_str(rest);
-		} else if (!strcmp(key, "unfocused_border_colour")) {
-			cfg->border_ufoc_col_val = parse_col_str(rest);
-		} else if (!strcmp(key, "swap_border_colour")) {
-			cfg->border_swap_col_val = parse_col_str(rest);
-		} else if (!strcmp(key, "master_width")) {
-			float mf = atoi(rest) / 100.0f;
-            if (mf < MF_MIN) mf = MF_MIN;
-            if (mf > MF_MAX) mf = MF_MAX;
-			for (int i = 0; i < MAX_MONITORS; i++) {
-				cfg->master_width[i] = mf;
-			}
-		} else if (!strcmp(key, "motion_throttle_hz")) {
-			cfg->motion_throttle_hz = atoi(rest);
-            if (cfg->motion_throttle_hz <= 0) cfg->motion_throttle_hz = 60; // Default
-		} else if (!strcmp(key, "resize_master_amount")) {
-			cfg->resize_master_amt = atoi(rest);
-		} else if (!strcmp(key, "snap_distance")) {
-			cfg->snap_distance = atoi(rest);
-		} else if (!strcmp(key, "should_float")) { // app_id,app_id2
-            if (cfg->should_floatn >= 256) {
-                fprintf(stderr, "swwmrc:%d: too many should_float entries\n", lineno);
-                continue;
-            }
-            char* app_id_list = strip(rest);
-            char* current_app_id = strtok(app_id_list, ",");
-            while(current_app_id != NULL) {
-                if (cfg->should_floatn < 256) {
-                    // Each entry in should_float is a single app_id string
-                    cfg->should_float[cfg->should_floatn++] = strdup(strip(current_app_id));
-                } else {
-                    fprintf(stderr, "swwmrc:%d: ran out of space for should_float entries\n", lineno);
-                    break;
-                }
-                current_app_id = strtok(NULL, ",");
-            }
-        } else if (!strcmp(key, "call") || !strcmp(key, "bind")) {
-			char *mid = strchr(rest, ':');
-			if (!mid) {
-				fprintf(stderr, "swwmrc:%d: '%s' missing action/command part after keys\n", lineno, key);
-				continue;
+	// read(), not mmap: an editor truncating the file mid-parse must not
+	// SIGBUS the compositor. Read to EOF in case it grew since the fstat.
+	size_t cap = (size_t)st.st_size + 1, len = 0;
+	char *buf = malloc(cap);
+	while (buf) {
+		if (len == cap) {
+			char *grown = realloc(buf, cap * 2);
+			if (!grown) {
+				free(buf);
+				buf = NULL;
+				break;
 			}
-			*mid = '\0';
-			char *combo_str = strip(rest);
-			char *act_str = strip(mid + 1);
+			buf = grown;
+			cap *= 2;
+		}
+		ssize_t n = read(fd, buf + len, cap - len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			fprintf(stderr, "swwm: cannot read config %s: %s\n", path, strerror(errno));
+			free(buf);
+			close(fd);
+			return -1;
+		}
+		if (n == 0) {
+			break;
+		}
+		len += (size_t)n;
+	}
+	close(fd);
+	if (!buf) {
+		fprintf(stderr, "swwm: out of memory reading config %s\n", path);
+		return -1;
+	}
+	int ret = parse_config_buffer(buf, len, cfg);
+	free(buf);
+	return ret;
+}
 
-			uint32_t mods = parse_mods_str(combo_str, cfg);
-            xkb_keysym_t ks = parse_keysym_part(combo_str);
 
-			if (ks == XKB_KEY_NoSymbol) {
-				fprintf(stderr, "swwmrc:%d: bad key in combo '%s'\n", lineno, combo_str);
-				continue;
-			}
-			Binding *b = alloc_bind(cfg, mods, ks);
-			if (!b) {
-				// alloc_bind already printed error
-				continue; 
-			}
+config_call_fn config_find_call(const char *name, size_t len)
+{
+	if (!phash_init()) {
+		return NULL;
+	}
+	int fn = phash_find(&call_hash, (struct span){ name, len });
+	return fn < 0 ? NULL : call_table[fn].fn;
+}
 
-			if (!strcmp(key, "bind")) { // "bind" is for external commands
-				b->type = TYPE_CMD;
-				b->action.cmd = build_argv(strip_quotes(act_str));
-                b->arg = (void*)b->action.cmd; // For spawn_swwm
-			} else { // "call" is for internal functions
-				b->type = TYPE_FUNC;
-				bool found_fn = false;
-				for (int i = 0; call_table[i].name; i++) {
-					if (!strcmp(act_str, call_table[i].name)) {
-						b->action.fn = call_table[i].fn;
-                        b->arg = NULL; // No specific arg for these simple functions
-						found_fn = true;
-						break;
-					}
-				}
-				if (!found_fn) {
-					fprintf(stderr, "swwmrc:%d: unknown function '%s'\n", lineno, act_str);
-                    // Invalidate this binding
-                    b->keysym = XKB_KEY_NoSymbol; 
-                    cfg->bindsn--; // Effectively remove it
-				}
-			}
-		} else if (!strcmp(key, "workspace")) {
-			char *mid = strchr(rest, ':');
-			if (!mid) {
-				fprintf(stderr, "swwmrc:%d: workspace binding missing action part (e.g., 'move 1' or 'swap 1')\n", lineno);
-				continue;
-			}
-			*mid = '\0';
-			char *combo_str = strip(rest);
-			char *act_str = strip(mid + 1);
 
-			uint32_t mods = parse_mods_str(combo_str, cfg);
-            xkb_keysym_t ks = parse_keysym_part(combo_str);
+bool config_find_path(char *path, size_t size)
+{
+	const char *home = getenv("HOME");
+	if (!home) {
+		fprintf(stderr, "swwm: HOME not set, cannot find config\n");
+		return false;
+	}
 
-			if (ks == XKB_KEY_NoSymbol) {
-				fprintf(stderr, "swwmrc:%d: bad key in workspace combo '%s'\n", lineno, combo_str);
-				continue;
-			}
-			Binding *b = alloc_bind(cfg, mods, ks);
-			if (!b) {
-				continue;
-			}
+	const char *xdg_config_home = getenv("XDG_CONFIG_HOME");
 
-			int ws_num_parsed;
-			if (sscanf(act_str, "move %d", &ws_num_parsed) == 1) {
-				if (ws_num_parsed >= 1 && ws_num_parsed <= NUM_WORKSPACES) {
-					b->type = TYPE_CWKSP; // Change current view to workspace
-					b->action.ws = ws_num_parsed - 1; // 0-indexed
-                    b->arg = (void*)(intptr_t)b->action.ws;
-				} else {
-					fprintf(stderr, "swwmrc:%d: invalid workspace number '%d' for 'move'\n", lineno, ws_num_parsed);
-				}
-			} else if (sscanf(act_str, "swap %d", &ws_num_parsed) == 1) {
-                 if (ws_num_parsed >= 1 && ws_num_parsed <= NUM_WORKSPACES) {
-					b->type = TYPE_MWKSP; // Move focused window to workspace
-					b->action.ws = ws_num_parsed - 1; // 0-indexed
-                    b->arg = (void*)(intptr_t)b->action.ws;
-				} else {
-					fprintf(stderr, "swwmrc:%d: invalid workspace number '%d' for 'swap'\n", lineno, ws_num_parsed);
-				}
-			} else {
-				fprintf(stderr, "swwmrc:%d: invalid workspace action '%s'\n", lineno, act_str);
-			}
-		}
-		else {
-			fprintf(stderr, "swwmrc:%d: unknown option '%s'\n", lineno, key);
-		}
+	if (xdg_config_home) {
+		snprintf(path, size, "%s/swwm/swwmrc", xdg_config_home);
+		if (access(path, R_OK) == 0) return true;
+        snprintf(path, size, "%s/swwmrc", xdg_config_home); // Old sxwm location
+		if (access(path, R_OK) == 0) return true;
 	}
 
-	fclose(f);
-	remap_and_dedupe_binds(cfg); // Must be done after all binds are potentially allocated
-	return 0;
+	snprintf(path, size, "%s/.config/swwm/swwmrc", home);
+	if (access(path, R_OK) == 0) return true;
+    snprintf(path, size, "%s/.config/sxwmrc", home); // Old sxwm location
+	if (access(path, R_OK) == 0) return true;
+    
+	// Fallback to system-wide, e.g. /usr/local/share/swwm/swwmrc or /etc/swwmrc
+	snprintf(path, size, "/usr/local/share/swwm/swwmrc");
+	if (access(path, R_OK) == 0) return true;
+
+	return false;
+}
+
+int parser(struct swwm_server *server, Config *cfg)
+{
+	(void)server;
+	char path[PATH_MAX];
+    if (!config_find_path(path, sizeof path)) {
+        fprintf(stderr, "swwm: no config file found.\n");
+        return -1; // No config found is an error for this parser
+    }
+
+    fprintf(stdout, "swwm: loading config from %s\n", path);
+	return parse_config_file(path, cfg);
 }
 
 
@@ -416,67 +938,123 @@ xkb_keysym_t parse_keysym_str(const char *key_str) {
 
 
 unsigned long parse_col_str(const char *hex) {
-    // This is a placeholder. XParseColor is X11 specific.
-    // For Wayland, you'd typically parse into R, G, B, A components
-    // and store them or a combined uint32_t.
-    // Example: #RRGGBB or #AARRGGBB
-    // For simplicity, let's just try to convert hex string to long.
-    // This won't be directly usable for wlr_renderer without further processing.
-    if (!hex || hex[0] != '#') return 0; // Invalid format
-    char *endptr;
-    unsigned long val = strtoul(hex + 1, &endptr, 16);
-    if (*endptr != '\0') {
-        fprintf(stderr, "swwm: invalid color string '%s'\n", hex);
-        return 0; // Or a default color
-    }
-    // If it's RRGGBB, we might want to add full alpha FF000000
-    if (strlen(hex + 1) == 6) { // RRGGBB
-        val |= 0xFF000000; // Assume full alpha, set AARRGGBB for wlr_render_rect
-    } else if (strlen(hex+1) == 8) { // AARRGGBB
-        // It's already in AARRGGBB, but typical web is RRGGBBAA
-        // Let's assume #RRGGBB for now and add FF alpha
-        // Or if #AARRGGBB is expected, this logic needs to be more robust
-    }
-    return val; // This value is not directly usable as pixel for X11.
-                // For wlroots, if drawing, this might be an AARRGGBB or RRGGBBAA value.
+    if (!hex) return 0;
+    return parse_col_span((struct span){hex, strlen(hex)});
 }
 
 
-const char **build_argv(const char *cmd)
+static const char **build_argv_n(struct config_arena *arena, const char *cmd, size_t len)
 {
-	char *dup = strdup(cmd);
-    if (!dup) {
-        perror("strdup in build_argv");
-        return NULL;
-    }
+	// Count first so the pointer array is exactly as long as needed
+	struct span rest = {cmd, len};
+	size_t argc = 0;
+	while (argc < MAX_ARGS - 1 && span_token(&rest, " \t").n) {
+		argc++;
+	}
 
-	char *saveptr = NULL;
-	const char **argv = malloc(MAX_ARGS * sizeof(*argv));
-    if (!argv) {
-        perror("malloc for argv in build_argv");
-        free(dup);
-        return NULL;
-    }
-	int i = 0;
-
-    // strtok_r is safer than strtok
-	char *tok = strtok_r(dup, " \t", &saveptr);
-	while (tok && i < MAX_ARGS - 1) {
-        // sxwm's parser had more complex quote handling. This is simplified.
-        // It assumes arguments are space-separated. Quotes are part of the arg.
-        // For more robust shell-like parsing, a small state machine is needed.
-        argv[i++] = strdup(tok);
-        if (!argv[i-1]) {
-            perror("strdup for argv element");
-            // Free previously strdup'd elements
-            for (int k = 0; k < i - 1; ++k) free((void*)argv[k]);
-            free(argv);
-            free(dup);
-            return NULL;
-        }
-		tok = strtok_r(NULL, " \t", &saveptr);
+	const char **argv = config_arena_alloc(arena, (argc + 1) * sizeof(*argv), sizeof(void *));
+	if (!argv) {
+		return NULL;
+	}
+	rest = (struct span){cmd, len};
+	for (size_t i = 0; i < argc; i++) {
+		// sxwm's parser had more complex quote handling. This is simplified.
+		// It assumes arguments are space-separated. Quotes are part of the arg.
+		// For more robust shell-like parsing, a small state machine is needed.
+		struct span tok = span_token(&rest, " \t");
+		argv[i] = arena_strndup(arena, tok.p, tok.n);
+		if (!argv[i]) {
+			return NULL;
+		}
 	}
-	argv[i] = NULL;
-	free(dup);
+	argv[argc] = NULL;
 	return argv;
 }
+
+const char **build_argv(struct config_arena *arena, const char *cmd)
+{
+	return build_argv_n(arena, cmd, strlen(cmd));
+}
+
+void config_free(Config *cfg)
+{
+	rules_matcher_free(cfg->matcher);
+	config_arena_release(&cfg->arena);
+	cfg->bindsn = 0;
+	cfg->rules = cfg->rules_last = NULL;
+	cfg->rulesn = 0;
+	cfg->matcher = NULL;
+}
+
+bool config_should_float(const Config *cfg, const char *app_id)
+{
+	struct rule_cache cache;
+	rules_eval(cfg->matcher, &cache, app_id, NULL, NULL);
+	return (cache.result.set & RULE_SET_FLOAT) && cache.result.floating;
+}
+
+static bool argv_equal(const char **a, const char **b)
+{
+	if (!a || !b) {
+		return a == b;
+	}
+	for (; *a && *b; a++, b++) {
+		if (strcmp(*a, *b) != 0) {
+			return false;
+		}
+	}
+	return !*a && !*b;
+}
+
+static bool bind_equal(const Binding *a, const Binding *b)
+{
+	if (a->mods != b->mods || a->keysym != b->keysym || a->type != b->type) {
+		return false;
+	}
+	switch (a->type) {
+	case TYPE_CMD:
+		return argv_equal(a->action.cmd, b->action.cmd);
+	case TYPE_FUNC:
+		return a->action.fn == b->action.fn;
+	default:
+		return a->action.ws == b->action.ws;
+	}
+}
+
+bool config_binds_equal(const Config *a, const Config *b)
+{
+	if (a->bindsn != b->bindsn) {
+		return false;
+	}
+	for (int i = 0; i < a->bindsn; i++) {
+		if (!bind_equal(&a->binds[i], &b->binds[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool config_rules_equal(const Config *a, const Config *b)
+{
+	return a->rulesn == b->rulesn && rules_equal(a->rules, b->rules);
+}
+
+void config_take_data(Config *dst, Config *src)
+{
+	struct config_arena old = dst->arena;
+	struct rule_matcher *old_matcher = dst->matcher;
+	memcpy(dst->binds, src->binds, sizeof(Binding) * (size_t)src->bindsn);
+	dst->bindsn = src->bindsn;
+	dst->rules = src->rules;
+	dst->rules_last = src->rules_last;
+	dst->rulesn = src->rulesn;
+	dst->matcher = src->matcher;
+	dst->arena = src->arena;
+
+	// src keeps dst's old arena and matcher, released with it
+	src->arena = old;
+	src->matcher = old_matcher;
+	src->bindsn = 0;
+	src->rules = src->rules_last = NULL;
+	src->rulesn = 0;
+}
@@ -4,10 +4,23 @@
 
 #define MAX_ARGS 64 // Already in defs.h, keep for direct include
 
-const char **build_argv(const char *cmd);
+const char **build_argv(struct config_arena *arena, const char *cmd); // Allocated from arena
 int parser(struct swwm_server *server, Config *user_config); // Now takes server for potential immediate actions or logging
+bool config_find_path(char *path, size_t size); // First readable swwmrc in search order
+int parse_config_file(const char *path, Config *user_config); // reads path, see parse_config_buffer
+int parse_config_buffer(const char *buf, size_t len, Config *user_config); // buf need not be NUL-terminated
+void config_free(Config *user_config); // Releases the arena behind binds and rules
+void *config_arena_alloc(struct config_arena *arena, size_t n, size_t align);
+void config_arena_release(struct config_arena *arena);
+bool config_should_float(const Config *cfg, const char *app_id);
+// The function a `call` binding of this name runs, NULL if there is none
+typedef void (*config_call_fn)(struct swwm_server *server, const void *arg);
+config_call_fn config_find_call(const char *name, size_t len);
+// Reload helpers: compare two parsed configs; move binds, rules and the
+// arena they live in from src to dst (dst's old arena goes to src)
+bool config_binds_equal(const Config *a, const Config *b);
+bool config_rules_equal(const Config *a, const Config *b);
+void config_take_data(Config *dst, Config *src);
 uint32_t parse_mods_str(const char *mods_str, Config *user_config); // Renamed to avoid conflict if any
 xkb_keysym_t parse_keysym_str(const char *key_str); // Renamed
 unsigned long parse_col_str(const char *hex); // For color parsing
-
-#endif // PARSER_H
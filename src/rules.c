@@ -0,0 +1,400 @@
+#define _POSIX_C_SOURCE 200809L
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "rules.h"
+
+struct rule_exact {
+	const char *value; // NULL for an empty slot
+	struct rule_bits rules;
+};
+
+struct rule_pattern {
+	int rule;
+	regex_t re;
+};
+
+struct rule_field_matcher {
+	struct rule_bits any; // Rules with no condition on this field
+	struct rule_exact *exact; // Open addressing, exact_mask + 1 slots
+	size_t exact_mask;
+	struct rule_pattern *patterns;
+	int patternsn;
+	regex_t prefilter; // Every pattern of the field as one alternation
+	bool has_prefilter;
+};
+
+struct rule_matcher {
+	const struct rule **rules; // In file order, index = bit
+	int rulesn;
+	uint32_t fields_used; // Bit per field some rule has a condition on
+	struct rule_field_matcher field[RULE_FIELDS];
+};
+
+static void bits_set(struct rule_bits *b, int i)
+{
+	b->w[i / 64] |= 1ull << (i % 64);
+}
+
+static void bits_or(struct rule_bits *dst, const struct rule_bits *src)
+{
+	for (size_t i = 0; i < RULES_MAX / 64; i++) {
+		dst->w[i] |= src->w[i];
+	}
+}
+
+static void bits_and(struct rule_bits *dst, const struct rule_bits *src)
+{
+	for (size_t i = 0; i < RULES_MAX / 64; i++) {
+		dst->w[i] &= src->w[i];
+	}
+}
+
+static bool bits_equal(const struct rule_bits *a, const struct rule_bits *b)
+{
+	for (size_t i = 0; i < RULES_MAX / 64; i++) {
+		if (a->w[i] != b->w[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t hash_str(const char *s)
+{
+	uint32_t h = 2166136261u;
+	for (; *s; s++) {
+		h = (h ^ (unsigned char)*s) * 16777619u;
+	}
+	return h;
+}
+
+static bool is_regex(const char *s)
+{
+	size_t len = strlen(s);
+	return len >= 2 && s[0] == '/' && s[len - 1] == '/';
+}
+
+static bool is_pattern(const char *s)
+{
+	return is_regex(s) || strpbrk(s, "*?[") != NULL;
+}
+
+// A rule pattern as an extended regex: /re/ as is, a glob anchored at both
+// ends with everything but * ? and [...] escaped
+static char *pattern_to_ere(const char *s)
+{
+	size_t len = strlen(s);
+	if (is_regex(s)) {
+		return strndup(s + 1, len - 2);
+	}
+	char *ere = malloc(2 * len + 3);
+	if (!ere) {
+		return NULL;
+	}
+	char *o = ere;
+	*o++ = '^';
+	for (const char *p = s; *p; p++) {
+		if (*p == '*') {
+			*o++ = '.';
+			*o++ = '*';
+		} else if (*p == '?') {
+			*o++ = '.';
+		} else if (*p == '[' && strchr(p + 1 + (p[1] == '!'), ']')) {
+			// Character class, [!...] negates as in the shell
+			const char *end = strchr(p + 1 + (p[1] == '!'), ']');
+			*o++ = *p++;
+			if (*p == '!') {
+				*o++ = '^';
+				p++;
+			}
+			while (p < end) {
+				*o++ = *p++;
+			}
+			*o++ = ']';
+		} else {
+			if (strchr(".^$+(){}|\\[]", *p)) {
+				*o++ = '\\';
+			}
+			*o++ = *p;
+		}
+	}
+	*o++ = '$';
+	*o = '\0';
+	return ere;
+}
+
+static struct rule_exact *exact_slot(const struct rule_field_matcher *fm, const char *value)
+{
+	// The table is at least twice the number of values, so this ends
+	for (size_t i = hash_str(value) & fm->exact_mask;; i = (i + 1) & fm->exact_mask) {
+		struct rule_exact *e = &fm->exact[i];
+		if (!e->value || !strcmp(e->value, value)) {
+			return e;
+		}
+	}
+}
+
+static bool compile_field(struct config_arena *arena, struct rule_matcher *m, enum rule_field f)
+{
+	struct rule_field_matcher *fm = &m->field[f];
+	int exact = 0, patterns = 0;
+	for (int i = 0; i < m->rulesn; i++) {
+		const char *v = m->rules[i]->match[f];
+		if (!v) {
+			bits_set(&fm->any, i);
+		} else if (is_pattern(v)) {
+			patterns++;
+		} else {
+			exact++;
+		}
+	}
+	if (exact + patterns) {
+		m->fields_used |= 1u << f;
+	}
+
+	if (exact) {
+		size_t size = 8;
+		while (size < 2 * (size_t)exact) {
+			size *= 2;
+		}
+		fm->exact = config_arena_alloc(arena, size * sizeof(*fm->exact), sizeof(uint64_t));
+		if (!fm->exact) {
+			return false;
+		}
+		memset(fm->exact, 0, size * sizeof(*fm->exact));
+		fm->exact_mask = size - 1;
+		for (int i = 0; i < m->rulesn; i++) {
+			const char *v = m->rules[i]->match[f];
+			if (v && !is_pattern(v)) {
+				struct rule_exact *e = exact_slot(fm, v);
+				e->value = v;
+				bits_set(&e->rules, i);
+			}
+		}
+	}
+
+	if (patterns) {
+		fm->patterns = config_arena_alloc(arena, (size_t)patterns * sizeof(*fm->patterns), sizeof(uint64_t));
+		if (!fm->patterns) {
+			return false;
+		}
+		char *all = NULL;
+		size_t all_len = 0;
+		for (int i = 0; i < m->rulesn; i++) {
+			const char *v = m->rules[i]->match[f];
+			if (!v || !is_pattern(v)) {
+				continue;
+			}
+			char *ere = pattern_to_ere(v);
+			if (!ere) {
+				free(all);
+				return false;
+			}
+			struct rule_pattern *p = &fm->patterns[fm->patternsn];
+			int err = regcomp(&p->re, ere, REG_EXTENDED | REG_NOSUB);
+			if (err != 0) {
+				// The rule stays, but can never match on this field
+				char msg[128];
+				regerror(err, &p->re, msg, sizeof(msg));
+				fprintf(stderr, "swwmrc: rule %d: bad pattern '%s': %s\n", i + 1, v, msg);
+				free(ere);
+				continue;
+			}
+			p->rule = i;
+			fm->patternsn++;
+
+			size_t len = strlen(ere);
+			char *grown = realloc(all, all_len + len + 4);
+			if (!grown) {
+				free(ere);
+				free(all);
+				return false;
+			}
+			all = grown;
+			all_len += (size_t)sprintf(all + all_len, "%s(%s)", all_len ? "|" : "", ere);
+			free(ere);
+		}
+		// One pass of the combined automaton rules out the common case of no
+		// pattern matching; only then are patterns tried one by one
+		if (fm->patternsn > 1) {
+			fm->has_prefilter = regcomp(&fm->prefilter, all, REG_EXTENDED | REG_NOSUB) == 0;
+		}
+		free(all);
+	}
+	return true;
+}
+
+struct rule_matcher *rules_compile(struct config_arena *arena, const struct rule *rules)
+{
+	int n = 0;
+	for (const struct rule *r = rules; r && n < RULES_MAX; r = r->next) {
+		n++;
+	}
+	if (n == 0) {
+		return NULL;
+	}
+
+	struct rule_matcher *m = config_arena_alloc(arena, sizeof(*m), sizeof(uint64_t));
+	const struct rule **list = config_arena_alloc(arena, (size_t)n * sizeof(*list), sizeof(void *));
+	if (!m || !list) {
+		return NULL;
+	}
+	memset(m, 0, sizeof(*m));
+	m->rules = list;
+	for (const struct rule *r = rules; m->rulesn < n; r = r->next) {
+		list[m->rulesn++] = r;
+	}
+	for (int f = 0; f < RULE_FIELDS; f++) {
+		if (!compile_field(arena, m, f)) {
+			fprintf(stderr, "swwm: out of memory compiling window rules\n");
+			rules_matcher_free(m);
+			return NULL;
+		}
+	}
+	return m;
+}
+
+void rules_matcher_free(struct rule_matcher *m)
+{
+	if (!m) {
+		return;
+	}
+	// Everything else lives in the config arena
+	for (int f = 0; f < RULE_FIELDS; f++) {
+		struct rule_field_matcher *fm = &m->field[f];
+		for (int i = 0; i < fm->patternsn; i++) {
+			regfree(&fm->patterns[i].re);
+		}
+		if (fm->has_prefilter) {
+			regfree(&fm->prefilter);
+		}
+		fm->patternsn = 0;
+		fm->has_prefilter = false;
+	}
+}
+
+static bool str_equal(const char *a, const char *b)
+{
+	return a == b || (a && b && !strcmp(a, b));
+}
+
+static bool result_equal(const struct rule_result *a, const struct rule_result *b)
+{
+	return a->set == b->set &&
+		(!(a->set & RULE_SET_FLOAT) || a->floating == b->floating) &&
+		(!(a->set & RULE_SET_WORKSPACE) || a->workspace == b->workspace) &&
+		(!(a->set & RULE_SET_OUTPUT) || !strcmp(a->output, b->output)) &&
+		(!(a->set & RULE_SET_SIZE) || (a->width == b->width && a->height == b->height));
+}
+
+bool rules_equal(const struct rule *a, const struct rule *b)
+{
+	for (; a && b; a = a->next, b = b->next) {
+		for (int f = 0; f < RULE_FIELDS; f++) {
+			if (!str_equal(a->match[f], b->match[f])) {
+				return false;
+			}
+		}
+		if (!result_equal(&a->result, &b->result)) {
+			return false;
+		}
+	}
+	return !a && !b;
+}
+
+bool rules_field_used(const struct rule_matcher *m, enum rule_field field)
+{
+	return m && (m->fields_used & (1u << field));
+}
+
+static void match_field(const struct rule_matcher *m, enum rule_field f, const char *value,
+	struct rule_bits *out)
+{
+	const struct rule_field_matcher *fm = &m->field[f];
+	*out = fm->any;
+	// An unset field (no title yet, no parent) fails every condition on
+	// it, so `parent=*` only matches windows that have a parent
+	if (!value) {
+		return;
+	}
+	if (fm->exact) {
+		const struct rule_exact *e = exact_slot(fm, value);
+		if (e->value) {
+			bits_or(out, &e->rules);
+		}
+	}
+	if (fm->patternsn && (!fm->has_prefilter || regexec(&fm->prefilter, value, 0, NULL, 0) == 0)) {
+		for (int i = 0; i < fm->patternsn; i++) {
+			if (regexec(&fm->patterns[i].re, value, 0, NULL, 0) == 0) {
+				bits_set(out, fm->patterns[i].rule);
+			}
+		}
+	}
+}
+
+// Combines the per-field matches; true if the result changed
+static bool cache_combine(const struct rule_matcher *m, struct rule_cache *cache)
+{
+	struct rule_bits matched = cache->field[0];
+	for (int f = 1; f < RULE_FIELDS; f++) {
+		bits_and(&matched, &cache->field[f]);
+	}
+	if (bits_equal(&matched, &cache->matched)) {
+		return false;
+	}
+	cache->matched = matched;
+
+	// Bits are in file order, so later rules override earlier ones
+	struct rule_result result = {0};
+	for (int w = 0; w < RULES_MAX / 64; w++) {
+		for (uint64_t bits = matched.w[w]; bits; bits &= bits - 1) {
+			const struct rule_result *r = &m->rules[w * 64 + __builtin_ctzll(bits)]->result;
+			if (r->set & RULE_SET_FLOAT) {
+				result.floating = r->floating;
+			}
+			if (r->set & RULE_SET_WORKSPACE) {
+				result.workspace = r->workspace;
+			}
+			if (r->set & RULE_SET_OUTPUT) {
+				memcpy(result.output, r->output, sizeof(result.output));
+			}
+			if (r->set & RULE_SET_SIZE) {
+				result.width = r->width;
+				result.height = r->height;
+			}
+			result.set |= r->set;
+		}
+	}
+	if (result_equal(&result, &cache->result)) {
+		return false;
+	}
+	cache->result = result;
+	return true;
+}
+
+bool rules_update(const struct rule_matcher *m, struct rule_cache *cache,
+	enum rule_field field, const char *value)
+{
+	if (!m) {
+		return false;
+	}
+	match_field(m, field, value, &cache->field[field]);
+	return cache_combine(m, cache);
+}
+
+void rules_eval(const struct rule_matcher *m, struct rule_cache *cache,
+	const char *app_id, const char *title, const char *parent)
+{
+	memset(cache, 0, sizeof(*cache));
+	if (!m) {
+		return;
+	}
+	match_field(m, RULE_APP_ID, app_id, &cache->field[RULE_APP_ID]);
+	match_field(m, RULE_TITLE, title, &cache->field[RULE_TITLE]);
+	match_field(m, RULE_PARENT, parent, &cache->field[RULE_PARENT]);
+	cache_combine(m, cache);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+struct config_arena;
+
+// Window rules (rules.c). A rule matches on app_id, title and the parent
+// window's app_id, and sets floating, workspace, output and/or size:
+//
+//   rule : app_id=firefox title="Picture-in-Picture" : float size 640x360
+//   rule : app_id=/^(steam|lutris)$/ : workspace 5
+//   rule : parent=* : float
+//
+// A plain value matches exactly, one containing * ? or [ is a glob over the
+// whole string, /.../ is a POSIX extended regex. A field the window does not
+// have (no parent, no title yet) matches no condition, not even `*`.
+// `should_float : a, b` adds one float rule per app_id. Rules apply in file
+// order, later ones win. Workspace, output and size apply when a window
+// maps; float/tile also follows later app_id, title and parent changes and
+// config reloads. The parent's own app_id is read when the window maps or
+// is re-parented, not followed afterwards.
+//
+// At config load the rules are compiled per field into a hash table of
+// exact values and, for globs and regexes, one combined regex that answers
+// "does any pattern match" before the patterns are tried one by one. Each
+// toplevel caches the set of rules matching each of its fields, so a
+// property change re-matches one field, and title changes cost nothing
+// unless some rule looks at titles.
+
+enum rule_field {
+	RULE_APP_ID,
+	RULE_TITLE,
+	RULE_PARENT,
+	RULE_FIELDS,
+};
+
+enum {
+	RULE_SET_FLOAT = 1 << 0,
+	RULE_SET_WORKSPACE = 1 << 1,
+	RULE_SET_OUTPUT = 1 << 2,
+	RULE_SET_SIZE = 1 << 3,
+};
+
+#define RULES_MAX 256
+
+struct rule_result {
+	uint32_t set; // RULE_SET_*
+	bool floating;
+	int workspace; // 0-indexed
+	char output[64];
+	int width, height;
+};
+
+// A rule as written in swwmrc, allocated from the config arena
+struct rule {
+	struct rule *next;
+	const char *match[RULE_FIELDS]; // NULL matches anything
+	struct rule_result result;
+};
+
+struct rule_bits {
+	uint64_t w[RULES_MAX / 64];
+};
+
+// Per-toplevel match state, see rules_update
+struct rule_cache {
+	struct rule_bits field[RULE_FIELDS];
+	struct rule_bits matched;
+	struct rule_result result;
+};
+
+struct rule_matcher;
+
+// Compiles rules into a matcher; tables go in arena, compiled regexes need
+// rules_matcher_free. NULL when there are no rules or on failure.
+struct rule_matcher *rules_compile(struct config_arena *arena, const struct rule *rules);
+void rules_matcher_free(struct rule_matcher *matcher);
+bool rules_equal(const struct rule *a, const struct rule *b);
+
+bool rules_field_used(const struct rule_matcher *matcher, enum rule_field field);
+// Re-matches one field (NULL if unset); true if cache->result changed
+bool rules_update(const struct rule_matcher *matcher, struct rule_cache *cache,
+	enum rule_field field, const char *value);
+// Matches all fields from scratch
+void rules_eval(const struct rule_matcher *matcher, struct rule_cache *cache,
+	const char *app_id, const char *title, const char *parent);
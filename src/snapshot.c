@@ -0,0 +1,218 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/log.h>
+
+#include "snapshot.h"
+#include "swwm.h"
+
+// Checked at compile time: the layout is fixed for readers
+typedef char snapshot_outputs_match[SWWM_SNAPSHOT_OUTPUTS == MAX_MONITORS ? 1 : -1];
+typedef char snapshot_workspaces_match[SWWM_SNAPSHOT_WORKSPACES == NUM_WORKSPACES ? 1 : -1];
+
+struct swwm_snapshot_writer {
+	struct swwm_server *server;
+	struct swwm_snapshot *shared; // The mapping readers see
+	char path[4096];
+	struct wl_event_source *idle; // Pending rewrite, NULL when clean
+	uint64_t updates;
+};
+
+static void copy_str(char *dst, size_t size, const char *src)
+{
+	snprintf(dst, size, "%s", src ? src : "");
+}
+
+static int output_index(struct swwm_server *server, struct swwm_output *output)
+{
+	int i = 0;
+	struct swwm_output *iter;
+	wl_list_for_each(iter, &server->outputs, link) {
+		if (iter == output) {
+			return i < SWWM_SNAPSHOT_OUTPUTS ? i : -1;
+		}
+		i++;
+	}
+	return -1;
+}
+
+static void fill_toplevel(struct swwm_snapshot_toplevel *t, struct swwm_toplevel *toplevel)
+{
+	t->id = toplevel->id;
+	t->workspace = toplevel->ws_idx;
+	t->floating = toplevel->floating;
+	t->fullscreen = toplevel->fullscreen;
+	t->focused = toplevel == toplevel->server->focused_toplevel;
+	t->x = toplevel->geom.x;
+	t->y = toplevel->geom.y;
+	t->width = toplevel->geom.width;
+	t->height = toplevel->geom.height;
+	copy_str(t->app_id, sizeof(t->app_id), toplevel->xdg_toplevel->app_id);
+	copy_str(t->title, sizeof(t->title), toplevel->xdg_toplevel->title);
+}
+
+// Writes the state straight into the mapping; readers retry while seq is odd
+static void snapshot_write(struct swwm_snapshot_writer *writer)
+{
+	struct swwm_server *server = writer->server;
+	struct swwm_snapshot *s = writer->shared;
+	uint32_t seq = s->seq;
+	__atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	s->current_workspace = server->current_ws_idx;
+	s->focused_toplevel = server->focused_toplevel ? server->focused_toplevel->id : 0;
+
+	s->noutputs = 0;
+	struct swwm_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (s->noutputs == SWWM_SNAPSHOT_OUTPUTS) {
+			break;
+		}
+		struct swwm_snapshot_output *o = &s->outputs[s->noutputs++];
+		struct wlr_box box;
+		wlr_output_layout_get_box(server->output_layout, output->wlr_output, &box);
+		copy_str(o->name, sizeof(o->name), output->wlr_output->name);
+		o->x = box.x;
+		o->y = box.y;
+		o->width = box.width;
+		o->height = box.height;
+		o->scale = output->wlr_output->scale;
+		o->workspace = output->active_ws;
+	}
+
+	s->ntoplevels = s->ntoplevels_total = 0;
+	for (int i = 0; i < NUM_WORKSPACES; i++) {
+		struct swwm_workspace *ws = &server->workspaces[i];
+		struct swwm_snapshot_workspace *w = &s->workspaces[i];
+		w->output = output_index(server, ws->output);
+		w->tiled = (uint16_t)wl_list_length(&ws->toplevels);
+		w->floating = (uint16_t)wl_list_length(&ws->floating_toplevels);
+
+		struct wl_list *lists[] = { &ws->toplevels, &ws->floating_toplevels };
+		for (size_t l = 0; l < LENGTH(lists); l++) {
+			struct swwm_toplevel *toplevel;
+			wl_list_for_each(toplevel, lists[l], workspace_link) {
+				if (s->ntoplevels < SWWM_SNAPSHOT_TOPLEVELS) {
+					fill_toplevel(&s->toplevels[s->ntoplevels++], toplevel);
+				}
+				s->ntoplevels_total++;
+			}
+		}
+	}
+
+	__atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+	writer->updates++;
+}
+
+static void snapshot_handle_idle(void *data)
+{
+	struct swwm_snapshot_writer *writer = data;
+	writer->idle = NULL; // Idle sources fire once and are freed by the loop
+	snapshot_write(writer);
+}
+
+void snapshot_mark_dirty(struct swwm_server *server)
+{
+	struct swwm_snapshot_writer *writer = server->snapshot;
+	if (!writer || writer->idle) {
+		return;
+	}
+	writer->idle = wl_event_loop_add_idle(wl_display_get_event_loop(server->wl_display),
+		snapshot_handle_idle, writer);
+	if (!writer->idle) {
+		snapshot_write(writer); // Better now than never
+	}
+}
+
+bool swwm_snapshot_start(struct swwm_server *server, const char *path)
+{
+	if (server->snapshot) {
+		return false;
+	}
+	struct swwm_snapshot_writer *writer = calloc(1, sizeof(*writer));
+	if (!writer) {
+		return false;
+	}
+	writer->server = server;
+
+	int n;
+	if (path) {
+		n = snprintf(writer->path, sizeof(writer->path), "%s", path);
+	} else {
+		const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+		const char *display = getenv("WAYLAND_DISPLAY");
+		if (!runtime_dir) {
+			wlr_log(WLR_ERROR, "snapshot: XDG_RUNTIME_DIR not set");
+			free(writer);
+			return false;
+		}
+		n = snprintf(writer->path, sizeof(writer->path), "%s/swwm-state.%s", runtime_dir, display ? display : "0");
+	}
+	if (n < 0 || (size_t)n >= sizeof(writer->path)) {
+		wlr_log(WLR_ERROR, "snapshot: path too long");
+		free(writer);
+		return false;
+	}
+
+	// A fresh inode, so readers still mapping a previous instance's file
+	// keep seeing its cleared magic instead of our writes
+	unlink(writer->path);
+	int fd = open(writer->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0 || ftruncate(fd, sizeof(struct swwm_snapshot)) < 0) {
+		wlr_log_errno(WLR_ERROR, "snapshot: cannot create %s", writer->path);
+		goto error;
+	}
+	writer->shared = mmap(NULL, sizeof(struct swwm_snapshot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (writer->shared == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "snapshot: cannot map %s", writer->path);
+		goto error;
+	}
+	close(fd); // The mapping keeps the file
+
+	// ftruncate zeroed it: seq is 0, and readers reject it until magic is set
+	writer->shared->version = SWWM_SNAPSHOT_VERSION;
+	writer->shared->size = sizeof(struct swwm_snapshot);
+	snapshot_write(writer);
+	__atomic_store_n(&writer->shared->magic, SWWM_SNAPSHOT_MAGIC, __ATOMIC_RELEASE);
+
+	server->snapshot = writer;
+	setenv("SWWMSTATE", writer->path, true);
+	wlr_log(WLR_INFO, "State snapshot at %s (%zu bytes)", writer->path, sizeof(struct swwm_snapshot));
+	return true;
+
+error:
+	if (fd >= 0) {
+		close(fd);
+		unlink(writer->path);
+	}
+	free(writer);
+	return false;
+}
+
+void swwm_snapshot_stop(struct swwm_server *server)
+{
+	struct swwm_snapshot_writer *writer = server->snapshot;
+	if (!writer) {
+		return;
+	}
+	if (writer->idle) {
+		wl_event_source_remove(writer->idle);
+	}
+	// Tell readers still holding the mapping that it is stale
+	__atomic_store_n(&writer->shared->magic, 0, __ATOMIC_RELEASE);
+	wlr_log(WLR_DEBUG, "State snapshot rewritten %llu times", (unsigned long long)writer->updates);
+	munmap(writer->shared, sizeof(struct swwm_snapshot));
+	unlink(writer->path);
+	free(writer);
+	server->snapshot = NULL;
+	unsetenv("SWWMSTATE");
+}
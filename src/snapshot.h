@@ -0,0 +1,95 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+struct swwm_server;
+
+/*
+ * State snapshot (snapshot.c): a file in $XDG_RUNTIME_DIR, exported as
+ * SWWMSTATE, holding one struct swwm_snapshot. Bars and widgets map it
+ * read-only and sample it whenever they like: no socket, no syscalls after
+ * the mmap, and the compositor is never woken up by a reader.
+ *
+ * The compositor rewrites it at most once per event loop iteration, after
+ * something readers can see changed, under a seqlock: seq is odd while a
+ * write is in progress and advances by two per update, so an unchanged even
+ * seq also tells a reader there is nothing new to render. Use
+ * swwm_snapshot_read for a consistent copy. magic is cleared when the
+ * compositor exits; reopen the file after that.
+ *
+ * Only the header, up to toplevels[ntoplevels], carries data. Strings are
+ * NUL-terminated and truncated to fit; workspaces are numbered from 0.
+ */
+
+#define SWWM_SNAPSHOT_MAGIC 0x7377736eu // "swsn"
+#define SWWM_SNAPSHOT_VERSION 1
+
+#define SWWM_SNAPSHOT_OUTPUTS 8 // MAX_MONITORS
+#define SWWM_SNAPSHOT_WORKSPACES 10 // NUM_WORKSPACES
+#define SWWM_SNAPSHOT_TOPLEVELS 256
+
+struct swwm_snapshot_output {
+	char name[32];
+	int32_t x, y, width, height; // Layout coordinates
+	float scale;
+	int32_t workspace; // Shown on it, -1 for none
+};
+
+struct swwm_snapshot_workspace {
+	int32_t output; // Index into outputs, -1 if not on one
+	uint16_t tiled;
+	uint16_t floating;
+};
+
+struct swwm_snapshot_toplevel {
+	uint32_t id; // Same as the IPC toplevel id
+	int32_t workspace;
+	uint8_t floating, fullscreen, focused, reserved;
+	int32_t x, y, width, height; // Frame, borders included
+	char app_id[64];
+	char title[128];
+};
+
+struct swwm_snapshot {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; // sizeof(struct swwm_snapshot) of the writer
+	uint32_t seq; // Seqlock, see above
+
+	int32_t current_workspace; // On the output with focus
+	uint32_t focused_toplevel; // id, 0 for none
+	uint32_t noutputs;
+	uint32_t ntoplevels; // Entries in toplevels, at most SWWM_SNAPSHOT_TOPLEVELS
+	uint32_t ntoplevels_total; // Including ones that did not fit
+
+	struct swwm_snapshot_output outputs[SWWM_SNAPSHOT_OUTPUTS];
+	struct swwm_snapshot_workspace workspaces[SWWM_SNAPSHOT_WORKSPACES];
+	struct swwm_snapshot_toplevel toplevels[SWWM_SNAPSHOT_TOPLEVELS]; // In workspace order
+};
+
+// Copies a consistent snapshot out of the shared mapping. False if the
+// compositor is gone or kept writing for every attempt.
+static inline bool swwm_snapshot_read(const struct swwm_snapshot *shared, struct swwm_snapshot *copy)
+{
+	for (int attempt = 0; attempt < 64; attempt++) {
+		uint32_t seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			continue; // Mid-update
+		}
+		memcpy(copy, shared, offsetof(struct swwm_snapshot, toplevels));
+		uint32_t n = copy->ntoplevels < SWWM_SNAPSHOT_TOPLEVELS ? copy->ntoplevels : SWWM_SNAPSHOT_TOPLEVELS;
+		memcpy(copy->toplevels, shared->toplevels, n * sizeof(copy->toplevels[0]));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shared->seq, __ATOMIC_RELAXED) == seq) {
+			copy->ntoplevels = n;
+			return copy->magic == SWWM_SNAPSHOT_MAGIC && copy->version == SWWM_SNAPSHOT_VERSION;
+		}
+	}
+	return false;
+}
+
+// Schedules a rewrite for the end of this event loop iteration; cheap
+// enough to call on every change
+void snapshot_mark_dirty(struct swwm_server *server);
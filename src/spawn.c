@@ -0,0 +1,399 @@
+#define _GNU_SOURCE // POSIX_SPAWN_SETSID, environ
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_xdg_activation_v1.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/log.h>
+
+#include "frame_stats.h"
+#include "parser.h"
+#include "spawn.h"
+#include "swwm.h"
+
+// Signals swwm handles or ignores; children get them back at their defaults
+static const int reset_signals[] = { SIGCHLD, SIGUSR1, SIGUSR2, SIGPIPE, SIGINT, SIGTERM, SIGHUP };
+
+// environ with the activation variables replaced; NULL on allocation failure.
+// Entries from *inherited on are ours to free.
+static char **activation_env(const char *token, size_t *inherited)
+{
+	static const char *const vars[] = { "XDG_ACTIVATION_TOKEN", "DESKTOP_STARTUP_ID" };
+	size_t n = 0;
+	while (environ[n]) {
+		n++;
+	}
+	char **env = calloc(n + LENGTH(vars) + 1, sizeof(*env));
+	if (!env) {
+		return NULL;
+	}
+	size_t k = 0;
+	for (size_t i = 0; i < n; i++) {
+		bool replaced = false;
+		for (size_t v = 0; v < LENGTH(vars); v++) {
+			size_t len = strlen(vars[v]);
+			if (!strncmp(environ[i], vars[v], len) && environ[i][len] == '=') {
+				replaced = true;
+			}
+		}
+		if (!replaced) {
+			env[k++] = environ[i];
+		}
+	}
+	*inherited = k;
+	for (size_t v = 0; v < LENGTH(vars); v++) {
+		size_t len = strlen(vars[v]) + strlen(token) + 2;
+		if (!(env[k] = malloc(len))) {
+			break;
+		}
+		snprintf(env[k++], len, "%s=%s", vars[v], token);
+	}
+	return env;
+}
+
+static void activation_env_free(char **env, size_t inherited)
+{
+	for (size_t i = inherited; env[i]; i++) {
+		free(env[i]);
+	}
+	free(env);
+}
+
+pid_t spawn_argv(struct swwm_server *server, char *const argv[], const char *activation_token)
+{
+	uint64_t start = frame_stats_now_ns();
+
+	posix_spawnattr_t attr;
+	if (posix_spawnattr_init(&attr) != 0) {
+		return -1;
+	}
+	sigset_t mask;
+	sigemptyset(&mask);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	sigset_t defaults;
+	sigemptyset(&defaults);
+	for (size_t i = 0; i < LENGTH(reset_signals); i++) {
+		sigaddset(&defaults, reset_signals[i]);
+	}
+	posix_spawnattr_setsigdefault(&attr, &defaults);
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+	flags |= POSIX_SPAWN_SETSID;
+#else
+	flags |= POSIX_SPAWN_SETPGROUP; // Process group 0: a group of its own
+#endif
+	posix_spawnattr_setflags(&attr, flags);
+
+	size_t inherited = 0;
+	char **env = activation_token ? activation_env(activation_token, &inherited) : NULL;
+	pid_t pid;
+	int err = posix_spawnp(&pid, argv[0], NULL, &attr, argv, env ? env : environ);
+	posix_spawnattr_destroy(&attr);
+	if (env) {
+		activation_env_free(env, inherited);
+	}
+	if (err != 0) {
+		wlr_log(WLR_ERROR, "cannot spawn '%s': %s", argv[0], strerror(err));
+		return -1;
+	}
+
+	struct swwm_child *child = calloc(1, sizeof(*child));
+	if (child) {
+		child->pid = pid;
+		child->start_ns = start;
+		snprintf(child->name, sizeof(child->name), "%s", argv[0]);
+		wl_list_insert(&server->children, &child->link);
+	}
+	server->children_spawned++;
+	frame_histogram_add(&server->spawn_time, (frame_stats_now_ns() - start) / 1000);
+	return pid;
+}
+
+// --- Launch tracking ---
+
+static void launch_free(struct swwm_launch *launch)
+{
+	if (launch->token) {
+		launch->token->data = NULL;
+		wl_list_remove(&launch->token_destroy.link);
+	}
+	if (launch->toplevel) {
+		launch->toplevel->launch = NULL;
+	}
+	wl_list_remove(&launch->link);
+	free(launch);
+}
+
+// Unmatched launches are given up once neither the token nor the process
+// can still lead to a window
+static void launch_maybe_expire(struct swwm_launch *launch)
+{
+	if (!launch->toplevel && !launch->token && launch->exited) {
+		wlr_log(WLR_DEBUG, "launch of %s (pid %d) never mapped a window", launch->name, (int)launch->pid);
+		launch_free(launch);
+	}
+}
+
+static void launch_token_destroy(struct wl_listener *listener, void *data)
+{
+	struct swwm_launch *launch = wl_container_of(listener, launch, token_destroy);
+	wl_list_remove(&launch->token_destroy.link);
+	launch->token = NULL;
+	launch_maybe_expire(launch);
+}
+
+struct swwm_launch *launch_start(struct swwm_server *server, char *const argv[])
+{
+	struct swwm_launch *launch = calloc(1, sizeof(*launch));
+	if (!launch) {
+		return NULL;
+	}
+	const char *base = strrchr(argv[0], '/');
+	snprintf(launch->name, sizeof(launch->name), "%s", base ? base + 1 : argv[0]);
+	launch->key_ns = server->key_press_ns;
+	launch->ws_idx = server->current_ws_idx;
+	launch->floating = config_should_float(&server->config, launch->name);
+
+	const char *token_name = NULL;
+	launch->token = server->xdg_activation ? wlr_xdg_activation_token_v1_create(server->xdg_activation) : NULL;
+	if (launch->token) {
+		launch->token->data = launch;
+		launch->token_destroy.notify = launch_token_destroy;
+		wl_signal_add(&launch->token->events.destroy, &launch->token_destroy);
+		token_name = wlr_xdg_activation_token_v1_get_name(launch->token);
+	}
+	wl_list_insert(&server->launches, &launch->link);
+
+	launch->pid = spawn_argv(server, argv, token_name);
+	if (launch->pid < 0) {
+		struct wlr_xdg_activation_token_v1 *token = launch->token;
+		launch_free(launch);
+		if (token) {
+			wlr_xdg_activation_token_v1_destroy(token);
+		}
+		return NULL;
+	}
+	launch->spawn_ns = frame_stats_now_ns();
+	return launch;
+}
+
+static void launch_attach(struct swwm_launch *launch, struct swwm_toplevel *toplevel)
+{
+	launch->toplevel = toplevel;
+	toplevel->launch = launch;
+	if (toplevel->xdg_toplevel->base->surface->mapped) {
+		launch_mapped(launch); // Activated after mapping: timings only, no rules
+	}
+}
+
+struct swwm_launch *launch_match_token(struct swwm_server *server,
+		struct wlr_xdg_activation_token_v1 *token, struct swwm_toplevel *toplevel)
+{
+	struct swwm_launch *launch = token->data;
+	if (!launch || launch->toplevel || toplevel->launch) {
+		return NULL; // Not ours, or already matched (e.g. by pid)
+	}
+	launch_attach(launch, toplevel);
+	return launch;
+}
+
+struct swwm_launch *launch_match_pid(struct swwm_server *server, struct swwm_toplevel *toplevel)
+{
+	if (toplevel->launch) {
+		return toplevel->launch;
+	}
+	pid_t pid;
+	wl_client_get_credentials(wl_resource_get_client(toplevel->xdg_toplevel->resource), &pid, NULL, NULL);
+	struct swwm_launch *launch;
+	wl_list_for_each(launch, &server->launches, link) {
+		if (!launch->toplevel && launch->pid == pid) {
+			launch_attach(launch, toplevel);
+			return launch;
+		}
+	}
+	return NULL;
+}
+
+void launch_mapped(struct swwm_launch *launch)
+{
+	if (!launch->map_ns) {
+		launch->map_ns = frame_stats_now_ns();
+	}
+}
+
+static struct swwm_launch_stats *launch_stats_for(struct swwm_server *server, const char *app_id)
+{
+	for (int i = 0; i < server->launch_statsn; i++) {
+		if (!strcmp(server->launch_stats[i].app_id, app_id)) {
+			return &server->launch_stats[i];
+		}
+	}
+	if (server->launch_statsn == LAUNCH_STATS_MAX) {
+		struct swwm_launch_stats *other = &server->launch_stats_other;
+		snprintf(other->app_id, sizeof(other->app_id), "(other)");
+		return other;
+	}
+	struct swwm_launch_stats *stats = &server->launch_stats[server->launch_statsn++];
+	snprintf(stats->app_id, sizeof(stats->app_id), "%s", app_id);
+	return stats;
+}
+
+// frame_ns is 0 when the window mapped hidden: the timeline ends at the map
+static void launch_finish(struct swwm_launch *launch, uint64_t frame_ns)
+{
+	struct swwm_server *server = launch->toplevel->server;
+	const char *app_id = launch->toplevel->xdg_toplevel->app_id;
+	if (!app_id || !app_id[0]) {
+		app_id = launch->name;
+	}
+	uint64_t start = launch->key_ns ? launch->key_ns : launch->spawn_ns;
+	uint64_t key_to_spawn = launch->key_ns ? (launch->spawn_ns - launch->key_ns) / 1000 : 0;
+	uint64_t spawn_to_map = (launch->map_ns - launch->spawn_ns) / 1000;
+	struct swwm_launch_stats *stats = launch_stats_for(server, app_id);
+	if (launch->key_ns) {
+		frame_histogram_add(&stats->key_to_spawn, key_to_spawn);
+	}
+	frame_histogram_add(&stats->spawn_to_map, spawn_to_map);
+
+	if (!frame_ns) {
+		wlr_log(WLR_INFO, "launch app_id=%s cmd=%s pid=%d key_to_spawn_us=%llu spawn_to_map_us=%llu "
+			"hidden=1", app_id, launch->name, (int)launch->pid,
+			(unsigned long long)key_to_spawn, (unsigned long long)spawn_to_map);
+		launch_free(launch);
+		return;
+	}
+	uint64_t map_to_frame = (frame_ns - launch->map_ns) / 1000;
+	uint64_t total = (frame_ns - start) / 1000;
+
+	// One line per launch, key=value so it can be scraped as is
+	wlr_log(WLR_INFO, "launch app_id=%s cmd=%s pid=%d key_to_spawn_us=%llu spawn_to_map_us=%llu "
+		"map_to_frame_us=%llu total_us=%llu", app_id, launch->name, (int)launch->pid,
+		(unsigned long long)key_to_spawn, (unsigned long long)spawn_to_map,
+		(unsigned long long)map_to_frame, (unsigned long long)total);
+	frame_histogram_add(&stats->map_to_frame, map_to_frame);
+	frame_histogram_add(&stats->total, total);
+	launch_free(launch);
+}
+
+void launch_output_frame(struct swwm_server *server, struct swwm_output *output)
+{
+	uint64_t now = frame_stats_now_ns();
+	struct swwm_launch *launch, *tmp;
+	wl_list_for_each_safe(launch, tmp, &server->launches, link) {
+		struct swwm_toplevel *toplevel = launch->toplevel;
+		if (!toplevel || !launch->map_ns) {
+			continue;
+		}
+		// Mapped on a hidden workspace: no first frame to wait for
+		if (!toplevel->scene_tree->node.enabled) {
+			launch_finish(launch, 0);
+			continue;
+		}
+		// Floating windows may not have an output assigned yet
+		if (toplevel->output && toplevel->output != output) {
+			continue;
+		}
+		launch_finish(launch, now);
+	}
+}
+
+void launch_destroy(struct swwm_launch *launch)
+{
+	launch_free(launch);
+}
+
+static void launch_dump_one(const struct swwm_launch_stats *stats, FILE *f)
+{
+	fprintf(f, "launch %s:\n", stats->app_id);
+	if (stats->key_to_spawn.count) {
+		frame_histogram_dump(&stats->key_to_spawn, "key_to_spawn", f);
+	}
+	frame_histogram_dump(&stats->spawn_to_map, "spawn_to_map", f);
+	frame_histogram_dump(&stats->map_to_frame, "map_to_frame", f);
+	frame_histogram_dump(&stats->total, "total", f);
+}
+
+void launch_dump_stats(struct swwm_server *server, FILE *f)
+{
+	for (int i = 0; i < server->launch_statsn; i++) {
+		launch_dump_one(&server->launch_stats[i], f);
+	}
+	if (server->launch_stats_other.spawn_to_map.count) {
+		launch_dump_one(&server->launch_stats_other, f);
+	}
+}
+
+// --- Children ---
+
+int spawn_handle_sigchld(int signal_number, void *data)
+{
+	struct swwm_server *server = data;
+	int status;
+	pid_t pid;
+	// One signal may stand for several exits
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		struct swwm_launch *launch, *tmp;
+		wl_list_for_each_safe(launch, tmp, &server->launches, link) {
+			if (launch->pid == pid) {
+				launch->exited = true;
+				launch_maybe_expire(launch);
+			}
+		}
+
+		struct swwm_child *child = NULL, *iter;
+		wl_list_for_each(iter, &server->children, link) {
+			if (iter->pid == pid) {
+				child = iter;
+				break;
+			}
+		}
+		if (!child) {
+			continue; // Not ours to report (e.g. started before tracking)
+		}
+
+		double runtime = (frame_stats_now_ns() - child->start_ns) / 1e9;
+		if (WIFEXITED(status)) {
+			int code = WEXITSTATUS(status);
+			wlr_log(code ? WLR_INFO : WLR_DEBUG, "%s (pid %d) exited with status %d after %.3fs",
+				child->name, (int)pid, code, runtime);
+			if (code) {
+				server->children_failed++;
+			}
+		} else if (WIFSIGNALED(status)) {
+			wlr_log(WLR_INFO, "%s (pid %d) killed by signal %d after %.3fs",
+				child->name, (int)pid, WTERMSIG(status), runtime);
+			server->children_failed++;
+		}
+		server->children_exited++;
+		wl_list_remove(&child->link);
+		free(child);
+	}
+	return 0;
+}
+
+void spawn_finish(struct swwm_server *server)
+{
+	struct swwm_child *child, *tmp;
+	wl_list_for_each_safe(child, tmp, &server->children, link) {
+		wl_list_remove(&child->link);
+		free(child);
+	}
+	struct swwm_launch *launch, *ltmp;
+	wl_list_for_each_safe(launch, ltmp, &server->launches, link) {
+		launch_free(launch);
+	}
+}
+
+bool swwm_spawn_command(struct swwm_server *server, const char *command)
+{
+	char *const argv[] = { "/bin/sh", "-c", (char *)command, NULL };
+	return launch_start(server, argv) != NULL;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+
+#include "frame_stats.h"
+
+struct swwm_server;
+struct swwm_output;
+struct swwm_toplevel;
+struct wlr_xdg_activation_token_v1;
+
+// Process launching (spawn.c). Children are started with posix_spawn, which
+// glibc and musl implement with vfork semantics: the cost of a launch does not
+// grow with the compositor's address space, unlike fork(). They get an empty
+// signal mask and default dispositions, since swwm blocks the signals it
+// handles through signalfd. SIGCHLD is handled on the event loop, which reaps
+// children and logs their exit status and runtime.
+
+struct swwm_child {
+	struct wl_list link; // swwm_server::children
+	pid_t pid;
+	uint64_t start_ns;
+	char name[64]; // argv[0], for the exit log
+};
+
+// Launches: every command swwm starts gets an xdg-activation token, passed in
+// XDG_ACTIVATION_TOKEN (and DESKTOP_STARTUP_ID). The toplevel it creates is
+// matched on activation with that token, or by client pid at map. That gives
+// per-launch rules (workspace the launch came from, should_float on the
+// command name) and the keypress -> spawn -> map -> first frame timeline,
+// logged per launch and aggregated per app_id.
+
+struct swwm_launch {
+	struct wl_list link; // swwm_server::launches, until the first frame or given up
+	struct wlr_xdg_activation_token_v1 *token; // NULL once used or expired
+	struct wl_listener token_destroy;
+	struct swwm_toplevel *toplevel; // Set once matched
+	pid_t pid;
+	bool exited; // The spawned process is gone (it may have handed off)
+	char name[64]; // argv[0] basename
+
+	// Rules
+	bool floating;
+	int ws_idx; // Workspace current at spawn; floating launches open on its output
+
+	uint64_t key_ns;   // Keypress of the binding, 0 if not launched by a key
+	uint64_t spawn_ns; // Process started
+	uint64_t map_ns;   // Toplevel mapped, 0 until then
+};
+
+#define LAUNCH_STATS_MAX 32 // app_ids tracked; later ones share an "(other)" bucket
+
+struct swwm_launch_stats {
+	char app_id[64];
+	struct frame_histogram key_to_spawn;
+	struct frame_histogram spawn_to_map;
+	struct frame_histogram map_to_frame;
+	struct frame_histogram total; // Keypress (or spawn) to first frame
+};
+
+// Start argv[0] (looked up in PATH) in a new session. Returns the pid, or -1
+// if it could not be started, exec failures included. activation_token may be
+// NULL.
+pid_t spawn_argv(struct swwm_server *server, char *const argv[], const char *activation_token);
+// spawn_argv with a launch record. Returns NULL if nothing was started.
+struct swwm_launch *launch_start(struct swwm_server *server, char *const argv[]);
+// Match a toplevel to its launch: by token from xdg_activation_v1.activate,
+// or by the client's pid at map. Returns NULL if it is not ours.
+struct swwm_launch *launch_match_token(struct swwm_server *server,
+		struct wlr_xdg_activation_token_v1 *token, struct swwm_toplevel *toplevel);
+struct swwm_launch *launch_match_pid(struct swwm_server *server, struct swwm_toplevel *toplevel);
+// The matched toplevel mapped now
+void launch_mapped(struct swwm_launch *launch);
+// Called after each output commit to catch launched windows' first frames.
+// Windows mapped on a hidden workspace have none; their launch ends there.
+void launch_output_frame(struct swwm_server *server, struct swwm_output *output);
+// The toplevel went away before its first frame
+void launch_destroy(struct swwm_launch *launch);
+void launch_dump_stats(struct swwm_server *server, FILE *f);
+// SIGCHLD handler for wl_event_loop_add_signal
+int spawn_handle_sigchld(int signal_number, void *data);
+// Forget children (and launches) still running when the server goes away
+void spawn_finish(struct swwm_server *server);
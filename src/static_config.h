@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+
+// STATIC_CONFIG=1 builds (see Makefile and config.h): no swwmrc is parsed or
+// watched. Key presses find their binding in config.h's binds[] through a
+// perfect hash over (mods, keysym) that tools/swwm-bindgen.c computes at
+// build time into static_binds.h: one hash, one table load, one compare.
+
+// Shared with swwm-bindgen so both place keys in the same slots
+static inline uint32_t static_binds_hash(uint32_t mods, uint32_t keysym, uint32_t seed)
+{
+	uint32_t h = (keysym ^ seed) * 0x9e3779b1u;
+	h ^= (mods + seed) * 0x85ebca6bu;
+	return h ^ (h >> 16);
+}
@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 200809L // For fork, exec, setenv, SIGCHLD, SIG_IGN
+#define _POSIX_C_SOURCE 200809L // For setenv
 #include <assert.h>
 #include <getopt.h>
 #include <stdbool.h>
@@ -7,24 +7,39 @@
 #include <string.h> // For strcmp, strdup, etc.
 #include <time.h>
 #include <unistd.h>
-#include <sys/wait.h> // For waitpid
-#include <signal.h>   // For SIGCHLD, SIG_IGN
+#include <signal.h>
 #include <wayland-server-core.h>
 #include <wlr/backend.h>
+#include <wlr/backend/headless.h>
 #include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_commit_timing_v1.h>
 #include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_drm.h>
+#include <wlr/types/wlr_ext_foreign_toplevel_list_v1.h>
+#include <wlr/types/wlr_ext_image_capture_source_v1.h>
+#include <wlr/types/wlr_ext_image_copy_capture_v1.h>
+#include <wlr/types/wlr_fifo_v1.h>
+#include <wlr/types/wlr_fractional_scale_v1.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_screencopy_v1.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_subcompositor.h>
+#include <wlr/types/wlr_viewporter.h>
 #include <wlr/types/wlr_xcursor_manager.h>
+#include <wlr/types/wlr_xdg_activation_v1.h>
+#include <wlr/types/wlr_xdg_decoration_v1.h>
+#include <wlr/types/wlr_xdg_output_v1.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/log.h>
 #include <xkbcommon/xkbcommon.h>
@@ -33,126 +48,29 @@
 
 #include "defs.h"   // Our new defs.h
 #include "parser.h" // Our new parser.h
+#include "frame_stats.h"
+#include "swwm.h"
+#include "libswwm.h"
+#include "ipc.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "config.h"
-
-/* For brevity's sake, struct members are annotated where they are used. */
-enum swwm_cursor_mode {
-	SWM_CURSOR_PASSTHROUGH,
-	SWM_CURSOR_MOVE,
-	SWM_CURSOR_RESIZE,
-    SWM_CURSOR_SWAP, // For dragging tiled windows to swap
-};
-
-struct swwm_server {
-	struct wl_display *wl_display;
-	struct wlr_backend *backend;
-	struct wlr_renderer *renderer;
-	struct wlr_allocator *allocator;
-	struct wlr_scene *scene; // Root scene node
-    struct wlr_scene_tree *toplevel_layer; // Scene layer for toplevels
-	struct wlr_scene_output_layout *scene_layout;
-
-	struct wlr_xdg_shell *xdg_shell;
-	struct wl_listener new_xdg_toplevel;
-	struct wl_listener new_xdg_popup;
-	// struct wl_list toplevels; // Replaced by workspaces
-
-	struct wlr_cursor *cursor;
-	struct wlr_xcursor_manager *cursor_mgr;
-	struct wl_listener cursor_motion;
-	struct wl_listener cursor_motion_absolute;
-	struct wl_listener cursor_button;
-	struct wl_listener cursor_axis;
-	struct wl_listener cursor_frame;
-
-	struct wlr_seat *seat;
-	struct wl_listener new_input;
-	struct wl_listener request_cursor;
-	struct wl_listener request_set_selection;
-	struct wl_list keyboards;
-	enum swwm_cursor_mode cursor_mode;
-	struct swwm_toplevel *grabbed_toplevel; // Toplevel being moved/resized
-    struct swwm_toplevel *swap_target_toplevel; // Toplevel to swap with
-	double grab_x, grab_y; // Cursor grab point relative to toplevel corner
-	struct wlr_box grab_geobox; // Toplevel geometry at start of grab
-	uint32_t resize_edges;
-
-	struct wlr_output_layout *output_layout;
-	struct wl_list outputs; // swwm_output
-	struct wl_listener new_output;
-
-    // --- sxwm features ---
-    Config config;
-    struct swwm_workspace workspaces[NUM_WORKSPACES];
-    int current_ws_idx;
-    struct swwm_toplevel *focused_toplevel; // Currently keyboard-focused toplevel
-    bool global_floating; // All new windows float, existing ones toggle
-    bool next_toplevel_should_float; // For spawn commands configured to float
-    long last_motion_time_msec; // For motion throttle
-    // --- end sxwm features ---
-};
-
-struct swwm_output {
-	struct wl_list link;
-	struct swwm_server *server;
-	struct wlr_output *wlr_output;
-    struct wlr_scene_output *scene_output; // For rendering
-	struct wl_listener frame;
-	struct wl_listener request_state;
-	struct wl_listener destroy;
-    int idx; // Index in a potential server->output_array
-    struct wlr_box usable_area; // Geometry excluding panels/docks (future)
-};
-
-struct swwm_toplevel {
-	struct wl_list link; // Overall list in server (not used much now)
-    struct wl_list workspace_link; // For linking within a workspace's list
-	struct swwm_server *server;
-	struct wlr_xdg_toplevel *xdg_toplevel;
-	struct wlr_scene_tree *scene_tree; // Scene node for this toplevel
-	struct wl_listener map;
-	struct wl_listener unmap;
-	struct wl_listener commit; // Important for app_id
-	struct wl_listener destroy;
-	struct wl_listener request_move;
-	struct wl_listener request_resize;
-	struct wl_listener request_maximize;
-	struct wl_listener request_fullscreen;
-    struct wl_listener set_app_id; // To catch app_id changes
-
-    // --- sxwm features integrated ---
-    int ws_idx; // Workspace index it belongs to
-    bool floating;
-    bool fullscreen;
-    // xdg_toplevel->surface->mapped is the equivalent of sxwm client->mapped
-    struct wlr_box geom; // Last configured geometry (layout coords for tiling, absolute for floating)
-    struct wlr_box saved_geom_tile; // Geometry before floating/fullscreen (if it was tiled)
-    struct wlr_box saved_geom_float; // Geometry before fullscreen (if it was floating)
-    // int mon_idx; // Implicit from output_layout and geom
-    // --- end sxwm features ---
-};
-
-struct swwm_popup {
-    // Unchanged from original swwm
-	struct wlr_xdg_popup *xdg_popup;
-    struct wlr_scene_tree *scene_tree; // For rendering popups
-	struct wl_listener commit;
-	struct wl_listener destroy;
-};
-
-struct swwm_keyboard {
-	struct wl_list link;
-	struct swwm_server *server;
-	struct wlr_keyboard *wlr_keyboard;
-
-	struct wl_listener modifiers;
-	struct wl_listener key;
-	struct wl_listener destroy;
-};
+#ifdef SWWM_STATIC_CONFIG
+#include "static_binds.h" // Generated by swwm-bindgen
+#include "static_config.h"
+#endif
 
 // Forward declarations for internal functions
-static void init_default_config(Config *config);
 static void apply_config(struct swwm_server *server);
+static void apply_config_colours(struct swwm_server *server);
+#ifndef SWWM_STATIC_CONFIG
+static void load_builtin_binds(Config *config);
+#endif
+static bool apply_config_scales(struct swwm_server *server);
+static void toplevel_set_floating(struct swwm_toplevel *toplevel, bool floating);
+static void toplevel_eval_rules(struct swwm_toplevel *toplevel);
+static bool toplevel_rules_floating(struct swwm_toplevel *toplevel);
+static bool toplevel_apply_rules(struct swwm_toplevel *toplevel);
 static void arrange_workspace(struct swwm_workspace *ws);
 static void arrange_output(struct swwm_output *output);
 static void arrange_all(struct swwm_server *server);
@@ -160,6 +78,12 @@ static void focus_toplevel(struct swwm_toplevel *toplevel, bool raise);
 static void cycle_focus(struct swwm_server *server, bool forward);
 static struct swwm_toplevel *get_toplevel_at(struct swwm_server *server, double lx, double ly, struct wlr_surface **surface, double *sx, double *sy);
 static void begin_interactive(struct swwm_toplevel *toplevel, enum swwm_cursor_mode mode, uint32_t edges);
+static void toplevel_set_output(struct swwm_toplevel *toplevel, struct swwm_output *output);
+static void toplevel_set_geometry(struct swwm_toplevel *toplevel, struct wlr_box box);
+static void toplevel_set_position(struct swwm_toplevel *toplevel, int x, int y);
+static void toplevel_update_borders(struct swwm_toplevel *toplevel);
+static void toplevel_update_border_colour(struct swwm_toplevel *toplevel);
+static void migrate_workspace(struct swwm_server *server, struct swwm_workspace *ws, struct swwm_output *to);
 
 
 // --- sxwm function ports (prototypes for clarity, definitions below) ---
@@ -186,94 +110,202 @@ void spawn_swwm(struct swwm_server *server, const void *arg_cmd_array) {
     const char **cmd = (const char **)arg_cmd_array;
     if (!cmd || !cmd[0]) return;
 
-    // sxwm's pipe handling logic could be ported here if needed.
-    // For now, simple exec.
-    if (fork() == 0) {
-        // Child process
-        setsid(); // Create new session
-        execvp(cmd[0], (char *const *)cmd);
-        fprintf(stderr, "swwm: execvp '%s' failed: %s\n", cmd[0], strerror(errno));
-        _exit(EXIT_FAILURE);
-    }
-    // Parent continues
-    // Mark that next window might need special handling if configured via should_float
-    // This is tricky as we don't know which window corresponds to this spawn yet.
-    // sxwm sets `next_should_float`. We can do something similar.
-    // Check if this command is in the should_float list (complex matching)
-    // For now, this logic is simplified in `xdg_toplevel_map` using app_id.
+    // posix_spawn, not fork: launch latency stays flat as swwm grows. The
+    // launch carries an activation token so its window can be matched on map
+    // (floating if a rule floats the command's name, launching workspace).
+    launch_start(server, (char *const *)cmd);
 }
 
-void reload_config_swwm(struct swwm_server *server, const void *arg) {
-    wlr_log(WLR_INFO, "Reloading config...");
-    // Free old config resources (like should_float strings, command arrays in binds)
-    for (int i = 0; i < server->config.bindsn; ++i) {
-        if (server->config.binds[i].type == TYPE_CMD && server->config.binds[i].action.cmd) {
-            for (int k = 0; server->config.binds[i].action.cmd[k]; ++k) {
-                free((void*)server->config.binds[i].action.cmd[k]);
+// Re-match mapped windows against new rules; a window only moves between
+// tiled and floating if its rule decision changed, so manual toggles stick
+static void reapply_rules(struct swwm_server *server) {
+    for (int i = 0; i < NUM_WORKSPACES; ++i) {
+        struct swwm_workspace *ws = &server->workspaces[i];
+        bool changed = false;
+        struct wl_list *lists[] = { &ws->toplevels, &ws->floating_toplevels };
+        for (size_t l = 0; l < LENGTH(lists); ++l) {
+            struct swwm_toplevel *toplevel, *tmp;
+            wl_list_for_each_safe(toplevel, tmp, lists[l], workspace_link) {
+                bool was = toplevel_rules_floating(toplevel);
+                toplevel_eval_rules(toplevel);
+                if (toplevel_rules_floating(toplevel) != was) changed |= toplevel_apply_rules(toplevel);
             }
-            free(server->config.binds[i].action.cmd);
         }
+        if (changed) arrange_workspace(ws);
     }
-    for (int i = 0; i < server->config.should_floatn; ++i) {
-        free(server->config.should_float[i]);
-    }
+}
 
-    init_default_config(&server->config); // Re-init with defaults
-    if (parser(server, &server->config) != 0) { // Parse user config file
-        wlr_log(WLR_ERROR, "Failed to parse config file, using defaults for new settings.");
-        // Stick to defaults already loaded by init_default_config
+void reload_config_swwm(struct swwm_server *server, const void *arg) {
+    wlr_log(WLR_INFO, "Reloading config...");
+    // With the watcher running the parse happens on its worker thread
+    if (server->config_watch) {
+        config_watch_request(server);
+    } else {
+        config_reload(server);
     }
-    apply_config(server);
-    arrange_all(server); // Re-tile everything with new settings (gaps, master_width)
-    wlr_log(WLR_INFO, "Config reloaded.");
 }
 
-void change_workspace_action(struct swwm_server *server, const void *arg_ws_idx) {
-    int new_ws_idx = (int)(intptr_t)arg_ws_idx;
-    if (new_ws_idx < 0 || new_ws_idx >= NUM_WORKSPACES || new_ws_idx == server->current_ws_idx) {
+void config_reload(struct swwm_server *server) {
+#ifdef SWWM_STATIC_CONFIG
+    (void)server;
+    wlr_log(WLR_INFO, "Built with a static config, nothing to reload");
+#else
+    Config *next = malloc(sizeof(*next));
+    if (!next) {
+        wlr_log(WLR_ERROR, "Failed to allocate config for reload");
         return;
     }
+    init_default_config(next);
+    if (parser(server, next) != 0) {
+        wlr_log(WLR_ERROR, "Failed to parse config file, keeping the current config.");
+        config_free(next);
+        free(next);
+        ipc_event_config(server, false);
+        return;
+    }
+    config_reload_apply(server, next);
+#endif
+}
 
-    wlr_log(WLR_DEBUG, "Changing to workspace %d", new_ws_idx);
+void config_reload_apply(struct swwm_server *server, Config *next) {
+    // Apply only what differs from the live config, so editing a keybind
+    // doesn't re-tile windows or reset master_width
+    Config *cfg = &server->config;
+    bool relayout = false;
 
-    // Unmap/hide toplevels from old workspace
-    struct swwm_workspace *old_ws = &server->workspaces[server->current_ws_idx];
-    struct swwm_toplevel *toplevel_iter;
-    wl_list_for_each(toplevel_iter, &old_ws->toplevels, workspace_link) {
-        wlr_scene_node_set_enabled(&toplevel_iter->scene_tree->node, false);
+    // gaps and master_width are also adjusted at runtime (inc_gaps, master_*);
+    // only a change in the file overrides the live value
+    if (next->gaps != server->config_gaps) {
+        cfg->gaps = server->config_gaps = next->gaps;
+        relayout = true;
     }
-    wl_list_for_each(toplevel_iter, &old_ws->floating_toplevels, workspace_link) {
-        wlr_scene_node_set_enabled(&toplevel_iter->scene_tree->node, false);
+    for (int i = 0; i < MAX_MONITORS; ++i) {
+        if (next->master_width[i] != server->config_master_width[i]) {
+            cfg->master_width[i] = server->config_master_width[i] = next->master_width[i];
+            relayout = true;
+        }
     }
-
-
-    server->current_ws_idx = new_ws_idx;
-    struct swwm_workspace *new_ws = &server->workspaces[server->current_ws_idx];
-
-    // Map/show toplevels from new workspace
-    wl_list_for_each(toplevel_iter, &new_ws->toplevels, workspace_link) {
-        wlr_scene_node_set_enabled(&toplevel_iter->scene_tree->node, true);
+    if (next->border_width != cfg->border_width) {
+        cfg->border_width = next->border_width;
+        relayout = true;
+    }
+    cfg->modkey = next->modkey;
+    cfg->motion_throttle_hz = next->motion_throttle_hz;
+    cfg->resize_master_amt = next->resize_master_amt;
+    cfg->snap_distance = next->snap_distance;
+
+    if (next->border_foc_col_val != cfg->border_foc_col_val ||
+            next->border_ufoc_col_val != cfg->border_ufoc_col_val ||
+            next->border_swap_col_val != cfg->border_swap_col_val) {
+        cfg->border_foc_col_val = next->border_foc_col_val;
+        cfg->border_ufoc_col_val = next->border_ufoc_col_val;
+        cfg->border_swap_col_val = next->border_swap_col_val;
+        apply_config_colours(server);
+    }
+
+    memcpy(cfg->output_scales, next->output_scales, sizeof(cfg->output_scales));
+    cfg->output_scalesn = next->output_scalesn;
+    relayout |= apply_config_scales(server);
+
+#ifndef SWWM_STATIC_CONFIG
+    // As at startup, a swwmrc without binds must not leave the session
+    // without a way to reload or quit
+    load_builtin_binds(next);
+#endif
+    bool binds_changed = !config_binds_equal(cfg, next);
+    bool rules_changed = !config_rules_equal(cfg, next);
+    // Binds and rules live in the same arena, so they are taken over together
+    if (binds_changed || rules_changed) config_take_data(cfg, next);
+    if (rules_changed) reapply_rules(server);
+
+    if (relayout) arrange_all(server);
+    config_free(next); // Whatever wasn't taken over
+    free(next);
+    wlr_log(WLR_INFO, "Config reloaded (layout %s, binds %s, rules %s).",
+        relayout ? "changed" : "unchanged", binds_changed ? "changed" : "unchanged",
+        rules_changed ? "changed" : "unchanged");
+    ipc_event_config(server, true);
+}
+
+// A workspace is visible when it is the active workspace of its output
+static bool workspace_is_visible(struct swwm_workspace *ws) {
+    return ws->output && ws->output->active_ws == ws->id;
+}
+
+static void workspace_set_enabled(struct swwm_workspace *ws, bool enabled) {
+    struct swwm_toplevel *toplevel_iter;
+    wl_list_for_each(toplevel_iter, &ws->toplevels, workspace_link) {
+        wlr_scene_node_set_enabled(&toplevel_iter->scene_tree->node, enabled);
     }
-     wl_list_for_each(toplevel_iter, &new_ws->floating_toplevels, workspace_link) {
-        wlr_scene_node_set_enabled(&toplevel_iter->scene_tree->node, true);
+    wl_list_for_each(toplevel_iter, &ws->floating_toplevels, workspace_link) {
+        wlr_scene_node_set_enabled(&toplevel_iter->scene_tree->node, enabled);
     }
+}
 
-    arrange_workspace(new_ws); // Arrange the new workspace
-
-    // Focus the first or last focused toplevel on the new workspace
-    struct swwm_toplevel *new_focus = NULL;
-    if (!wl_list_empty(&new_ws->toplevels)) {
-        new_focus = wl_container_of(new_ws->toplevels.next, new_focus, workspace_link);
-    } else if (!wl_list_empty(&new_ws->floating_toplevels)) {
-         new_focus = wl_container_of(new_ws->floating_toplevels.next, new_focus, workspace_link);
+static struct swwm_toplevel *workspace_first_toplevel(struct swwm_workspace *ws) {
+    struct swwm_toplevel *toplevel = NULL;
+    if (!wl_list_empty(&ws->toplevels)) {
+        toplevel = wl_container_of(ws->toplevels.next, toplevel, workspace_link);
+    } else if (!wl_list_empty(&ws->floating_toplevels)) {
+        toplevel = wl_container_of(ws->floating_toplevels.next, toplevel, workspace_link);
     }
+    return toplevel;
+}
+
+// Focus the first toplevel on the workspace, or drop keyboard focus
+static void focus_workspace(struct swwm_server *server, struct swwm_workspace *ws) {
+    server->current_ws_idx = ws->id;
+    struct swwm_toplevel *new_focus = workspace_first_toplevel(ws);
     if (new_focus) {
         focus_toplevel(new_focus, true);
     } else {
-        // No toplevels on new workspace, clear focus
         wlr_seat_keyboard_clear_focus(server->seat);
+        struct swwm_toplevel *prev = server->focused_toplevel;
         server->focused_toplevel = NULL;
+        if (prev) toplevel_update_border_colour(prev);
+        if (prev) ipc_event_focus(server);
+    }
+    snapshot_mark_dirty(server); // The current workspace may have changed
+}
+
+void change_workspace_action(struct swwm_server *server, const void *arg_ws_idx) {
+    TRACE_SCOPE("change_workspace_action");
+    int new_ws_idx = (int)(intptr_t)arg_ws_idx;
+    if (new_ws_idx < 0 || new_ws_idx >= NUM_WORKSPACES) {
+        return;
+    }
+    // Switching is scoped to the output holding the current workspace
+    struct swwm_output *output = server->workspaces[server->current_ws_idx].output;
+    if (!output) output = get_focused_output(server);
+    // active_ws is -1 on an output that has no workspace (yet)
+    if (!output || output->active_ws < 0 || output->active_ws == new_ws_idx) {
+        return;
+    }
+
+    wlr_log(WLR_DEBUG, "Changing to workspace %d on %s", new_ws_idx, output->wlr_output->name);
+
+    struct swwm_workspace *old_ws = &server->workspaces[output->active_ws];
+    struct swwm_workspace *new_ws = &server->workspaces[new_ws_idx];
+
+    if (workspace_is_visible(new_ws)) {
+        // Shown on another output: swap the two, so both outputs keep a workspace
+        struct swwm_output *other = new_ws->output;
+        other->active_ws = old_ws->id;
+        output->active_ws = new_ws->id;
+        migrate_workspace(server, old_ws, other);
+        migrate_workspace(server, new_ws, output);
+        arrange_workspace(old_ws);
+    } else {
+        // Hide toplevels from old workspace, show the new one here
+        workspace_set_enabled(old_ws, false);
+        output->active_ws = new_ws->id;
+        if (new_ws->output != output) migrate_workspace(server, new_ws, output);
+        workspace_set_enabled(new_ws, true);
     }
+
+    arrange_workspace(new_ws); // Arrange the new workspace
+    focus_workspace(server, new_ws);
+    ipc_event_workspace(server);
 }
 
 void move_to_workspace_action(struct swwm_server *server, const void *arg_ws_idx) {
@@ -301,45 +333,35 @@ void move_to_workspace_action(struct swwm_server *server, const void *arg_ws_idx
         wl_list_insert(target_ws->toplevels.prev, &toplevel->workspace_link); // Add to end of tiled list
     }
 
-    // Hide if current workspace is not the target workspace
-    if (toplevel->ws_idx != server->current_ws_idx) {
-        wlr_scene_node_set_enabled(&toplevel->scene_tree->node, false);
-    } else {
-         wlr_scene_node_set_enabled(&toplevel->scene_tree->node, true); // Ensure visible if moved to current
+    // The target may be hidden, or shown on another output
+    bool target_visible = workspace_is_visible(target_ws);
+    wlr_scene_node_set_enabled(&toplevel->scene_tree->node, target_visible);
+    toplevel_set_output(toplevel, target_ws->output);
+    if (toplevel->floating && target_ws->output && target_ws->output != old_ws->output) {
+        // Carry the floating window over to the other output
+        struct wlr_box box;
+        wlr_output_layout_get_box(server->output_layout, target_ws->output->wlr_output, &box);
+        toplevel_set_position(toplevel, box.x + (box.width - toplevel->geom.width) / 2,
+            box.y + (box.height - toplevel->geom.height) / 2);
     }
 
-
     arrange_workspace(old_ws); // Re-arrange old workspace
-    if (target_ws_idx == server->current_ws_idx) {
-        arrange_workspace(target_ws); // Re-arrange new workspace if it's the current one
-    }
-    
-    // Focus next window in old workspace or clear focus if none left
-    struct swwm_toplevel *new_focus_old_ws = NULL;
-    if (!wl_list_empty(&old_ws->toplevels)) {
-        new_focus_old_ws = wl_container_of(old_ws->toplevels.next, new_focus_old_ws, workspace_link);
-    } else if (!wl_list_empty(&old_ws->floating_toplevels)) {
-        new_focus_old_ws = wl_container_of(old_ws->floating_toplevels.next, new_focus_old_ws, workspace_link);
-    }
+    arrange_workspace(target_ws); // No-op unless it is visible somewhere
 
-    if (new_focus_old_ws && old_ws->id == server->current_ws_idx) {
-        focus_toplevel(new_focus_old_ws, true);
-    } else if (old_ws->id == server->current_ws_idx) { // No windows left on current old ws
-        wlr_seat_keyboard_clear_focus(server->seat);
-        server->focused_toplevel = NULL;
-    }
-    // If moved to current ws, the moved window itself should become focused.
-    if (target_ws_idx == server->current_ws_idx) {
-        focus_toplevel(toplevel, true);
-    }
+    ipc_event_window(server, toplevel, "move");
+    // Focus stays on the old workspace's output
+    focus_workspace(server, old_ws);
+    ipc_event_workspace(server);
 }
 
 
-void toggle_floating_swwm(struct swwm_server *server, const void *arg) {
-    struct swwm_toplevel *toplevel = get_focused_toplevel(server);
-    if (!toplevel || toplevel->fullscreen) return;
+// Moves a toplevel between its workspace's tiled and floating lists; the
+// caller re-arranges the workspace
+static void toplevel_set_floating(struct swwm_toplevel *toplevel, bool floating) {
+    struct swwm_server *server = toplevel->server;
+    if (toplevel->floating == floating) return;
 
-    toplevel->floating = !toplevel->floating;
+    toplevel->floating = floating;
 
     wl_list_remove(&toplevel->workspace_link); // Remove from old list (tiled or floating)
     struct swwm_workspace *ws = &server->workspaces[toplevel->ws_idx];
@@ -351,25 +373,70 @@ void toggle_floating_swwm(struct swwm_server *server, const void *arg) {
             toplevel->geom = toplevel->saved_geom_float;
         } else { // Center on output (simplification)
             struct wlr_output *wlr_out = wlr_output_layout_output_at(server->output_layout, server->cursor->x, server->cursor->y);
-            if (!wlr_out) wlr_out = wl_container_of(server->outputs.next, struct swwm_output, link)->wlr_output; // fallback
+            if (!wlr_out && !wl_list_empty(&server->outputs)) { // fallback
+                struct swwm_output *first = wl_container_of(server->outputs.next, first, link);
+                wlr_out = first->wlr_output;
+            }
             if (wlr_out) {
                 struct wlr_box output_box;
                 wlr_output_layout_get_box(server->output_layout, wlr_out, &output_box);
-                toplevel->geom.width = wlr_out->width / 2;
-                toplevel->geom.height = wlr_out->height / 2;
+                toplevel->geom.width = output_box.width / 2; // Logical size, not physical pixels
+                toplevel->geom.height = output_box.height / 2;
                 toplevel->geom.x = output_box.x + (output_box.width - toplevel->geom.width) / 2;
                 toplevel->geom.y = output_box.y + (output_box.height - toplevel->geom.height) / 2;
             }
         }
-        wlr_scene_node_set_position(&toplevel->scene_tree->node, toplevel->geom.x, toplevel->geom.y);
-        wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, toplevel->geom.width, toplevel->geom.height);
+        toplevel_set_geometry(toplevel, toplevel->geom);
         wlr_scene_node_raise_to_top(&toplevel->scene_tree->node); // Floating windows on top
     } else { // Becoming tiled
         wl_list_insert(ws->toplevels.prev, &toplevel->workspace_link); // Add to end of tiled list
         // Geometry will be set by arrange_workspace
         toplevel->saved_geom_float = toplevel->geom; // Save its current floating geometry
     }
-    arrange_workspace(ws);
+    if (toplevel->xdg_toplevel->base->surface->mapped) {
+        ipc_event_window(server, toplevel, "floating");
+    }
+    snapshot_mark_dirty(server);
+}
+
+static const char *toplevel_parent_app_id(struct swwm_toplevel *toplevel) {
+    struct wlr_xdg_toplevel *parent = toplevel->xdg_toplevel->parent;
+    return parent ? parent->app_id : NULL;
+}
+
+static void toplevel_eval_rules(struct swwm_toplevel *toplevel) {
+    struct wlr_xdg_toplevel *xdg_toplevel = toplevel->xdg_toplevel;
+    rules_eval(toplevel->server->config.matcher, &toplevel->rules,
+        xdg_toplevel->app_id, xdg_toplevel->title, toplevel_parent_app_id(toplevel));
+}
+
+// Floating as the rules see it: a float/tile rule decides, otherwise
+// transients (dialogs) float and everything else tiles
+static bool toplevel_rules_floating(struct swwm_toplevel *toplevel) {
+    const struct rule_result *rule = &toplevel->rules.result;
+    if (rule->set & RULE_SET_FLOAT) return rule->floating;
+    return toplevel->xdg_toplevel->parent != NULL;
+}
+
+// Follows a changed rule decision unless something else forces floating;
+// true if the toplevel moved, the caller re-arranges
+static bool toplevel_apply_rules(struct swwm_toplevel *toplevel) {
+    if (toplevel->server->global_floating || toplevel->fullscreen ||
+            (toplevel->launch && toplevel->launch->floating)) {
+        return false;
+    }
+    bool floating = toplevel_rules_floating(toplevel);
+    if (floating == toplevel->floating) return false;
+    toplevel_set_floating(toplevel, floating);
+    return true;
+}
+
+void toggle_floating_swwm(struct swwm_server *server, const void *arg) {
+    struct swwm_toplevel *toplevel = get_focused_toplevel(server);
+    if (!toplevel || toplevel->fullscreen) return;
+
+    toplevel_set_floating(toplevel, !toplevel->floating);
+    arrange_workspace(&server->workspaces[toplevel->ws_idx]);
 }
 
 void toggle_fullscreen_swwm(struct swwm_server *server, const void *arg) {
@@ -398,10 +465,8 @@ void toggle_fullscreen_swwm(struct swwm_server *server, const void *arg) {
         // or directly here. sxwm moves/resizes it directly.
         struct wlr_box output_box;
         wlr_output_layout_get_box(server->output_layout, wlr_out, &output_box);
-        toplevel->geom = output_box; // Fullscreen to the output box
-        wlr_scene_node_set_position(&toplevel->scene_tree->node, output_box.x, output_box.y);
-        // Size is handled by the fullscreen request, but we can configure it too
-        // wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, output_box.width, output_box.height);
+        // Fullscreen to the output box; borders are hidden while fullscreen
+        toplevel_set_geometry(toplevel, output_box);
         wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
     } else {
         wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, false);
@@ -414,11 +479,12 @@ void toggle_fullscreen_swwm(struct swwm_server *server, const void *arg) {
         // If still tiled, arrange_workspace will handle geometry.
         // If floating, apply restored geometry.
         if (toplevel->floating) {
-            wlr_scene_node_set_position(&toplevel->scene_tree->node, toplevel->geom.x, toplevel->geom.y);
-            wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, toplevel->geom.width, toplevel->geom.height);
+            toplevel_set_geometry(toplevel, toplevel->geom);
         }
     }
     arrange_workspace(ws); // Rearrange to account for fullscreen/unfullscreen
+    ipc_event_window(server, toplevel, "fullscreen");
+    snapshot_mark_dirty(server);
 }
 
 
@@ -467,7 +533,7 @@ void resize_master_add_swwm(struct swwm_server *server, const void *arg) {
     float *mw = &server->config.master_width[output->idx];
     *mw += (float)server->config.resize_master_amt / 100.0f;
     if (*mw > MF_MAX) *mw = MF_MAX;
-    arrange_all(server); // Or just current workspace if master_width is per-workspace/output
+    arrange_output(output); // master_width is per output, other monitors are untouched
 }
 
 void resize_master_sub_swwm(struct swwm_server *server, const void *arg) {
@@ -476,7 +542,7 @@ void resize_master_sub_swwm(struct swwm_server *server, const void *arg) {
     float *mw = &server->config.master_width[output->idx];
     *mw -= (float)server->config.resize_master_amt / 100.0f;
     if (*mw < MF_MIN) *mw = MF_MIN;
-    arrange_all(server);
+    arrange_output(output);
 }
 
 void inc_gaps_swwm(struct swwm_server *server, const void *arg) {
@@ -520,8 +586,7 @@ void toggle_floating_global_swwm(struct swwm_server *server, const void *arg) {
             wl_list_insert(&ws->floating_toplevels, &toplevel_iter->workspace_link);
             // Restore/set floating geometry (simplified)
             toplevel_iter->geom = toplevel_iter->saved_geom_float.width > 0 ? toplevel_iter->saved_geom_float : toplevel_iter->geom;
-             wlr_scene_node_set_position(&toplevel_iter->scene_tree->node, toplevel_iter->geom.x, toplevel_iter->geom.y);
-             wlr_xdg_toplevel_set_size(toplevel_iter->xdg_toplevel, toplevel_iter->geom.width, toplevel_iter->geom.height);
+             toplevel_set_geometry(toplevel_iter, toplevel_iter->geom);
 
         } // else: if it was in tiled list, it's already !floating, do nothing to it
     }
@@ -579,6 +644,9 @@ static void focus_toplevel(struct swwm_toplevel *toplevel, bool raise) {
 	}
 
     server->focused_toplevel = toplevel;
+    server->current_ws_idx = toplevel->ws_idx; // Focus decides which output is current
+    if (prev_focused_toplevel) toplevel_update_border_colour(prev_focused_toplevel);
+    toplevel_update_border_colour(toplevel);
 	struct wlr_surface *surface = toplevel->xdg_toplevel->base->surface;
 
 	if (raise) {
@@ -599,7 +667,8 @@ static void focus_toplevel(struct swwm_toplevel *toplevel, bool raise) {
         // If no keyboard, still mark as focused for internal logic
         wlr_seat_keyboard_notify_enter(seat, surface, NULL, 0, NULL);
     }
-    // Update borders or other visual cues if implemented
+    ipc_event_focus(server);
+    snapshot_mark_dirty(server);
 }
 
 static void cycle_focus(struct swwm_server *server, bool forward) {
@@ -679,36 +748,49 @@ static void keyboard_handle_modifiers(
 		&keyboard->wlr_keyboard->modifiers);
 }
 
+static const Binding *find_binding(struct swwm_server *server, xkb_keysym_t sym, uint32_t swm_mods) {
+#ifdef SWWM_STATIC_CONFIG
+    // config.h's binds, indexed by the perfect hash swwm-bindgen built
+    (void)server;
+    uint32_t i = static_binds_hash(swm_mods, sym, STATIC_BINDS_SEED) & (STATIC_BINDS_SLOTS - 1);
+    if (!static_binds_slot[i]) return NULL;
+    const Binding *b = &binds[static_binds_slot[i] - 1];
+    return b->keysym == sym && b->mods == swm_mods ? b : NULL;
+#else
+    for (int i = 0; i < server->config.bindsn; ++i) {
+        const Binding *b = &server->config.binds[i];
+        if (b->keysym == sym && b->mods == swm_mods) return b;
+    }
+    return NULL;
+#endif
+}
+
 static bool handle_compositor_keybinding(struct swwm_server *server, xkb_keysym_t sym, uint32_t wlr_mods) {
-    uint32_t swm_mods = wlr_mods_to_swm_mods(wlr_mods);
+    const Binding *b = find_binding(server, sym, wlr_mods_to_swm_mods(wlr_mods));
+    if (!b) return false; // No binding handled
 
-    for (int i = 0; i < server->config.bindsn; ++i) {
-        Binding *b = &server->config.binds[i];
-        if (b->keysym == sym && b->mods == swm_mods) {
-            switch (b->type) {
-                case TYPE_CMD:
-                    spawn_swwm(server, b->arg);
-                    break;
-                case TYPE_FUNC:
-                    if (b->action.fn) {
-                        b->action.fn(server, b->arg);
-                    }
-                    break;
-                case TYPE_CWKSP:
-                    change_workspace_action(server, b->arg);
-                    break;
-                case TYPE_MWKSP:
-                    move_to_workspace_action(server, b->arg);
-                    break;
+    switch (b->type) {
+        case TYPE_CMD:
+            spawn_swwm(server, b->arg);
+            break;
+        case TYPE_FUNC:
+            if (b->action.fn) {
+                b->action.fn(server, b->arg);
             }
-            return true; // Binding handled
-        }
+            break;
+        case TYPE_CWKSP:
+            change_workspace_action(server, b->arg);
+            break;
+        case TYPE_MWKSP:
+            move_to_workspace_action(server, b->arg);
+            break;
     }
-	return false; // No binding handled
+    return true; // Binding handled
 }
 
 static void keyboard_handle_key(
 		struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("keyboard_handle_key");
 	struct swwm_keyboard *keyboard =
 		wl_container_of(listener, keyboard, key);
 	struct swwm_server *server = keyboard->server;
@@ -720,15 +802,22 @@ static void keyboard_handle_key(
 	int nsyms = xkb_state_key_get_syms(
 			keyboard->wlr_keyboard->xkb_state, keycode, &syms);
 
+    if (server->recorder) {
+        input_recorder_add(server->recorder, INPUT_REC_KEY, event->time_msec, event->keycode,
+            event->state == WL_KEYBOARD_KEY_STATE_PRESSED, 0, 0);
+    }
+
 	bool handled = false;
 	if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
         uint32_t modifiers = wlr_keyboard_get_modifiers(keyboard->wlr_keyboard);
+        server->key_press_ns = frame_stats_now_ns(); // Start of a launch's timeline
 		for (int i = 0; i < nsyms; i++) {
 			if (handle_compositor_keybinding(server, syms[i], modifiers)) {
                 handled = true;
                 break;
             }
 		}
+        server->key_press_ns = 0;
 	}
 
 	if (!handled) {
@@ -841,7 +930,7 @@ static struct swwm_toplevel *get_toplevel_at(
 	struct wlr_scene_node *node = wlr_scene_node_at(
 		&server->toplevel_layer->node, lx, ly, sx, sy);
 	
-    if (node == NULL || node->type == WLR_SCENE_NODE_BUFFER) { // Hit a surface directly
+    if (node == NULL || node->type != WLR_SCENE_NODE_TREE) { // Hit a surface or a border directly
         if (node && node->type == WLR_SCENE_NODE_BUFFER) {
             struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
             struct wlr_scene_surface *scene_surface = wlr_scene_surface_try_from_buffer(scene_buffer);
@@ -878,7 +967,9 @@ static struct swwm_toplevel *get_toplevel_at(
 static void reset_cursor_mode(struct swwm_server *server) {
 	server->cursor_mode = SWM_CURSOR_PASSTHROUGH;
 	server->grabbed_toplevel = NULL;
+    struct swwm_toplevel *swap_target = server->swap_target_toplevel;
     server->swap_target_toplevel = NULL;
+    if (swap_target) toplevel_update_border_colour(swap_target);
     // Reset cursor image
     wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr, "left_ptr");
 }
@@ -886,11 +977,8 @@ static void reset_cursor_mode(struct swwm_server *server) {
 static void process_cursor_move_interactive(struct swwm_server *server) {
 	struct swwm_toplevel *toplevel = server->grabbed_toplevel;
     if (!toplevel) return;
-	wlr_scene_node_set_position(&toplevel->scene_tree->node,
-		server->cursor->x - server->grab_x,
-		server->cursor->y - server->grab_y);
-    toplevel->geom.x = server->cursor->x - server->grab_x;
-    toplevel->geom.y = server->cursor->y - server->grab_y;
+    toplevel_set_position(toplevel, server->cursor->x - server->grab_x,
+        server->cursor->y - server->grab_y);
 }
 
 static void process_cursor_resize_interactive(struct swwm_server *server) {
@@ -935,17 +1023,12 @@ static void process_cursor_resize_interactive(struct swwm_server *server) {
 	// struct wlr_box *current_geo_box = &toplevel->xdg_toplevel->base->geometry; 
     // We operate in layout coordinates for scene_node_set_position
 
-    // New position for the scene node
-	wlr_scene_node_set_position(&toplevel->scene_tree->node, new_left, new_top);
-    toplevel->geom.x = new_left;
-    toplevel->geom.y = new_top;
-
-	int new_width = new_right - new_left;
-	int new_height = new_bottom - new_top;
-    toplevel->geom.width = new_width;
-    toplevel->geom.height = new_height;
-
-	wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, new_width, new_height);
+    toplevel_set_geometry(toplevel, (struct wlr_box){
+        .x = new_left,
+        .y = new_top,
+        .width = new_right - new_left,
+        .height = new_bottom - new_top,
+    });
 }
 
 static void process_cursor_swap_interactive(struct swwm_server *server) {
@@ -959,18 +1042,18 @@ static void process_cursor_swap_interactive(struct swwm_server *server) {
 
     if (target == server->grabbed_toplevel) target = NULL; // Can't swap with itself
 
-    if (server->swap_target_toplevel && server->swap_target_toplevel != target) {
-        // TODO: Reset visual cue for old swap_target_toplevel
-    }
-    server->swap_target_toplevel = NULL;
-    if (target && !target->floating && !target->fullscreen) {
-        server->swap_target_toplevel = target;
-        // TODO: Set visual cue for new swap_target_toplevel (e.g., border color)
-    }
+    if (target && (target->floating || target->fullscreen)) target = NULL;
+
+    struct swwm_toplevel *old_target = server->swap_target_toplevel;
+    if (old_target == target) return;
+    server->swap_target_toplevel = target;
+    if (old_target) toplevel_update_border_colour(old_target);
+    if (target) toplevel_update_border_colour(target);
 }
 
 
 static void process_cursor_motion(struct swwm_server *server, uint32_t time_msec) {
+    TRACE_SCOPE("process_cursor_motion");
     // Throttle motion events if configured
     if (server->config.motion_throttle_hz > 0) {
         long throttle_ms = 1000 / server->config.motion_throttle_hz;
@@ -992,6 +1075,17 @@ static void process_cursor_motion(struct swwm_server *server, uint32_t time_msec
         return;
     }
 
+    // Moving onto another output makes its workspace the current one, so
+    // new windows and workspace switches land where the pointer is
+    struct wlr_output *wlr_out = wlr_output_layout_output_at(server->output_layout,
+        server->cursor->x, server->cursor->y);
+    if (wlr_out && wlr_out->data) {
+        struct swwm_output *output = wlr_out->data;
+        if (output->active_ws >= 0 && server->workspaces[server->current_ws_idx].output != output) {
+            server->current_ws_idx = output->active_ws;
+        }
+    }
+
 	double sx, sy;
 	struct wlr_seat *seat = server->seat;
 	struct wlr_surface *surface = NULL;
@@ -1013,6 +1107,10 @@ static void server_cursor_motion(struct wl_listener *listener, void *data) {
 	struct swwm_server *server =
 		wl_container_of(listener, server, cursor_motion);
 	struct wlr_pointer_motion_event *event = data;
+    if (server->recorder) {
+        input_recorder_add(server->recorder, INPUT_REC_MOTION, event->time_msec, 0, false,
+            event->delta_x, event->delta_y);
+    }
 	wlr_cursor_move(server->cursor, &event->pointer->base,
 			event->delta_x, event->delta_y);
 	process_cursor_motion(server, event->time_msec);
@@ -1023,6 +1121,10 @@ static void server_cursor_motion_absolute(
 	struct swwm_server *server =
 		wl_container_of(listener, server, cursor_motion_absolute);
 	struct wlr_pointer_motion_absolute_event *event = data;
+    if (server->recorder) {
+        input_recorder_add(server->recorder, INPUT_REC_MOTION_ABSOLUTE, event->time_msec, 0, false,
+            event->x, event->y);
+    }
 	wlr_cursor_warp_absolute(server->cursor, &event->pointer->base, event->x,
 		event->y);
 	process_cursor_motion(server, event->time_msec);
@@ -1032,6 +1134,10 @@ static void server_cursor_button(struct wl_listener *listener, void *data) {
 	struct swwm_server *server =
 		wl_container_of(listener, server, cursor_button);
 	struct wlr_pointer_button_event *event = data;
+    if (server->recorder) {
+        input_recorder_add(server->recorder, INPUT_REC_BUTTON, event->time_msec, event->button,
+            event->state == WL_POINTER_BUTTON_STATE_PRESSED, 0, 0);
+    }
 	
     wlr_seat_pointer_notify_button(server->seat,
 			event->time_msec, event->button, event->state);
@@ -1100,6 +1206,11 @@ static void server_cursor_axis(struct wl_listener *listener, void *data) {
 	struct swwm_server *server =
 		wl_container_of(listener, server, cursor_axis);
 	struct wlr_pointer_axis_event *event = data;
+    if (server->recorder) {
+        input_recorder_add(server->recorder, INPUT_REC_AXIS, event->time_msec,
+            (uint32_t)event->delta_discrete,
+            event->orientation == WL_POINTER_AXIS_HORIZONTAL_SCROLL, event->delta, 0);
+    }
 	wlr_seat_pointer_notify_axis(server->seat,
 			event->time_msec, event->orientation, event->delta,
 			event->delta_discrete, event->source, event->relative_direction);
@@ -1108,15 +1219,36 @@ static void server_cursor_axis(struct wl_listener *listener, void *data) {
 static void server_cursor_frame(struct wl_listener *listener, void *data) {
 	struct swwm_server *server =
 		wl_container_of(listener, server, cursor_frame);
+    if (server->recorder) {
+        input_recorder_add(server->recorder, INPUT_REC_FRAME, 0, 0, false, 0, 0);
+    }
 	wlr_seat_pointer_notify_frame(server->seat);
 }
 
 
 static void output_frame(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("output_frame");
 	struct swwm_output *output = wl_container_of(listener, output, frame);
     if (!output->scene_output) return;
 
-	wlr_scene_output_commit(output->scene_output, NULL);
+    struct swwm_server *server = output->server;
+    uint64_t frame_start = frame_stats_now_ns();
+    // wlr_scene_output_commit also returns true when there is nothing to
+    // draw; such idle frames are not commits
+    bool committed = wlr_scene_output_needs_frame(output->scene_output) &&
+        wlr_scene_output_commit(output->scene_output, NULL);
+    uint64_t frame_end = frame_stats_now_ns();
+    frame_stats_record(&output->frame_stats, frame_start,
+        frame_end - frame_start, output->wlr_output->refresh, committed);
+
+    if (committed && !server->first_frame_ns) {
+        server->first_frame_ns = frame_end;
+        wlr_log(WLR_INFO, "startup: first frame on %s %.1f ms after start", output->wlr_output->name,
+            (frame_end - server->startup_ns) / 1e6);
+    }
+    if (committed && !wl_list_empty(&server->launches)) {
+        launch_output_frame(server, output);
+    }
 
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
@@ -1126,27 +1258,251 @@ static void output_frame(struct wl_listener *listener, void *data) {
 static void output_request_state(struct wl_listener *listener, void *data) {
 	struct swwm_output *output = wl_container_of(listener, output, request_state);
 	const struct wlr_output_event_request_state *event = data;
-	wlr_output_commit_state(output->wlr_output, event->state);
+	if (wlr_output_commit_state(output->wlr_output, event->state) &&
+			(event->state->committed & WLR_OUTPUT_STATE_MODE)) {
+		// Missed refreshes were counted against the old refresh rate
+		frame_stats_reset_missed(&output->frame_stats);
+	}
+	snapshot_mark_dirty(output->server); // Mode or scale
+}
+
+// Find the slot remembered for this output name, or hand out a fresh one.
+// Slots of unplugged outputs are only recycled (oldest first) once every
+// slot has been used.
+static int output_slot_acquire(struct swwm_server *server, const char *name) {
+    int free_slot = -1, oldest = -1;
+    for (int i = 0; i < MAX_MONITORS; ++i) {
+        struct swwm_output_slot *slot = &server->output_slots[i];
+        if (slot->connected) continue;
+        if (strcmp(slot->name, name) == 0) {
+            free_slot = i;
+            break;
+        }
+        if (slot->name[0] == '\0') {
+            if (free_slot < 0) free_slot = i;
+        } else if (oldest < 0 || slot->released_seq < server->output_slots[oldest].released_seq) {
+            oldest = i;
+        }
+    }
+    int idx = free_slot >= 0 ? free_slot : oldest;
+    if (idx < 0) {
+        wlr_log(WLR_ERROR, "Exceeded MAX_MONITORS, output %s shares the last slot's config.", name);
+        return MAX_MONITORS - 1; // Clamp to avoid crash, share last config
+    }
+
+    struct swwm_output_slot *slot = &server->output_slots[idx];
+    if (strcmp(slot->name, name) != 0) {
+        // Recycled slot: forget the previous monitor's workspaces, and start
+        // from the first slot's master width rather than the old monitor's
+        snprintf(slot->name, sizeof(slot->name), "%s", name);
+        slot->workspaces = 0;
+        if (idx != 0) server->config.master_width[idx] = server->config.master_width[0];
+    }
+    slot->connected = true;
+    return idx;
+}
+
+// Move a workspace and its windows to `to` (NULL if no output is left).
+// Tiled windows are laid out by the caller's single arrange pass; floating
+// and fullscreen ones are carried over here, since arrange leaves them alone.
+static void migrate_workspace(struct swwm_server *server, struct swwm_workspace *ws, struct swwm_output *to) {
+    struct wlr_box from_box = {0}, to_box = {0};
+    if (ws->output) wlr_output_layout_get_box(server->output_layout, ws->output->wlr_output, &from_box);
+    if (to) wlr_output_layout_get_box(server->output_layout, to->wlr_output, &to_box);
+    ws->output = to;
+
+    struct swwm_toplevel *iter;
+    wl_list_for_each(iter, &ws->toplevels, workspace_link) {
+        toplevel_set_output(iter, to);
+        if (iter->fullscreen && !wlr_box_empty(&to_box)) toplevel_set_geometry(iter, to_box);
+    }
+    wl_list_for_each(iter, &ws->floating_toplevels, workspace_link) {
+        toplevel_set_output(iter, to);
+        if (wlr_box_empty(&to_box)) continue;
+        if (iter->fullscreen) {
+            toplevel_set_geometry(iter, to_box);
+            continue;
+        }
+        if (wlr_box_empty(&from_box)) continue; // Never left this output's coordinates
+        // Keep the offset within the output, clamped so the window stays visible
+        int x = to_box.x + (iter->geom.x - from_box.x);
+        int y = to_box.y + (iter->geom.y - from_box.y);
+        if (x + iter->geom.width > to_box.x + to_box.width) x = to_box.x + to_box.width - iter->geom.width;
+        if (y + iter->geom.height > to_box.y + to_box.height) y = to_box.y + to_box.height - iter->geom.height;
+        if (x < to_box.x) x = to_box.x;
+        if (y < to_box.y) y = to_box.y;
+        toplevel_set_position(iter, x, y);
+    }
+    snapshot_mark_dirty(server);
+}
+
+static float config_output_scale(const Config *config, const char *name) {
+    for (int i = 0; i < config->output_scalesn; ++i) {
+        if (!strcmp(config->output_scales[i].name, name)) return config->output_scales[i].scale;
+    }
+    return 1.0f;
+}
+
+// At fractional scales only some logical sizes map to whole physical pixels.
+// Scales travel as n/120 (wp_fractional_scale_v1), so a logical length is
+// pixel exact when it is a multiple of 120 / gcd(n, 120): 2 at 1.5x, 4 at 1.25x.
+static int output_pixel_step(struct swwm_output *output) {
+    int a = (int)(output->wlr_output->scale * 120.0f + 0.5f), b = 120;
+    if (a <= 0) return 1;
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return 120 / a;
+}
+
+// Snap a box's edges to the output's pixel grid, so it sits on whole physical
+// pixels and the client can render at exactly the physical size without the
+// compositor resampling its buffer. Shared edges snap alike.
+static struct wlr_box snap_box_to_output(const struct wlr_box *output_box, int step, struct wlr_box box) {
+    if (step <= 1) return box;
+    int x0 = output_box->x + (box.x - output_box->x + step / 2) / step * step;
+    int y0 = output_box->y + (box.y - output_box->y + step / 2) / step * step;
+    int x1 = output_box->x + (box.x + box.width - output_box->x + step / 2) / step * step;
+    int y1 = output_box->y + (box.y + box.height - output_box->y + step / 2) / step * step;
+    if (x1 <= x0) x1 = x0 + step;
+    if (y1 <= y0) y1 = y0 + step;
+    return (struct wlr_box){ .x = x0, .y = y0, .width = x1 - x0, .height = y1 - y0 };
 }
 
 static void output_destroy(struct wl_listener *listener, void *data) {
 	struct swwm_output *output = wl_container_of(listener, output, destroy);
-    // TODO: When an output is destroyed, need to move its workspaces/toplevels
-    // to another output. For now, this is simplified.
+    struct swwm_server *server = output->server;
+
+    // Remember which workspaces lived here so they return when it is replugged
+    struct swwm_output_slot *slot = &server->output_slots[output->idx];
+    slot->workspaces = 0;
+    for (int i = 0; i < NUM_WORKSPACES; ++i) {
+        if (server->workspaces[i].output == output) slot->workspaces |= 1u << i;
+    }
+    slot->connected = false;
+    slot->released_seq = ++server->output_slot_seq;
+
 	wl_list_remove(&output->frame.link);
 	wl_list_remove(&output->request_state.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->link);
-    if(output->scene_output) {
-        // wlr_scene_output_destroy(output->scene_output); // This might be handled by scene_layout destroy
+
+    // The workspace it was showing becomes a hidden one on the target
+    struct swwm_workspace *shown = output->active_ws >= 0 ? &server->workspaces[output->active_ws] : NULL;
+    if (shown) workspace_set_enabled(shown, false);
+    output->active_ws = -1;
+
+    // The layout still has the output here (its destroy listener runs after ours)
+    struct swwm_output *target = wl_list_empty(&server->outputs) ? NULL :
+        wl_container_of(server->outputs.next, target, link);
+    for (int i = 0; i < NUM_WORKSPACES; ++i) {
+        if (server->workspaces[i].output == output) {
+            migrate_workspace(server, &server->workspaces[i], target);
+        }
+    }
+    // Any toplevel still pointing here belongs to a workspace assigned elsewhere
+    for (int i = 0; i < NUM_WORKSPACES; ++i) {
+        struct swwm_toplevel *iter;
+        wl_list_for_each(iter, &server->workspaces[i].toplevels, workspace_link) {
+            if (iter->output == output) toplevel_set_output(iter, target);
+        }
+        wl_list_for_each(iter, &server->workspaces[i].floating_toplevels, workspace_link) {
+            if (iter->output == output) toplevel_set_output(iter, target);
+        }
     }
+    // The scene output goes away with the wlr_output
+    output->wlr_output->data = NULL;
 	free(output);
-    // After removing an output, re-evaluate workspace assignments and re-arrange.
-    // struct swwm_server* server = output->server; (need server pointer if output is freestanding)
-    // arrange_all(server);
+
+    // Everything that moved is hidden now, so nothing needs laying out until
+    // it is switched to; just move keyboard focus to what is still on screen
+    if (target && target->active_ws >= 0 && shown && server->current_ws_idx == shown->id) {
+        focus_workspace(server, &server->workspaces[target->active_ws]);
+    }
+    ipc_event_workspace(server);
+    snapshot_mark_dirty(server);
 }
 
-static int output_idx_counter = 0; // Simple way to assign unique idx to outputs
+// End the current startup phase; it ran since the previous call
+static void startup_phase(struct swwm_server *server, const char *name) {
+    uint64_t now = frame_stats_now_ns();
+    if (server->startup_phasesn < STARTUP_PHASES_MAX) {
+        server->startup_phases[server->startup_phasesn++] =
+            (struct swwm_startup_phase){ name, (now - server->startup_mark_ns) / 1000 };
+    }
+    server->startup_mark_ns = now;
+}
+
+static void log_startup(struct swwm_server *server) {
+    char line[512] = "";
+    int len = 0;
+    for (int i = 0; i < server->startup_phasesn && len < (int)sizeof(line); ++i) {
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %.1fms", i ? ", " : "",
+            server->startup_phases[i].name, server->startup_phases[i].us / 1000.0);
+    }
+    wlr_log(WLR_INFO, "startup: %s; total %.1fms", line,
+        (server->startup_mark_ns - server->startup_ns) / 1e6);
+}
+
+static void dump_frame_stats(struct swwm_server *server, FILE *f) {
+    fprintf(f, "startup:");
+    for (int i = 0; i < server->startup_phasesn; ++i) {
+        fprintf(f, " %s=%lluus", server->startup_phases[i].name,
+            (unsigned long long)server->startup_phases[i].us);
+    }
+    if (server->first_frame_ns) {
+        fprintf(f, " first_frame=%lluus", (unsigned long long)((server->first_frame_ns - server->startup_ns) / 1000));
+    }
+    fprintf(f, "\n");
+    fprintf(f, "config: %zu bytes in arena, %zu reserved\n",
+        server->config.arena.used, server->config.arena.reserved);
+    struct swwm_output *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        frame_stats_dump(&output->frame_stats, output->wlr_output->name, f);
+    }
+    if (server->children_spawned) {
+        fprintf(f, "children: spawned %llu, exited %llu, failed %llu\n",
+            (unsigned long long)server->children_spawned,
+            (unsigned long long)server->children_exited,
+            (unsigned long long)server->children_failed);
+        frame_histogram_dump(&server->spawn_time, "spawn", f);
+    }
+    launch_dump_stats(server, f);
+    fflush(f);
+}
+
+static int handle_sigusr1(int signal_number, void *data) {
+    dump_frame_stats(data, stderr);
+    return 0;
+}
+
+static int handle_sigusr2(int signal_number, void *data) {
+    if (trace_enabled) {
+        trace_stop();
+        trace_dump(NULL);
+    } else if (trace_start()) {
+        wlr_log(WLR_INFO, "Tracing handlers, kill -USR2 again to stop and write %s", trace_default_path());
+    }
+    return 0;
+}
+
+// Cursor themes are loaded per scale as outputs appear, rather than at scale
+// 1 during startup whether or not any output uses it
+static void load_cursor_theme(struct swwm_server *server, float scale) {
+    struct wlr_xcursor_manager_theme *theme;
+    wl_list_for_each(theme, &server->cursor_mgr->scaled_themes, link) {
+        if (theme->scale == scale) return;
+    }
+    uint64_t start = frame_stats_now_ns();
+    if (!wlr_xcursor_manager_load(server->cursor_mgr, scale)) {
+        wlr_log(WLR_ERROR, "Failed to load cursor theme at scale %.2f", scale);
+        return;
+    }
+    wlr_log(WLR_DEBUG, "Loaded cursor theme at scale %.2f in %.1f ms", scale,
+        (frame_stats_now_ns() - start) / 1e6);
+}
 
 static void server_new_output(struct wl_listener *listener, void *data) {
 	struct swwm_server *server =
@@ -1162,18 +1518,17 @@ static void server_new_output(struct wl_listener *listener, void *data) {
 	if (mode != NULL) {
 		wlr_output_state_set_mode(&state, mode);
 	}
+	wlr_output_state_set_scale(&state, config_output_scale(&server->config, wlr_output->name));
 	wlr_output_commit_state(wlr_output, &state);
 	wlr_output_state_finish(&state);
+    load_cursor_theme(server, wlr_output->scale);
 
 	struct swwm_output *output = calloc(1, sizeof(*output));
 	output->wlr_output = wlr_output;
 	output->server = server;
-    output->idx = output_idx_counter++;
-    if (output->idx >= MAX_MONITORS) {
-        wlr_log(WLR_ERROR, "Exceeded MAX_MONITORS, output %d may not have specific config.", output->idx);
-        output->idx = MAX_MONITORS -1; // Clamp to avoid crash, share last config
-    }
-    wlr_output_layout_get_box(server->output_layout, wlr_output, &output->usable_area);
+    output->idx = output_slot_acquire(server, wlr_output->name);
+    output->active_ws = -1; // Picked below, once the output is in the layout
+    wlr_output->data = output;
 
 
 	output->frame.notify = output_frame;
@@ -1183,8 +1538,14 @@ static void server_new_output(struct wl_listener *listener, void *data) {
 	output->destroy.notify = output_destroy;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 	wl_list_insert(&server->outputs, &output->link);
+    if (server->recorder) {
+        input_recorder_add(server->recorder, INPUT_REC_OUTPUT, 0,
+            (uint32_t)wlr_output->width << 16 | (uint32_t)(wlr_output->height & 0xffff), false, 0, 0);
+    }
 
 	struct wlr_output_layout_output *l_output = wlr_output_layout_add_auto(server->output_layout, wlr_output);
+    // Not in the layout until now, so no box before this
+    wlr_output_layout_get_box(server->output_layout, wlr_output, &output->usable_area);
 	output->scene_output = wlr_scene_output_create(server->scene, wlr_output);
     // Associate the scene_output with the layout_output for the scene_layout
     if (l_output && output->scene_output) {
@@ -1196,95 +1557,367 @@ static void server_new_output(struct wl_listener *listener, void *data) {
     }
 
 
-    // Assign workspaces to this new output if they don't have one yet
-    // This is a simple distribution, more complex logic might be needed for sxwm feature parity
+    // A monitor we have seen before takes its workspaces back, wherever they
+    // were migrated to while it was gone (unless another output shows them now)
+    uint32_t restore = server->output_slots[output->idx].workspaces;
+    for (int i = 0; i < NUM_WORKSPACES; ++i) {
+        if ((restore & (1u << i)) && !workspace_is_visible(&server->workspaces[i])) {
+            migrate_workspace(server, &server->workspaces[i], output);
+        }
+    }
+    server->output_slots[output->idx].workspaces = 0;
+
+    // Workspaces nobody holds yet belong to the first output that appears
     for (int i = 0; i < NUM_WORKSPACES; ++i) {
         if (server->workspaces[i].output == NULL) {
-             // A simple heuristic: assign first N/M workspaces to first output, etc.
-             // Or assign based on output index.
-            if (i % wl_list_length(&server->outputs) == (wl_list_length(&server->outputs) -1) ) { // Last added output gets some
-                 server->workspaces[i].output = output;
-            }
+            migrate_workspace(server, &server->workspaces[i], output);
+        }
+    }
+
+    // Show one of our own workspaces, else borrow the first hidden one
+    int active = -1;
+    for (int i = 0; i < NUM_WORKSPACES && active < 0; ++i) {
+        if (server->workspaces[i].output == output) active = i;
+    }
+    for (int i = 0; i < NUM_WORKSPACES && active < 0; ++i) {
+        if (!workspace_is_visible(&server->workspaces[i])) active = i;
+    }
+    if (active < 0) {
+        wlr_log(WLR_ERROR, "No hidden workspace left for output %s", wlr_output->name);
+        return;
+    }
+    struct swwm_workspace *ws = &server->workspaces[active];
+    if (ws->output != output) migrate_workspace(server, ws, output);
+    output->active_ws = active;
+    workspace_set_enabled(ws, true);
+    if (!workspace_is_visible(&server->workspaces[server->current_ws_idx])) {
+        server->current_ws_idx = active;
+    }
+
+    arrange_output(output); // Other outputs are unaffected
+    ipc_event_workspace(server);
+    snapshot_mark_dirty(server);
+}
+
+// --- Frame pacing (wp_fifo_v1 / wp_commit_timing_v1) ---
+static void toplevel_set_output(struct swwm_toplevel *toplevel, struct swwm_output *output) {
+    if (toplevel->output == output) return;
+    toplevel->output = output;
+
+    struct swwm_commit_timer *ct;
+    wl_list_for_each(ct, &toplevel->commit_timers, link) {
+        wlr_commit_timer_v1_set_output(ct->timer, output ? output->wlr_output : NULL);
+    }
+}
+
+static int toplevel_border_width(struct swwm_toplevel *toplevel) {
+    return toplevel->fullscreen ? 0 : toplevel->server->config.border_width;
+}
+
+// Fit the border rects to toplevel->geom. Only the layout paths call this;
+// the rects are never recreated.
+static void toplevel_update_borders(struct swwm_toplevel *toplevel) {
+    snapshot_mark_dirty(toplevel->server); // Called on every resize
+    int bw = toplevel_border_width(toplevel);
+    int w = toplevel->geom.width;
+    int h = toplevel->geom.height;
+    bool show = bw > 0 && w > 2 * bw && h > 2 * bw;
+
+    wlr_scene_node_set_position(&toplevel->surface_tree->node, bw, bw);
+    for (int i = 0; i < 4; i++) {
+        wlr_scene_node_set_enabled(&toplevel->border[i]->node, show);
+    }
+    if (!show) return;
+
+    wlr_scene_rect_set_size(toplevel->border[SWWM_BORDER_TOP], w, bw);
+    wlr_scene_node_set_position(&toplevel->border[SWWM_BORDER_TOP]->node, 0, 0);
+    wlr_scene_rect_set_size(toplevel->border[SWWM_BORDER_BOTTOM], w, bw);
+    wlr_scene_node_set_position(&toplevel->border[SWWM_BORDER_BOTTOM]->node, 0, h - bw);
+    wlr_scene_rect_set_size(toplevel->border[SWWM_BORDER_LEFT], bw, h - 2 * bw);
+    wlr_scene_node_set_position(&toplevel->border[SWWM_BORDER_LEFT]->node, 0, bw);
+    wlr_scene_rect_set_size(toplevel->border[SWWM_BORDER_RIGHT], bw, h - 2 * bw);
+    wlr_scene_node_set_position(&toplevel->border[SWWM_BORDER_RIGHT]->node, w - bw, bw);
+}
+
+// Snap the surface inside the borders to the toplevel's output pixel grid:
+// its origin always, its size too unless the client picks it (floating
+// moves). The frame is grown around the result, so the border's own width
+// does not push the surface off the grid (1px at 1.5x would).
+static struct wlr_box toplevel_snap_box(struct swwm_toplevel *toplevel, struct wlr_box box, bool snap_size) {
+    if (!toplevel->output) return box;
+    int step = output_pixel_step(toplevel->output);
+    struct wlr_box output_box;
+    wlr_output_layout_get_box(toplevel->server->output_layout, toplevel->output->wlr_output, &output_box);
+    if (step <= 1 || wlr_box_empty(&output_box)) return box;
+
+    int bw = toplevel_border_width(toplevel);
+    struct wlr_box inner = {
+        .x = box.x + bw,
+        .y = box.y + bw,
+        .width = box.width - 2 * bw,
+        .height = box.height - 2 * bw,
+    };
+    struct wlr_box snapped = snap_box_to_output(&output_box, step, inner);
+    if (!snap_size) {
+        snapped.width = inner.width;
+        snapped.height = inner.height;
+    }
+    return (struct wlr_box){
+        .x = snapped.x - bw,
+        .y = snapped.y - bw,
+        .width = snapped.width + 2 * bw,
+        .height = snapped.height + 2 * bw,
+    };
+}
+
+// Move the frame without resizing it
+static void toplevel_set_position(struct swwm_toplevel *toplevel, int x, int y) {
+    struct wlr_box box = toplevel_snap_box(toplevel, (struct wlr_box){
+        .x = x, .y = y, .width = toplevel->geom.width, .height = toplevel->geom.height,
+    }, false);
+    toplevel->geom.x = box.x;
+    toplevel->geom.y = box.y;
+    wlr_scene_node_set_position(&toplevel->scene_tree->node, box.x, box.y);
+    snapshot_mark_dirty(toplevel->server);
+}
+
+// Place the frame at `box` (layout coords, borders included, snapped to the
+// pixel grid) and configure the client with what is left inside the borders.
+static void toplevel_set_geometry(struct swwm_toplevel *toplevel, struct wlr_box box) {
+    box = toplevel_snap_box(toplevel, box, true);
+    toplevel->geom = box;
+    wlr_scene_node_set_position(&toplevel->scene_tree->node, box.x, box.y);
+    toplevel_update_borders(toplevel);
+
+    int bw = toplevel_border_width(toplevel);
+    int width = box.width - 2 * bw;
+    int height = box.height - 2 * bw;
+    wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, width > 1 ? width : 1, height > 1 ? height : 1);
+}
+
+// Focus and swap-target changes only touch the rect colour, no relayout
+static void toplevel_update_border_colour(struct swwm_toplevel *toplevel) {
+    struct swwm_server *server = toplevel->server;
+    const float *colour = server->border_unfocused;
+    if (toplevel == server->swap_target_toplevel) {
+        colour = server->border_swap;
+    } else if (toplevel == server->focused_toplevel) {
+        colour = server->border_focused;
+    }
+    for (int i = 0; i < 4; i++) {
+        wlr_scene_rect_set_color(toplevel->border[i], colour);
+    }
+}
+
+static void decoration_handle_request_mode(struct wl_listener *listener, void *data) {
+    struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, decoration_request_mode);
+    // Before the initial commit the mode is sent from xdg_toplevel_commit
+    if (toplevel->xdg_toplevel->base->initialized) {
+        wlr_xdg_toplevel_decoration_v1_set_mode(toplevel->decoration,
+            WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE);
+    }
+}
+
+static void decoration_handle_destroy(struct wl_listener *listener, void *data) {
+    struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, decoration_destroy);
+    wl_list_remove(&toplevel->decoration_request_mode.link);
+    wl_list_remove(&toplevel->decoration_destroy.link);
+    toplevel->decoration = NULL;
+}
+
+static void server_new_xdg_decoration(struct wl_listener *listener, void *data) {
+    struct wlr_xdg_toplevel_decoration_v1 *decoration = data;
+    struct swwm_toplevel *toplevel = decoration->toplevel->base->data;
+    if (!toplevel || toplevel->decoration) return;
+
+    toplevel->decoration = decoration;
+    toplevel->decoration_request_mode.notify = decoration_handle_request_mode;
+    wl_signal_add(&decoration->events.request_mode, &toplevel->decoration_request_mode);
+    toplevel->decoration_destroy.notify = decoration_handle_destroy;
+    wl_signal_add(&decoration->events.destroy, &toplevel->decoration_destroy);
+
+    decoration_handle_request_mode(&toplevel->decoration_request_mode, decoration);
+}
+
+static struct swwm_toplevel *toplevel_from_wlr_surface(struct wlr_surface *surface) {
+    // Walk up subsurfaces and popups until we reach the owning xdg_toplevel
+    struct wlr_xdg_surface *xdg_surface = wlr_xdg_surface_try_from_wlr_surface(
+        wlr_surface_get_root_surface(surface));
+    while (xdg_surface && xdg_surface->role == WLR_XDG_SURFACE_ROLE_POPUP) {
+        if (!xdg_surface->popup->parent) return NULL;
+        xdg_surface = wlr_xdg_surface_try_from_wlr_surface(
+            wlr_surface_get_root_surface(xdg_surface->popup->parent));
+    }
+    if (!xdg_surface || xdg_surface->role != WLR_XDG_SURFACE_ROLE_TOPLEVEL) return NULL;
+    return xdg_surface->data;
+}
+
+static void commit_timer_destroy(struct wl_listener *listener, void *data) {
+    struct swwm_commit_timer *ct = wl_container_of(listener, ct, destroy);
+    wl_list_remove(&ct->destroy.link);
+    wl_list_remove(&ct->link);
+    free(ct);
+}
+
+static void server_new_commit_timer(struct wl_listener *listener, void *data) {
+    struct swwm_server *server = wl_container_of(listener, server, new_commit_timer);
+    struct wlr_commit_timing_manager_v1_new_timer_event *event = data;
+    struct wlr_commit_timer_v1 *timer = event->timer;
+
+    struct swwm_toplevel *toplevel = toplevel_from_wlr_surface(timer->surface);
+    if (!toplevel) {
+        // Not one of our windows (yet); pace it against the first output
+        if (!wl_list_empty(&server->outputs)) {
+            struct swwm_output *sout = wl_container_of(server->outputs.next, sout, link);
+            wlr_commit_timer_v1_set_output(timer, sout->wlr_output);
         }
+        return;
     }
-    // If it's the first output, make workspace 0 active on it.
-    if (wl_list_length(&server->outputs) == 1) {
-        server->workspaces[0].output = output;
-        // server->current_ws_idx is already 0 by default.
-        // change_workspace_action(server, (void*) (intptr_t) 0); // to show it
+
+    struct swwm_commit_timer *ct = calloc(1, sizeof(*ct));
+    if (!ct) return;
+    ct->timer = timer;
+    ct->destroy.notify = commit_timer_destroy;
+    wl_signal_add(&timer->events.destroy, &ct->destroy);
+    wl_list_insert(&toplevel->commit_timers, &ct->link);
+
+    if (toplevel->output) {
+        wlr_commit_timer_v1_set_output(timer, toplevel->output->wlr_output);
     }
+}
 
-    arrange_all(server);
+// --- Screen capture: toplevels are published on ext-foreign-toplevel-list
+// while mapped, which is what capture clients name a toplevel source by ---
+static void toplevel_update_foreign_handle(struct swwm_toplevel *toplevel) {
+    if (!toplevel->foreign_handle) return;
+    struct wlr_ext_foreign_toplevel_handle_v1_state state = {
+        .title = toplevel->xdg_toplevel->title,
+        .app_id = toplevel->xdg_toplevel->app_id,
+    };
+    wlr_ext_foreign_toplevel_handle_v1_update_state(toplevel->foreign_handle, &state);
+}
+
+static void server_new_toplevel_capture_request(struct wl_listener *listener, void *data) {
+    struct swwm_server *server = wl_container_of(listener, server, new_toplevel_capture_request);
+    struct wlr_ext_foreign_toplevel_image_capture_source_manager_v1_request *request = data;
+    struct swwm_toplevel *toplevel = request->toplevel_handle->data;
+    if (!toplevel) return;
+
+    // Capture the client surface (and its popups), not our borders. The
+    // scene-node source tracks damage on that subtree only.
+    struct wlr_ext_image_capture_source_v1 *source = wlr_ext_image_capture_source_v1_create_with_scene_node(
+        &toplevel->surface_tree->node, wl_display_get_event_loop(server->wl_display),
+        server->allocator, server->renderer);
+    if (!source) {
+        wlr_log(WLR_ERROR, "failed to create toplevel capture source");
+        return;
+    }
+    wlr_ext_foreign_toplevel_image_capture_source_manager_v1_request_accept(request, source);
+}
+
+// xdg-activation: a client asks to be activated with a token. Tokens we
+// handed to launched commands tie the window to its launch.
+static void server_request_activate(struct wl_listener *listener, void *data) {
+    struct swwm_server *server = wl_container_of(listener, server, request_activate);
+    const struct wlr_xdg_activation_v1_request_activate_event *event = data;
+    struct wlr_xdg_toplevel *xdg_toplevel = wlr_xdg_toplevel_try_from_wlr_surface(event->surface);
+    if (!xdg_toplevel || !xdg_toplevel->base->data) return;
+    struct swwm_toplevel *toplevel = xdg_toplevel->base->data;
+
+    launch_match_token(server, event->token, toplevel);
+    if (!event->token->seat) return; // Tokens without a seat (our own) are for matching only
+    struct swwm_workspace *ws = &server->workspaces[toplevel->ws_idx];
+    if (xdg_toplevel->base->surface->mapped && workspace_is_visible(ws)) {
+        focus_toplevel(toplevel, true);
+    }
+}
+
+static void xdg_toplevel_set_title_notify(struct wl_listener *listener, void *data) {
+    struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, set_title);
+    toplevel_update_foreign_handle(toplevel);
+    if (!toplevel->xdg_toplevel->base->surface->mapped) return;
+    ipc_event_window(toplevel->server, toplevel, "title");
+    snapshot_mark_dirty(toplevel->server);
+    // Terminals retitle on every command: skip matching unless a rule needs it
+    const struct rule_matcher *matcher = toplevel->server->config.matcher;
+    if (!rules_field_used(matcher, RULE_TITLE)) return;
+    if (rules_update(matcher, &toplevel->rules, RULE_TITLE, toplevel->xdg_toplevel->title) &&
+            toplevel_apply_rules(toplevel)) {
+        arrange_workspace(&toplevel->server->workspaces[toplevel->ws_idx]);
+    }
 }
 
 static void xdg_toplevel_set_app_id_notify(struct wl_listener *listener, void *data) {
     struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, set_app_id);
-    // App ID is now set (or updated). Re-check `should_float`.
-    // This is less critical if checked at map time, but good for completeness.
-    const char *app_id = toplevel->xdg_toplevel->app_id;
-    if (!app_id) return;
-
-    bool should_be_floating = false;
-    if (toplevel->server->global_floating || toplevel->server->next_toplevel_should_float) {
-        should_be_floating = true;
-    } else {
-        for (int i = 0; i < toplevel->server->config.should_floatn; ++i) {
-            if (toplevel->server->config.should_float[i] &&
-                strcmp(app_id, toplevel->server->config.should_float[i]) == 0) {
-                should_be_floating = true;
-                break;
-            }
-        }
-    }
-    
-    if (should_be_floating && !toplevel->floating && !toplevel->fullscreen) {
-        toggle_floating_swwm(toplevel->server, NULL); // Pass server, toggle operates on focused
-                                                    // This needs to operate on *this* toplevel.
-                                                    // Simplification: assume it will be focused soon.
-                                                    // Proper way: a toggle_floating_specific(toplevel)
+    toplevel_update_foreign_handle(toplevel);
+    if (!toplevel->xdg_toplevel->base->surface->mapped) return;
+    ipc_event_window(toplevel->server, toplevel, "app_id");
+    snapshot_mark_dirty(toplevel->server);
+    // Before the first map the rules are matched in xdg_toplevel_map
+    const struct rule_matcher *matcher = toplevel->server->config.matcher;
+    if (!rules_field_used(matcher, RULE_APP_ID)) return;
+    if (rules_update(matcher, &toplevel->rules, RULE_APP_ID, toplevel->xdg_toplevel->app_id) &&
+            toplevel_apply_rules(toplevel)) {
+        arrange_workspace(&toplevel->server->workspaces[toplevel->ws_idx]);
     }
-    // Reset for next window
-    if (toplevel->server->next_toplevel_should_float) {
-        toplevel->server->next_toplevel_should_float = false;
+}
+
+// Dialogs can be re-parented after mapping; the default (float transients)
+// depends on the parent as well as any parent= rule
+static void xdg_toplevel_set_parent_notify(struct wl_listener *listener, void *data) {
+    struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, set_parent);
+    if (!toplevel->xdg_toplevel->base->surface->mapped) return;
+    rules_update(toplevel->server->config.matcher, &toplevel->rules, RULE_PARENT,
+        toplevel_parent_app_id(toplevel));
+    if (toplevel_apply_rules(toplevel)) {
+        arrange_workspace(&toplevel->server->workspaces[toplevel->ws_idx]);
     }
 }
 
 
 static void xdg_toplevel_map(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("xdg_toplevel_map");
 	struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, map);
     struct swwm_server *server = toplevel->server;
-
-    toplevel->ws_idx = server->current_ws_idx; // Assign to current workspace
-    struct swwm_workspace *ws = &server->workspaces[toplevel->ws_idx];
-
-    // Determine if it should float
-    bool should_be_floating_initial = false;
-    const char *app_id = toplevel->xdg_toplevel->app_id;
-    if (server->global_floating || server->next_toplevel_should_float) {
-        should_be_floating_initial = true;
-    } else if (app_id) {
-         for (int i = 0; i < server->config.should_floatn; ++i) {
-            if (server->config.should_float[i] &&
-                strcmp(app_id, server->config.should_float[i]) == 0) {
-                should_be_floating_initial = true;
+    server->toplevels_mapped++;
+
+    // Windows we launched open where they were launched from, whatever is
+    // current by now, and follow the launch's rules; a floating launch is
+    // centred on that workspace's output, not the cursor's, below
+    struct swwm_launch *launch = launch_match_pid(server, toplevel);
+    toplevel->ws_idx = launch ? launch->ws_idx : server->current_ws_idx;
+
+    // Window rules pick the workspace (directly, or as whatever the named
+    // output shows) over the launch's
+    toplevel_eval_rules(toplevel);
+    const struct rule_result *rule = &toplevel->rules.result;
+    if (rule->set & RULE_SET_WORKSPACE) {
+        toplevel->ws_idx = rule->workspace;
+    } else if (rule->set & RULE_SET_OUTPUT) {
+        struct swwm_output *output;
+        wl_list_for_each(output, &server->outputs, link) {
+            if (output->active_ws >= 0 && !strcmp(output->wlr_output->name, rule->output)) {
+                toplevel->ws_idx = output->active_ws;
                 break;
             }
         }
     }
-    // Also check for XDG_TOPLEVEL_STATE_TILED / MAXIMIZED if client requests it
-    // and if PMinSize == PMaxSize (fixed size hint from sxwm) -> XDG equivalent?
-    // wlr_xdg_toplevel_requested.maximized or client setting fixed size (less common in Wayland)
-    // For dialogs/transients: toplevel->xdg_toplevel->parent != NULL
-    if (toplevel->xdg_toplevel->parent != NULL) { // Transient window (dialog, etc)
-        should_be_floating_initial = true;
-    }
+    struct swwm_workspace *ws = &server->workspaces[toplevel->ws_idx];
+
+    // Determine if it should float: global floating or a should_float launch,
+    // then the rules, then transients (dialogs) float by default
+    bool should_be_floating_initial = server->global_floating || (launch && launch->floating) ||
+        toplevel_rules_floating(toplevel);
 
 
     if (should_be_floating_initial) {
         toplevel->floating = true;
         wl_list_insert(ws->floating_toplevels.prev, &toplevel->workspace_link);
-        // Set initial floating geometry (e.g., centered)
-        struct wlr_output *wlr_out = wlr_output_layout_output_at(server->output_layout, server->cursor->x, server->cursor->y);
+        // Centre it on the output showing its workspace, which a rule or the
+        // launch may have put on another monitor; the cursor's output only
+        // when the workspace has none yet
+        struct wlr_output *wlr_out = ws->output ? ws->output->wlr_output :
+            wlr_output_layout_output_at(server->output_layout, server->cursor->x, server->cursor->y);
         if (!wlr_out && !wl_list_empty(&server->outputs)) {
             struct swwm_output *sout = wl_container_of(server->outputs.next, sout, link);
             wlr_out = sout->wlr_output;
@@ -1296,24 +1929,45 @@ static void xdg_toplevel_map(struct wl_listener *listener, void *data) {
             struct wlr_box req_geom;
             wlr_xdg_surface_get_geometry(toplevel->xdg_toplevel->base, &req_geom);
 
-            toplevel->geom.width = req_geom.width > 0 ? req_geom.width : wlr_out->width / 2;
-            toplevel->geom.height = req_geom.height > 0 ? req_geom.height : wlr_out->height / 2;
-            toplevel->geom.x = output_box.x + (output_box.width - toplevel->geom.width) / 2;
-            toplevel->geom.y = output_box.y + (output_box.height - toplevel->geom.height) / 2;
-            
-            wlr_scene_node_set_position(&toplevel->scene_tree->node, toplevel->geom.x, toplevel->geom.y);
-            // Client might resize itself after this configure.
-            // wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, toplevel->geom.width, toplevel->geom.height);
+            int bw = server->config.border_width;
+            if (rule->set & RULE_SET_SIZE) {
+                req_geom.width = rule->width;
+                req_geom.height = rule->height;
+            }
+            int width = (req_geom.width > 0 ? req_geom.width : output_box.width / 2) + 2 * bw;
+            int height = (req_geom.height > 0 ? req_geom.height : output_box.height / 2) + 2 * bw;
+            int x = output_box.x + (output_box.width - width) / 2;
+            int y = output_box.y + (output_box.height - height) / 2;
+            toplevel_set_output(toplevel, wlr_out->data);
+            if (rule->set & RULE_SET_SIZE) {
+                // The client only learns the rule's size from a configure
+                toplevel_set_geometry(toplevel, (struct wlr_box){ .x = x, .y = y, .width = width, .height = height });
+            } else {
+                // Keep whatever size the client picked, just centre it
+                toplevel->geom.width = width;
+                toplevel->geom.height = height;
+                toplevel_set_position(toplevel, x, y);
+                toplevel_update_borders(toplevel);
+            }
         }
     } else {
         toplevel->floating = false;
         wl_list_insert(ws->toplevels.prev, &toplevel->workspace_link); // Add to end of tiled list
     }
     
-    if (server->next_toplevel_should_float) server->next_toplevel_should_float = false;
+    if (launch) launch_mapped(launch);
 
-    wlr_scene_node_set_enabled(&toplevel->scene_tree->node, true); // Ensure visible
-	focus_toplevel(toplevel, true);
+    wlr_scene_node_set_enabled(&toplevel->scene_tree->node, workspace_is_visible(ws));
+    struct wlr_ext_foreign_toplevel_handle_v1_state handle_state = {
+        .title = toplevel->xdg_toplevel->title,
+        .app_id = toplevel->xdg_toplevel->app_id,
+    };
+    toplevel->foreign_handle = wlr_ext_foreign_toplevel_handle_v1_create(server->foreign_toplevel_list, &handle_state);
+    if (toplevel->foreign_handle) toplevel->foreign_handle->data = toplevel;
+    // A launch landing on a hidden workspace waits there instead of pulling focus
+    ipc_event_window(server, toplevel, "new");
+    snapshot_mark_dirty(server);
+	if (workspace_is_visible(ws)) focus_toplevel(toplevel, true);
     arrange_workspace(ws);
 }
 
@@ -1324,11 +1978,19 @@ static void xdg_toplevel_unmap(struct wl_listener *listener, void *data) {
 	if (toplevel == server->grabbed_toplevel) {
 		reset_cursor_mode(server);
 	}
-    if (toplevel == server->focused_toplevel) {
+    bool was_focused = toplevel == server->focused_toplevel;
+    if (was_focused) {
         server->focused_toplevel = NULL; // Clear focused if it's unmapping
     }
+    ipc_event_window(server, toplevel, "close");
+    snapshot_mark_dirty(server);
 
 	wl_list_remove(&toplevel->workspace_link); // Remove from its workspace list
+    if (toplevel->launch) launch_destroy(toplevel->launch); // Gone before its first frame
+    if (toplevel->foreign_handle) {
+        wlr_ext_foreign_toplevel_handle_v1_destroy(toplevel->foreign_handle);
+        toplevel->foreign_handle = NULL;
+    }
     
     struct swwm_workspace *ws = &server->workspaces[toplevel->ws_idx];
     arrange_workspace(ws); // Re-tile the workspace
@@ -1337,9 +1999,11 @@ static void xdg_toplevel_unmap(struct wl_listener *listener, void *data) {
     if (server->focused_toplevel == NULL && server->current_ws_idx == toplevel->ws_idx) {
         cycle_focus(server, true); // Try to focus something else
     }
+    if (was_focused && !server->focused_toplevel) ipc_event_focus(server);
 }
 
 static void xdg_toplevel_commit(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("xdg_toplevel_commit");
 	struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, commit);
     // struct wlr_surface *surface = data; // This is incorrect, data is NULL for surface commit.
                                         // data is specific to the event. For surface.commit, it's NULL.
@@ -1349,12 +2013,36 @@ static void xdg_toplevel_commit(struct wl_listener *listener, void *data) {
 		wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, 0, 0); // Let client pick initial size
         // App ID might be available now or after a few commits.
         // Listener for set_app_id is better.
+        if (toplevel->decoration) {
+            wlr_xdg_toplevel_decoration_v1_set_mode(toplevel->decoration,
+                WLR_XDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE);
+        }
+        return;
 	}
     // If geometry changed by client, and it's tiled, we might need to re-evaluate or force our size.
     // For now, assume compositor dictates size for tiled windows primarily via arrange_workspace.
+
+    // Floating windows may pick their own size; keep the frame wrapped around it
+    if (toplevel->floating && !toplevel->fullscreen && toplevel->xdg_toplevel->base->surface->mapped) {
+        struct wlr_box surface_geom;
+        wlr_xdg_surface_get_geometry(toplevel->xdg_toplevel->base, &surface_geom);
+        int bw = toplevel->server->config.border_width;
+        if (surface_geom.width + 2 * bw != toplevel->geom.width ||
+                surface_geom.height + 2 * bw != toplevel->geom.height) {
+            toplevel->geom.width = surface_geom.width + 2 * bw;
+            toplevel->geom.height = surface_geom.height + 2 * bw;
+            toplevel_update_borders(toplevel);
+        }
+    }
+}
+
+static void xdg_toplevel_configure(struct wl_listener *listener, void *data) {
+	struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, configure);
+    toplevel->server->configures_sent++;
 }
 
 static void xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("xdg_toplevel_destroy");
 	struct swwm_toplevel *toplevel = wl_container_of(listener, toplevel, destroy);
     struct swwm_server *server = toplevel->server;
 
@@ -1378,6 +2066,20 @@ static void xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&toplevel->request_maximize.link);
 	wl_list_remove(&toplevel->request_fullscreen.link);
     wl_list_remove(&toplevel->set_app_id.link);
+    wl_list_remove(&toplevel->set_title.link);
+    wl_list_remove(&toplevel->set_parent.link);
+    if (toplevel->launch) launch_destroy(toplevel->launch); // Matched by token, never mapped
+    wl_list_remove(&toplevel->configure.link);
+    if (toplevel->decoration) {
+        wl_list_remove(&toplevel->decoration_request_mode.link);
+        wl_list_remove(&toplevel->decoration_destroy.link);
+    }
+
+    // Timers outlive the toplevel only until the client destroys them
+    struct swwm_commit_timer *ct, *ct_tmp;
+    wl_list_for_each_safe(ct, ct_tmp, &toplevel->commit_timers, link) {
+        commit_timer_destroy(&ct->destroy, NULL);
+    }
 
     wlr_scene_node_destroy(&toplevel->scene_tree->node); // Destroy scene representation
 
@@ -1479,10 +2181,17 @@ static void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
 
 	struct swwm_toplevel *toplevel = calloc(1, sizeof(*toplevel));
 	toplevel->server = server;
+    toplevel->id = ++server->next_toplevel_id;
 	toplevel->xdg_toplevel = xdg_toplevel;
-    // Create scene node in the toplevel_layer
-	toplevel->scene_tree = wlr_scene_xdg_surface_create(server->toplevel_layer, xdg_toplevel->base);
+    // Create the frame in the toplevel_layer: four border rects and the client
+    // surface. The rects are created once; layout only resizes them and focus
+    // changes only recolour them.
+	toplevel->scene_tree = wlr_scene_tree_create(server->toplevel_layer);
 	toplevel->scene_tree->node.data = toplevel; // Link back from scene node to swwm_toplevel
+    for (int i = 0; i < 4; i++) {
+        toplevel->border[i] = wlr_scene_rect_create(toplevel->scene_tree, 0, 0, server->border_unfocused);
+    }
+	toplevel->surface_tree = wlr_scene_xdg_surface_create(toplevel->scene_tree, xdg_toplevel->base);
 	xdg_toplevel->base->data = toplevel; // User data for the xdg_surface can be swwm_toplevel
 
     // Initialize sxwm properties
@@ -1490,6 +2199,7 @@ static void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
     toplevel->fullscreen = false;
     toplevel->ws_idx = server->current_ws_idx; // Default to current, refined on map
     // geom and saved_geoms are zeroed by calloc
+    wl_list_init(&toplevel->commit_timers);
 
 	toplevel->map.notify = xdg_toplevel_map;
 	wl_signal_add(&xdg_toplevel->base->surface->events.map, &toplevel->map);
@@ -1511,6 +2221,12 @@ static void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
 
     toplevel->set_app_id.notify = xdg_toplevel_set_app_id_notify;
     wl_signal_add(&xdg_toplevel->events.set_app_id, &toplevel->set_app_id);
+    toplevel->set_title.notify = xdg_toplevel_set_title_notify;
+    wl_signal_add(&xdg_toplevel->events.set_title, &toplevel->set_title);
+    toplevel->set_parent.notify = xdg_toplevel_set_parent_notify;
+    wl_signal_add(&xdg_toplevel->events.set_parent, &toplevel->set_parent);
+    toplevel->configure.notify = xdg_toplevel_configure;
+    wl_signal_add(&xdg_toplevel->base->events.configure, &toplevel->configure);
     
     // Initially disable scene node, will be enabled on map and workspace change
     wlr_scene_node_set_enabled(&toplevel->scene_tree->node, false);
@@ -1540,13 +2256,17 @@ static void server_new_xdg_popup(struct wl_listener *listener, void *data) {
 
 	struct wlr_xdg_surface *parent_xdg_surface = wlr_xdg_surface_try_from_wlr_surface(xdg_popup->parent);
 	assert(parent_xdg_surface != NULL);
-    // struct swwm_toplevel *parent_toplevel = parent_xdg_surface->data; // if xdg_surface->data is swwm_toplevel
-    // If xdg_surface->data points to scene_tree as in original swwm:
-    struct wlr_scene_tree *parent_scene_tree = parent_xdg_surface->data;
+    // Toplevels keep their swwm_toplevel in xdg_surface->data, popups their scene tree
+    struct wlr_scene_tree *parent_scene_tree;
+    if (parent_xdg_surface->role == WLR_XDG_SURFACE_ROLE_TOPLEVEL) {
+        struct swwm_toplevel *parent_toplevel = parent_xdg_surface->data;
+        parent_scene_tree = parent_toplevel->surface_tree;
+    } else {
+        parent_scene_tree = parent_xdg_surface->data;
+    }
     assert(parent_scene_tree != NULL);
 
 	popup->scene_tree = wlr_scene_xdg_surface_create(parent_scene_tree, xdg_popup->base);
-    popup->scene_tree->node.data = popup; // Link back if needed
     xdg_popup->base->data = popup->scene_tree; // Original swwm way
 
 	popup->commit.notify = xdg_popup_commit;
@@ -1558,19 +2278,18 @@ static void server_new_xdg_popup(struct wl_listener *listener, void *data) {
 
 // --- Tiling logic (Master-Stack) ---
 static void arrange_workspace(struct swwm_workspace *ws) {
+    TRACE_SCOPE("arrange_workspace");
     if (!ws) return;
-    struct swwm_server *server = wl_container_of(ws, struct swwm_server, workspaces[ws->id]); // Get server ptr
+    struct swwm_server *server = wl_container_of(ws - ws->id, server, workspaces); // ws is server->workspaces[ws->id]
     
-    // Determine output for this workspace. sxwm tiles per monitor.
-    // In Wayland, a workspace isn't strictly tied to one output, but for tiling it's simpler.
-    struct swwm_output *output = ws->output; // Use the assigned output
-    if (!output) { // If no specific output, try to find one (e.g., the first one)
-        if (!wl_list_empty(&server->outputs)) {
-            output = wl_container_of(server->outputs.next, output, link);
-        } else {
-            return; // No outputs to arrange on
-        }
+    // sxwm tiles per monitor: a workspace is laid out on the output showing
+    // it. Hidden workspaces are laid out when they are switched to.
+    if (!workspace_is_visible(ws)) return;
+    if (server->arrange_batch) {
+        server->arrange_pending |= 1u << ws->id; // Laid out by swwm_arrange_end
+        return;
     }
+    struct swwm_output *output = ws->output;
     
     struct wlr_box output_geom;
     wlr_output_layout_get_box(server->output_layout, output->wlr_output, &output_geom);
@@ -1590,11 +2309,16 @@ static void arrange_workspace(struct swwm_workspace *ws) {
     int tiled_count = 0;
     struct swwm_toplevel *iter;
     wl_list_for_each(iter, &ws->toplevels, workspace_link) {
+        toplevel_set_output(iter, output);
         if (!iter->floating && !iter->fullscreen && iter->xdg_toplevel->base->surface->mapped) {
             tiled_count++;
         }
     }
 
+    wl_list_for_each(iter, &ws->floating_toplevels, workspace_link) {
+        toplevel_set_output(iter, output);
+    }
+
     if (tiled_count == 0) return;
 
     // Master-stack layout
@@ -1618,12 +2342,12 @@ static void arrange_workspace(struct swwm_workspace *ws) {
     }
     
     // Configure master
-    master->geom.x = tile_area.x;
-    master->geom.y = tile_area.y;
-    master->geom.width = master_width - (tiled_count > 1 ? gaps / 2 : 0);
-    master->geom.height = tile_area.height;
-    wlr_scene_node_set_position(&master->scene_tree->node, master->geom.x, master->geom.y);
-    wlr_xdg_toplevel_set_size(master->xdg_toplevel, master->geom.width, master->geom.height);
+    toplevel_set_geometry(master, (struct wlr_box){
+        .x = tile_area.x,
+        .y = tile_area.y,
+        .width = master_width - (tiled_count > 1 ? gaps / 2 : 0),
+        .height = tile_area.height,
+    });
     wlr_xdg_toplevel_set_tiled(master->xdg_toplevel, WLR_EDGE_LEFT | WLR_EDGE_RIGHT | WLR_EDGE_TOP | WLR_EDGE_BOTTOM);
 
 
@@ -1646,18 +2370,19 @@ static void arrange_workspace(struct swwm_workspace *ws) {
             if (stack_iter->floating || stack_iter->fullscreen || !stack_iter->xdg_toplevel->base->surface->mapped) continue;
 
 
-            stack_iter->geom.x = stack_x;
-            stack_iter->geom.y = stack_y + current_stack_idx * (stack_win_height + gaps);
-            stack_iter->geom.width = stack_width;
-            stack_iter->geom.height = stack_win_height;
+            struct wlr_box box = {
+                .x = stack_x,
+                .y = stack_y + current_stack_idx * (stack_win_height + gaps),
+                .width = stack_width,
+                .height = stack_win_height,
+            };
             if (current_stack_idx == stack_count - 1) { // Last stack window takes remaining height
-                stack_iter->geom.height = tile_area.y + tile_area.height - stack_iter->geom.y;
+                box.height = tile_area.y + tile_area.height - box.y;
             }
-             if (stack_iter->geom.height < 1) stack_iter->geom.height = 1;
+             if (box.height < 1) box.height = 1;
 
 
-            wlr_scene_node_set_position(&stack_iter->scene_tree->node, stack_iter->geom.x, stack_iter->geom.y);
-            wlr_xdg_toplevel_set_size(stack_iter->xdg_toplevel, stack_iter->geom.width, stack_iter->geom.height);
+            toplevel_set_geometry(stack_iter, box);
             wlr_xdg_toplevel_set_tiled(stack_iter->xdg_toplevel, WLR_EDGE_LEFT | WLR_EDGE_RIGHT | WLR_EDGE_TOP | WLR_EDGE_BOTTOM);
             current_stack_idx++;
             if (current_stack_idx >= stack_count) break;
@@ -1679,12 +2404,17 @@ static void arrange_workspace(struct swwm_workspace *ws) {
 
 }
 
+static void arrange_output(struct swwm_output *output) {
+    if (output->active_ws < 0) return;
+    arrange_workspace(&output->server->workspaces[output->active_ws]);
+}
+
 static void arrange_all(struct swwm_server *server) {
-    // Arrange toplevels on the current workspace
-    arrange_workspace(&server->workspaces[server->current_ws_idx]);
-    // In a multi-output setup where workspaces can span outputs or are per-output,
-    // this would iterate all relevant workspaces/outputs.
-    // For now, current workspace implies current output context.
+    // Each output shows exactly one workspace; hidden ones are arranged when shown
+    struct swwm_output *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        arrange_output(output);
+    }
 }
 
 // --- Helper function implementations ---
@@ -1698,7 +2428,8 @@ struct swwm_output *get_focused_output(struct swwm_server *server) {
     if (!wlr_out) {
         if (wl_list_empty(&server->outputs)) return NULL;
         // Fallback to first output
-        return wl_container_of(server->outputs.next, struct swwm_output, link);
+        struct swwm_output *first = wl_container_of(server->outputs.next, first, link);
+        return first;
     }
     struct swwm_output *out_iter;
     wl_list_for_each(out_iter, &server->outputs, link) {
@@ -1709,210 +2440,537 @@ struct swwm_output *get_focused_output(struct swwm_server *server) {
     return NULL; // Should not happen if wlr_out was found
 }
 
-static void init_default_config(Config *config) {
+void init_default_config(Config *config) {
     memset(config, 0, sizeof(Config)); // Zero out the config struct first
 
-    config->modkey = SWM_MOD_LOGO; // Super/Win key
-    config->gaps = 10;
-    config->border_width = 1; // Visuals not implemented
-    config->border_foc_col_val = 0xFFFF0000; // Red (example, not used)
-    config->border_ufoc_col_val = 0xFF888888; // Gray (example, not used)
-    config->border_swap_col_val = 0xFFFFFF00; // Yellow (example, not used)
+    // Option defaults live in config.h
+    config->modkey = CONFIG_MODKEY;
+    config->gaps = CONFIG_GAPS;
+    config->border_width = CONFIG_BORDER_WIDTH;
+    config->border_foc_col_val = CONFIG_FOCUSED_COLOUR;
+    config->border_ufoc_col_val = CONFIG_UNFOCUSED_COLOUR;
+    config->border_swap_col_val = CONFIG_SWAP_COLOUR;
 
     for (int i = 0; i < MAX_MONITORS; i++) {
-        config->master_width[i] = 0.5f; // 50%
-    }
-    config->motion_throttle_hz = 60;
-    config->resize_master_amt = 5; // 5%
-    config->snap_distance = 10;    // Pixels (visuals not implemented)
-
-    config->bindsn = 0; // Will be populated by parser or default binds array
-    // Copy default binds from config.txt's `binds` array
-    // This is a bit meta; the parser usually does this.
-    // If parser fails, these defaults can be used.
-    // For now, parser is expected to load them.
-    //memcpy(config->binds, binds_default_array, sizeof(binds_default_array));
-    //config->bindsn = LENGTH(binds_default_array);
-
-    config->should_floatn = 0;
-    for (int j = 0; j < 256; j++) {
-		config->should_float[j] = NULL;
-	}
+        config->master_width[i] = CONFIG_MASTER_WIDTH;
+    }
+    config->motion_throttle_hz = CONFIG_MOTION_THROTTLE_HZ;
+    config->resize_master_amt = CONFIG_RESIZE_MASTER_AMOUNT;
+    config->snap_distance = CONFIG_SNAP_DISTANCE; // Pixels (visuals not implemented)
+
+    config->bindsn = 0; // Populated by the parser, or from config.h's binds, see load_builtin_binds
+    config->rules = config->rules_last = NULL;
+    config->rulesn = 0;
+    config->matcher = NULL;
+}
+
+#ifdef SWWM_STATIC_CONFIG
+// config.h is the whole config. Its window rules are linked into the arena
+// like parsed ones; binds stay in the read-only table, see find_binding
+static void load_static_config(Config *config) {
+    struct rule **link = &config->rules;
+    for (size_t i = 0; i < LENGTH(window_rules) && i < RULES_MAX; ++i) {
+        struct rule *rule = config_arena_alloc(&config->arena, sizeof(*rule), sizeof(void *));
+        if (!rule) break;
+        *rule = window_rules[i];
+        rule->next = NULL;
+        *link = config->rules_last = rule;
+        link = &rule->next;
+        config->rulesn++;
+    }
+    config->matcher = rules_compile(&config->arena, config->rules);
+}
+#else
+// Without a usable swwmrc, config.h's binds keep the session controllable
+static void load_builtin_binds(Config *config) {
+    if (config->bindsn > 0) return;
+    memcpy(config->binds, binds, sizeof(binds));
+    config->bindsn = LENGTH(binds);
+}
+#endif
+
+// Config colours are AARRGGBB (see parse_col_str); the scene wants premultiplied RGBA
+static void colour_to_rgba(unsigned long argb, float rgba[4]) {
+    float a = ((argb >> 24) & 0xff) / 255.0f;
+    rgba[0] = ((argb >> 16) & 0xff) / 255.0f * a;
+    rgba[1] = ((argb >> 8) & 0xff) / 255.0f * a;
+    rgba[2] = (argb & 0xff) / 255.0f * a;
+    rgba[3] = a;
+}
+
+static void apply_config_colours(struct swwm_server *server) {
+    colour_to_rgba(server->config.border_foc_col_val, server->border_focused);
+    colour_to_rgba(server->config.border_ufoc_col_val, server->border_unfocused);
+    colour_to_rgba(server->config.border_swap_col_val, server->border_swap);
+
+    for (int i = 0; i < NUM_WORKSPACES; ++i) {
+        struct swwm_toplevel *toplevel;
+        wl_list_for_each(toplevel, &server->workspaces[i].toplevels, workspace_link) {
+            toplevel_update_border_colour(toplevel);
+        }
+        wl_list_for_each(toplevel, &server->workspaces[i].floating_toplevels, workspace_link) {
+            toplevel_update_border_colour(toplevel);
+        }
+    }
+}
+
+// Output scales can change on reload; returns whether any output changed so
+// the caller knows to re-arrange
+static bool apply_config_scales(struct swwm_server *server) {
+    bool changed = false;
+    struct swwm_output *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        float scale = config_output_scale(&server->config, output->wlr_output->name);
+        if (output->wlr_output->scale == scale) continue;
+        changed = true;
+        struct wlr_output_state state;
+        wlr_output_state_init(&state);
+        wlr_output_state_set_scale(&state, scale);
+        if (!wlr_output_commit_state(output->wlr_output, &state)) {
+            wlr_log(WLR_ERROR, "Failed to set scale %.2f on %s", scale, output->wlr_output->name);
+        }
+        wlr_output_state_finish(&state);
+        load_cursor_theme(server, output->wlr_output->scale);
+    }
+    return changed;
 }
 
 static void apply_config(struct swwm_server *server) {
-    // Apply settings that affect global server state or visuals
-    // e.g., cursor theme, if configurable, would be set here.
-    // Gaps, master_width are used by arrange_workspace.
+    // Apply settings that affect global server state or visuals.
+    // Gaps, master_width and border_width are used by arrange_workspace.
     // Keybindings are already loaded.
-    // For now, most config is used on-demand.
+    apply_config_colours(server);
+    apply_config_scales(server);
 }
 
 
-int main(int argc, char *argv[]) {
-	wlr_log_init(WLR_INFO, NULL); // Changed to INFO for less verbosity
-	char *startup_cmd = NULL;
+// --- Library entry points (libswwm.h) ---
 
-	int c;
-	while ((c = getopt(argc, argv, "s:h")) != -1) {
-		switch (c) {
-		case 's':
-			startup_cmd = optarg;
-			break;
-		default:
-			printf("Usage: %s [-s startup command]\n", argv[0]);
-			return 0;
-		}
-	}
-	if (optind < argc) {
-		printf("Usage: %s [-s startup command]\n", argv[0]);
-		return 0;
-	}
+struct swwm_server *swwm_server_create(const struct swwm_server_options *options) {
+	struct swwm_server_options defaults = { .backend = SWWM_BACKEND_AUTO, .load_config = true };
+	if (!options) options = &defaults;
 
-	struct swwm_server server = {0};
-	server.wl_display = wl_display_create();
-	server.backend = wlr_backend_autocreate(wl_display_get_event_loop(server.wl_display), NULL);
-	if (server.backend == NULL) {
+	struct swwm_server *server = calloc(1, sizeof(*server));
+	if (!server) return NULL;
+	server->startup_ns = server->startup_mark_ns = frame_stats_now_ns();
+	server->wl_display = wl_display_create();
+	struct wl_event_loop *loop = wl_display_get_event_loop(server->wl_display);
+	if (options->backend == SWWM_BACKEND_HEADLESS) {
+		// Benchmarks, replay, VNC and library harnesses run without a GPU
+		// or a session: the caller adds the outputs, pixman renders them.
+		server->backend = wlr_headless_backend_create(loop);
+	} else {
+		server->backend = wlr_backend_autocreate(loop, NULL);
+	}
+	if (server->backend == NULL) {
 		wlr_log(WLR_ERROR, "failed to create wlr_backend");
-		return 1;
+		goto error_display;
 	}
+	startup_phase(server, "backend");
 
-	server.renderer = wlr_renderer_autocreate(server.backend);
-	if (server.renderer == NULL) {
+	if (options->backend == SWWM_BACKEND_HEADLESS && !getenv("WLR_RENDERER")) {
+		server->renderer = wlr_pixman_renderer_create();
+	} else {
+		server->renderer = wlr_renderer_autocreate(server->backend);
+	}
+	if (server->renderer == NULL) {
 		wlr_log(WLR_ERROR, "failed to create wlr_renderer");
-		return 1;
+		goto error_backend;
 	}
-	wlr_renderer_init_wl_display(server.renderer, server.wl_display);
+	// wl_shm always; linux-dmabuf (below, once the scene exists) when the
+	// renderer can import dmabufs
+	wlr_renderer_init_wl_shm(server->renderer, server->wl_display);
+	startup_phase(server, "renderer");
 
-	server.allocator = wlr_allocator_autocreate(server.backend, server.renderer);
-	if (server.allocator == NULL) {
+	server->allocator = wlr_allocator_autocreate(server->backend, server->renderer);
+	if (server->allocator == NULL) {
 		wlr_log(WLR_ERROR, "failed to create wlr_allocator");
-		return 1;
+		goto error_renderer;
 	}
-
-	wlr_compositor_create(server.wl_display, 5, server.renderer);
-	wlr_subcompositor_create(server.wl_display);
-	wlr_data_device_manager_create(server.wl_display);
-
-	server.output_layout = wlr_output_layout_create(server.wl_display);
-	wl_list_init(&server.outputs);
-	server.new_output.notify = server_new_output;
-	wl_signal_add(&server.backend->events.new_output, &server.new_output);
-
-	server.scene = wlr_scene_create();
-    server.toplevel_layer = wlr_scene_tree_create(server.scene); // Layer for app windows
-	server.scene_layout = wlr_scene_attach_output_layout(server.scene, server.output_layout);
+	startup_phase(server, "allocator");
+
+	wlr_compositor_create(server->wl_display, 5, server->renderer);
+	wlr_subcompositor_create(server->wl_display);
+	// Fractional scale tells clients the exact scale, viewporter lets them
+	// attach buffers at the physical size of a fractional logical size
+	wlr_viewporter_create(server->wl_display);
+	wlr_fractional_scale_manager_v1_create(server->wl_display, 1);
+	wlr_data_device_manager_create(server->wl_display);
+
+	// Frame pacing for clients: presentation feedback tells them the refresh
+	// cycle, fifo/commit-timing let them queue commits without frame callbacks.
+	server->presentation = wlr_presentation_create(server->wl_display, server->backend, 2);
+	server->fifo_manager = wlr_fifo_manager_v1_create(server->wl_display, 1);
+	server->commit_timing_manager = wlr_commit_timing_manager_v1_create(server->wl_display, 1);
+	server->new_commit_timer.notify = server_new_commit_timer;
+	wl_signal_add(&server->commit_timing_manager->events.new_timer, &server->new_commit_timer);
+
+	server->output_layout = wlr_output_layout_create(server->wl_display);
+	wl_list_init(&server->outputs);
+	server->new_output.notify = server_new_output;
+	wl_signal_add(&server->backend->events.new_output, &server->new_output);
+
+	server->scene = wlr_scene_create();
+    server->toplevel_layer = wlr_scene_tree_create(&server->scene->tree); // Layer for app windows
+	server->scene_layout = wlr_scene_attach_output_layout(server->scene, server->output_layout);
+
+	// linux-dmabuf v4 with feedback: the renderer's formats as the default
+	// tranche, and the scene adds scanout tranches for surfaces it could put
+	// on a plane directly (fullscreen), so clients allocate zero-copy buffers
+	if (wlr_renderer_get_texture_formats(server->renderer, WLR_BUFFER_CAP_DMABUF) != NULL) {
+		// Legacy wl_drm as wlr_renderer_init_wl_display would create it:
+		// older Xwayland and Mesa EGL clients still look for it
+		if (wlr_renderer_get_drm_fd(server->renderer) >= 0) {
+			wlr_drm_create(server->wl_display, server->renderer);
+		}
+		server->linux_dmabuf = wlr_linux_dmabuf_v1_create_with_renderer(server->wl_display, 4, server->renderer);
+		if (server->linux_dmabuf) {
+			wlr_scene_set_linux_dmabuf_v1(server->scene, server->linux_dmabuf);
+		} else {
+			wlr_log(WLR_ERROR, "failed to create linux-dmabuf, clients will fall back to shm");
+		}
+	}
+	startup_phase(server, "globals");
 
     // --- sxwm feature initialization ---
-    init_default_config(&server.config);
-    if (parser(&server, &server.config) != 0) { // Pass server for context if parser needs it
+    init_default_config(&server->config);
+#ifdef SWWM_STATIC_CONFIG
+    // Built with STATIC_CONFIG=1: no swwmrc to read or watch
+    if (options->load_config) load_static_config(&server->config);
+#else
+    if (options->load_config && parser(server, &server->config) != 0) { // Pass server for context if parser needs it
         wlr_log(WLR_ERROR, "Failed to parse config file, using defaults.");
-        // Load built-in defaults from config.txt if parser fails badly
-        // This part is tricky; parser.c doesn't have access to the `binds` array from config.txt directly
-        // For now, assume parser errors mean sticking to `init_default_config` values + whatever it managed to parse
+        // Keep whatever it managed to parse; with no binds at all, use config.h's
+        load_builtin_binds(&server->config);
+    }
+    if (options->load_config && !config_watch_start(server)) {
+        wlr_log(WLR_ERROR, "Not watching the config file, reload it with the reload_config bind");
     }
-    apply_config(&server);
-    server.current_ws_idx = 0;
+#endif
+    server->config_gaps = server->config.gaps;
+    memcpy(server->config_master_width, server->config.master_width, sizeof(server->config_master_width));
+    server->current_ws_idx = 0;
     for (int i = 0; i < NUM_WORKSPACES; ++i) {
-        wl_list_init(&server.workspaces[i].toplevels);
-        wl_list_init(&server.workspaces[i].floating_toplevels);
-        server.workspaces[i].output = NULL; // Will be assigned when outputs appear
-        server.workspaces[i].id = i;
-    }
-    server.focused_toplevel = NULL;
-    server.global_floating = false;
-    server.next_toplevel_should_float = false;
+        wl_list_init(&server->workspaces[i].toplevels);
+        wl_list_init(&server->workspaces[i].floating_toplevels);
+        server->workspaces[i].output = NULL; // Will be assigned when outputs appear
+        server->workspaces[i].id = i;
+    }
+    apply_config(server);
+    server->focused_toplevel = NULL;
+    server->global_floating = false;
     // --- end sxwm feature initialization ---
+    startup_phase(server, "config");
+
+
+	server->xdg_shell = wlr_xdg_shell_create(server->wl_display, 3);
+	server->new_xdg_toplevel.notify = server_new_xdg_toplevel;
+	wl_signal_add(&server->xdg_shell->events.new_toplevel, &server->new_xdg_toplevel);
+	server->new_xdg_popup.notify = server_new_xdg_popup;
+	wl_signal_add(&server->xdg_shell->events.new_popup, &server->new_xdg_popup);
+
+	// Screen capture. Output sources and screencopy capture whole outputs
+	// from their scene output and report its damage per frame; toplevel
+	// sources capture one window's surface tree.
+	wlr_xdg_output_manager_v1_create(server->wl_display, server->output_layout);
+	wlr_screencopy_manager_v1_create(server->wl_display);
+	wlr_ext_image_copy_capture_manager_v1_create(server->wl_display, 1);
+	wlr_ext_output_image_capture_source_manager_v1_create(server->wl_display, 1);
+	server->foreign_toplevel_list = wlr_ext_foreign_toplevel_list_v1_create(server->wl_display, 1);
+	server->toplevel_capture_mgr = wlr_ext_foreign_toplevel_image_capture_source_manager_v1_create(server->wl_display, 1);
+	server->new_toplevel_capture_request.notify = server_new_toplevel_capture_request;
+	wl_signal_add(&server->toplevel_capture_mgr->events.new_request, &server->new_toplevel_capture_request);
+
+	// Activation tokens, handed to every launch (spawn.c)
+	server->xdg_activation = wlr_xdg_activation_v1_create(server->wl_display);
+	server->request_activate.notify = server_request_activate;
+	wl_signal_add(&server->xdg_activation->events.request_activate, &server->request_activate);
+
+	// Ask clients to leave decorations to us; we only draw borders
+	server->xdg_decoration_mgr = wlr_xdg_decoration_manager_v1_create(server->wl_display);
+	server->new_xdg_decoration.notify = server_new_xdg_decoration;
+	wl_signal_add(&server->xdg_decoration_mgr->events.new_toplevel_decoration, &server->new_xdg_decoration);
+	startup_phase(server, "shell");
+
+	server->cursor = wlr_cursor_create();
+	wlr_cursor_attach_output_layout(server->cursor, server->output_layout);
+	server->cursor_mgr = wlr_xcursor_manager_create(NULL, 24); // Themes load per output, see load_cursor_theme
+    // Set initial cursor, sxwm uses "left_ptr", "fleur", "bottom_right_corner"
+    // wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr, "left_ptr"); // Default
 
 
-	server.xdg_shell = wlr_xdg_shell_create(server.wl_display, 3);
-	server.new_xdg_toplevel.notify = server_new_xdg_toplevel;
-	wl_signal_add(&server.xdg_shell->events.new_toplevel, &server.new_xdg_toplevel);
-	server.new_xdg_popup.notify = server_new_xdg_popup;
-	wl_signal_add(&server.xdg_shell->events.new_popup, &server.new_xdg_popup);
+	server->cursor_mode = SWM_CURSOR_PASSTHROUGH;
+	server->cursor_motion.notify = server_cursor_motion;
+	wl_signal_add(&server->cursor->events.motion, &server->cursor_motion);
+	server->cursor_motion_absolute.notify = server_cursor_motion_absolute;
+	wl_signal_add(&server->cursor->events.motion_absolute, &server->cursor_motion_absolute);
+	server->cursor_button.notify = server_cursor_button;
+	wl_signal_add(&server->cursor->events.button, &server->cursor_button);
+	server->cursor_axis.notify = server_cursor_axis;
+	wl_signal_add(&server->cursor->events.axis, &server->cursor_axis);
+	server->cursor_frame.notify = server_cursor_frame;
+	wl_signal_add(&server->cursor->events.frame, &server->cursor_frame);
+
+	wl_list_init(&server->keyboards);
+	server->new_input.notify = server_new_input;
+	wl_signal_add(&server->backend->events.new_input, &server->new_input);
+	server->seat = wlr_seat_create(server->wl_display, "seat0");
+	server->request_cursor.notify = seat_request_cursor;
+	wl_signal_add(&server->seat->events.request_set_cursor, &server->request_cursor);
+	server->request_set_selection.notify = seat_request_set_selection;
+	wl_signal_add(&server->seat->events.request_set_selection, &server->request_set_selection);
+
+    // Children are reaped here rather than ignored, to log how they exited
+    wl_list_init(&server->children);
+    wl_list_init(&server->launches);
+    server->sigchld_source = wl_event_loop_add_signal(loop, SIGCHLD, spawn_handle_sigchld, server);
+    // kill -USR1 dumps per-output frame timing histograms to stderr
+    server->sigusr1_source = wl_event_loop_add_signal(loop, SIGUSR1, handle_sigusr1, server);
+    // kill -USR2 starts handler tracing, and the next one writes the trace
+    server->sigusr2_source = wl_event_loop_add_signal(loop, SIGUSR2, handle_sigusr2, server);
+    startup_phase(server, "input");
+	return server;
+
+error_renderer:
+	wlr_renderer_destroy(server->renderer);
+error_backend:
+	wlr_backend_destroy(server->backend);
+error_display:
+	wl_display_destroy(server->wl_display);
+	free(server);
+	return NULL;
+}
 
-	server.cursor = wlr_cursor_create();
-	wlr_cursor_attach_output_layout(server.cursor, server.output_layout);
-	server.cursor_mgr = wlr_xcursor_manager_create(NULL, 24);
-    wlr_xcursor_manager_load(server.cursor_mgr, 1.0); // Load default theme at scale 1
-    // Set initial cursor, sxwm uses "left_ptr", "fleur", "bottom_right_corner"
-    // wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, "left_ptr"); // Default
-
-
-	server.cursor_mode = SWM_CURSOR_PASSTHROUGH;
-	server.cursor_motion.notify = server_cursor_motion;
-	wl_signal_add(&server.cursor->events.motion, &server.cursor_motion);
-	server.cursor_motion_absolute.notify = server_cursor_motion_absolute;
-	wl_signal_add(&server.cursor->events.motion_absolute, &server.cursor_motion_absolute);
-	server.cursor_button.notify = server_cursor_button;
-	wl_signal_add(&server.cursor->events.button, &server.cursor_button);
-	server.cursor_axis.notify = server_cursor_axis;
-	wl_signal_add(&server.cursor->events.axis, &server.cursor_axis);
-	server.cursor_frame.notify = server_cursor_frame;
-	wl_signal_add(&server.cursor->events.frame, &server.cursor_frame);
-
-	wl_list_init(&server.keyboards);
-	server.new_input.notify = server_new_input;
-	wl_signal_add(&server.backend->events.new_input, &server.new_input);
-	server.seat = wlr_seat_create(server.wl_display, "seat0");
-	server.request_cursor.notify = seat_request_cursor;
-	wl_signal_add(&server.seat->events.request_set_cursor, &server.request_cursor);
-	server.request_set_selection.notify = seat_request_set_selection;
-	wl_signal_add(&server.seat->events.request_set_selection, &server.request_set_selection);
-
-    signal(SIGCHLD, SIG_IGN); // Prevent zombie processes from exec
-
-	const char *socket = wl_display_add_socket_auto(server.wl_display);
+const char *swwm_server_start(struct swwm_server *server) {
+	startup_phase(server, "idle"); // Between create and start, the caller's time
+	const char *socket = wl_display_add_socket_auto(server->wl_display);
 	if (!socket) {
-		wlr_backend_destroy(server.backend);
-		return 1;
+		wlr_log(WLR_ERROR, "failed to open a Wayland socket");
+		return NULL;
 	}
-
-	if (!wlr_backend_start(server.backend)) {
-		wlr_backend_destroy(server.backend);
-		wl_display_destroy(server.wl_display);
-		return 1;
+	startup_phase(server, "socket");
+	if (!wlr_backend_start(server->backend)) {
+		wlr_log(WLR_ERROR, "failed to start backend");
+		return NULL;
 	}
-
+	// Outputs present at start are configured (and their cursor themes
+	// loaded) from here
+	startup_phase(server, "backend_start");
 	setenv("WAYLAND_DISPLAY", socket, true);
-	if (startup_cmd) {
-		if (fork() == 0) {
-			execl("/bin/sh", "/bin/sh", "-c", startup_cmd, (void *)NULL);
-            perror("execl startup_cmd");
-            _exit(1);
-		}
-	} else { // Default startup if nothing specified (e.g. a terminal)
-        const char *term_cmd[] = {"foot", NULL}; // Example, use CMD(terminal) from config
-        // spawn_swwm(&server, server.config.binds[findIndexFor("terminal")].arg);
-        // This requires a more robust way to get default commands if not via keybind
-    }
+	log_startup(server);
+	return socket;
+}
 
-	wlr_log(WLR_INFO, "Running Wayland compositor on WAYLAND_DISPLAY=%s", socket);
-	wl_display_run(server.wl_display);
+void swwm_server_run(struct swwm_server *server) {
+	wl_display_run(server->wl_display);
+}
+
+int swwm_server_dispatch(struct swwm_server *server, int timeout_ms) {
+	wl_display_flush_clients(server->wl_display);
+	return wl_event_loop_dispatch(wl_display_get_event_loop(server->wl_display), timeout_ms);
+}
+
+void swwm_server_terminate(struct swwm_server *server) {
+	wl_display_terminate(server->wl_display);
+}
+
+void swwm_server_destroy(struct swwm_server *server) {
+	if (!server) return;
+    wl_event_source_remove(server->sigusr1_source);
+    wl_event_source_remove(server->sigusr2_source);
+    wl_event_source_remove(server->sigchld_source);
+    spawn_finish(server);
+    swwm_record_stop(server);
+    swwm_vnc_stop(server);
+    swwm_ipc_stop(server);
+    swwm_snapshot_stop(server);
+    config_watch_stop(server);
+    trace_finish();
 
 	// Cleanup
     // Free config resources
-    for (int i = 0; i < server.config.bindsn; ++i) {
-        if (server.config.binds[i].type == TYPE_CMD && server.config.binds[i].action.cmd) {
-            for (int k = 0; server.config.binds[i].action.cmd[k]; ++k) {
-                free((void*)server.config.binds[i].action.cmd[k]);
-            }
-            free(server.config.binds[i].action.cmd);
-        }
-    }
-    for (int i = 0; i < server.config.should_floatn; ++i) {
-        free(server.config.should_float[i]);
-    }
-
-	wl_display_destroy_clients(server.wl_display);
-    wlr_scene_node_destroy(&server.scene->tree.node); // Destroys all children including toplevel_layer
-	wlr_output_layout_destroy(server.output_layout);
-    wlr_xcursor_manager_destroy(server.cursor_mgr);
-	wlr_cursor_destroy(server.cursor);
-    wlr_seat_destroy(server.seat); // Destroy seat before backend usually
-	wlr_allocator_destroy(server.allocator);
-	wlr_renderer_destroy(server.renderer);
-	wlr_backend_destroy(server.backend);
-	wl_display_destroy(server.wl_display);
-	return 0;
+    config_free(&server->config);
+
+	wl_display_destroy_clients(server->wl_display);
+    if (server->virtual_keyboard_ready) wlr_keyboard_finish(&server->virtual_keyboard);
+    if (server->virtual_pointer_ready) wlr_pointer_finish(&server->virtual_pointer);
+    wlr_scene_node_destroy(&server->scene->tree.node); // Destroys all children including toplevel_layer
+	wlr_output_layout_destroy(server->output_layout);
+    wlr_xcursor_manager_destroy(server->cursor_mgr);
+	wlr_cursor_destroy(server->cursor);
+    wlr_seat_destroy(server->seat); // Destroy seat before backend usually
+	wlr_allocator_destroy(server->allocator);
+	wlr_renderer_destroy(server->renderer);
+	wlr_backend_destroy(server->backend);
+	wl_display_destroy(server->wl_display);
+	free(server);
+}
+
+bool swwm_server_add_headless_output(struct swwm_server *server, int width, int height) {
+	if (!wlr_backend_is_headless(server->backend)) return false;
+	return wlr_headless_add_output(server->backend, width, height) != NULL;
+}
+
+void swwm_dump_frame_stats(struct swwm_server *server, FILE *f) {
+	dump_frame_stats(server, f);
+}
+
+// --- Input injection: a virtual keyboard and pointer, created on first use,
+// feed events through the same listeners as real devices. ---
+
+static const struct wlr_keyboard_impl virtual_keyboard_impl = {
+	.name = "swwm-virtual-keyboard",
+};
+
+static const struct wlr_pointer_impl virtual_pointer_impl = {
+	.name = "swwm-virtual-pointer",
+};
+
+static struct wlr_keyboard *virtual_keyboard(struct swwm_server *server) {
+	if (!server->virtual_keyboard_ready) {
+		wlr_keyboard_init(&server->virtual_keyboard, &virtual_keyboard_impl, "swwm-virtual-keyboard");
+		server->virtual_keyboard_ready = true;
+		server_new_input(&server->new_input, &server->virtual_keyboard.base);
+	}
+	return &server->virtual_keyboard;
+}
+
+static struct wlr_pointer *virtual_pointer(struct swwm_server *server) {
+	if (!server->virtual_pointer_ready) {
+		wlr_pointer_init(&server->virtual_pointer, &virtual_pointer_impl, "swwm-virtual-pointer");
+		server->virtual_pointer_ready = true;
+		server_new_input(&server->new_input, &server->virtual_pointer.base);
+	}
+	return &server->virtual_pointer;
+}
+
+void swwm_inject_key(struct swwm_server *server, uint32_t time_msec, uint32_t keycode, bool pressed) {
+	struct wlr_keyboard_key_event event = {
+		.time_msec = time_msec,
+		.keycode = keycode,
+		.update_state = true,
+		.state = pressed ? WL_KEYBOARD_KEY_STATE_PRESSED : WL_KEYBOARD_KEY_STATE_RELEASED,
+	};
+	wlr_keyboard_notify_key(virtual_keyboard(server), &event);
+}
+
+void swwm_inject_motion(struct swwm_server *server, uint32_t time_msec, double dx, double dy) {
+	struct wlr_pointer *pointer = virtual_pointer(server);
+	struct wlr_pointer_motion_event event = {
+		.pointer = pointer,
+		.time_msec = time_msec,
+		.delta_x = dx,
+		.delta_y = dy,
+		.unaccel_dx = dx,
+		.unaccel_dy = dy,
+	};
+	wl_signal_emit_mutable(&pointer->events.motion, &event);
+}
+
+void swwm_inject_motion_absolute(struct swwm_server *server, uint32_t time_msec, double x, double y) {
+	struct wlr_pointer *pointer = virtual_pointer(server);
+	struct wlr_pointer_motion_absolute_event event = {
+		.pointer = pointer,
+		.time_msec = time_msec,
+		.x = x,
+		.y = y,
+	};
+	wl_signal_emit_mutable(&pointer->events.motion_absolute, &event);
+}
+
+void swwm_inject_button(struct swwm_server *server, uint32_t time_msec, uint32_t button, bool pressed) {
+	struct wlr_pointer *pointer = virtual_pointer(server);
+	struct wlr_pointer_button_event event = {
+		.pointer = pointer,
+		.time_msec = time_msec,
+		.button = button,
+		.state = pressed ? WL_POINTER_BUTTON_STATE_PRESSED : WL_POINTER_BUTTON_STATE_RELEASED,
+	};
+	wl_signal_emit_mutable(&pointer->events.button, &event);
+}
+
+void swwm_inject_axis(struct swwm_server *server, uint32_t time_msec, bool horizontal,
+		double delta, int32_t delta_discrete) {
+	struct wlr_pointer *pointer = virtual_pointer(server);
+	struct wlr_pointer_axis_event event = {
+		.pointer = pointer,
+		.time_msec = time_msec,
+		.source = WL_POINTER_AXIS_SOURCE_WHEEL,
+		.orientation = horizontal ? WL_POINTER_AXIS_HORIZONTAL_SCROLL : WL_POINTER_AXIS_VERTICAL_SCROLL,
+		.relative_direction = WL_POINTER_AXIS_RELATIVE_DIRECTION_IDENTICAL,
+		.delta = delta,
+		.delta_discrete = delta_discrete,
+	};
+	wl_signal_emit_mutable(&pointer->events.axis, &event);
+}
+
+void swwm_inject_frame(struct swwm_server *server) {
+	struct wlr_pointer *pointer = virtual_pointer(server);
+	wl_signal_emit_mutable(&pointer->events.frame, pointer);
+}
+
+// --- State queries ---
+
+int swwm_current_workspace(struct swwm_server *server) {
+	return server->current_ws_idx;
+}
+
+bool swwm_get_workspace_info(struct swwm_server *server, int idx, struct swwm_workspace_info *info) {
+	if (idx < 0 || idx >= NUM_WORKSPACES) return false;
+	struct swwm_workspace *ws = &server->workspaces[idx];
+	info->id = ws->id;
+	info->tiled = wl_list_length(&ws->toplevels);
+	info->floating = wl_list_length(&ws->floating_toplevels);
+	info->visible = workspace_is_visible(ws);
+	info->output_name = ws->output ? ws->output->wlr_output->name : NULL;
+	return true;
+}
+
+static void fill_toplevel_info(struct swwm_server *server, struct swwm_toplevel *toplevel,
+        struct swwm_toplevel_info *info) {
+	info->app_id = toplevel->xdg_toplevel->app_id;
+	info->title = toplevel->xdg_toplevel->title;
+	info->workspace = toplevel->ws_idx;
+	info->floating = toplevel->floating;
+	info->fullscreen = toplevel->fullscreen;
+	info->focused = toplevel == server->focused_toplevel;
+	info->x = toplevel->geom.x;
+	info->y = toplevel->geom.y;
+	info->width = toplevel->geom.width;
+	info->height = toplevel->geom.height;
+}
+
+size_t swwm_get_toplevels(struct swwm_server *server, struct swwm_toplevel_info *infos, size_t max) {
+	size_t n = 0;
+	for (int i = 0; i < NUM_WORKSPACES; ++i) {
+		struct swwm_toplevel *iter;
+		wl_list_for_each(iter, &server->workspaces[i].toplevels, workspace_link) {
+			if (n < max) fill_toplevel_info(server, iter, &infos[n]);
+			n++;
+		}
+		wl_list_for_each(iter, &server->workspaces[i].floating_toplevels, workspace_link) {
+			if (n < max) fill_toplevel_info(server, iter, &infos[n]);
+			n++;
+		}
+	}
+	return n; // Total count, may exceed max
+}
+
+void swwm_arrange_workspace(struct swwm_server *server, int idx) {
+	if (idx < 0 || idx >= NUM_WORKSPACES) return;
+	arrange_workspace(&server->workspaces[idx]);
+}
+
+void swwm_arrange_begin(struct swwm_server *server) {
+	server->arrange_batch++;
+}
+
+void swwm_arrange_end(struct swwm_server *server) {
+	if (--server->arrange_batch > 0) return;
+	uint32_t pending = server->arrange_pending;
+	server->arrange_pending = 0;
+	for (; pending; pending &= pending - 1) {
+		// Checks visibility again: a later command may have hidden it
+		arrange_workspace(&server->workspaces[__builtin_ctz(pending)]);
+	}
 }
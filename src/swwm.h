@@ -0,0 +1,257 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/util/box.h>
+
+#include "config_watch.h"
+#include "defs.h"
+#include "frame_stats.h"
+#include "input_record.h"
+#include "libswwm.h"
+#include "spawn.h"
+
+// Core compositor state, shared between the translation units of libswwm.
+// Code outside the library (main.c, harnesses) only uses libswwm.h.
+
+/* For brevity's sake, struct members are annotated where they are used. */
+enum swwm_cursor_mode {
+	SWM_CURSOR_PASSTHROUGH,
+	SWM_CURSOR_MOVE,
+	SWM_CURSOR_RESIZE,
+    SWM_CURSOR_SWAP, // For dragging tiled windows to swap
+};
+
+struct swwm_output_slot {
+	char name[64]; // wlr_output name, empty if never used
+	bool connected;
+	uint64_t released_seq; // output_slot_seq when last unplugged
+	uint32_t workspaces; // Bitmask of workspaces on the output when it went away
+};
+
+// Startup profiling: each phase of swwm_server_create/start, see startup_phase
+#define STARTUP_PHASES_MAX 16
+
+struct swwm_startup_phase {
+	const char *name;
+	uint64_t us;
+};
+
+struct swwm_server {
+	struct wl_display *wl_display;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_linux_dmabuf_v1 *linux_dmabuf; // NULL if the renderer cannot import dmabufs
+	struct wlr_scene *scene; // Root scene node
+    struct wlr_scene_tree *toplevel_layer; // Scene layer for toplevels
+	struct wlr_scene_output_layout *scene_layout;
+
+	struct wlr_xdg_shell *xdg_shell;
+	struct wl_listener new_xdg_toplevel;
+	struct wl_listener new_xdg_popup;
+
+	struct wlr_xdg_decoration_manager_v1 *xdg_decoration_mgr;
+	struct wl_listener new_xdg_decoration;
+
+	// Screen capture: ext-image-copy-capture with output and toplevel
+	// sources, wlr-screencopy for older clients. Damage comes from the scene.
+	struct wlr_ext_foreign_toplevel_list_v1 *foreign_toplevel_list;
+	struct wlr_ext_foreign_toplevel_image_capture_source_manager_v1 *toplevel_capture_mgr;
+	struct wl_listener new_toplevel_capture_request;
+	// struct wl_list toplevels; // Replaced by workspaces
+
+	struct wlr_cursor *cursor;
+	struct wlr_xcursor_manager *cursor_mgr;
+	struct wl_listener cursor_motion;
+	struct wl_listener cursor_motion_absolute;
+	struct wl_listener cursor_button;
+	struct wl_listener cursor_axis;
+	struct wl_listener cursor_frame;
+
+	struct wlr_seat *seat;
+	struct wl_listener new_input;
+	struct wl_listener request_cursor;
+	struct wl_listener request_set_selection;
+	struct wl_list keyboards;
+	enum swwm_cursor_mode cursor_mode;
+	struct swwm_toplevel *grabbed_toplevel; // Toplevel being moved/resized
+    struct swwm_toplevel *swap_target_toplevel; // Toplevel to swap with
+	double grab_x, grab_y; // Cursor grab point relative to toplevel corner
+	struct wlr_box grab_geobox; // Toplevel geometry at start of grab
+	uint32_t resize_edges;
+
+	struct wlr_output_layout *output_layout;
+	struct wl_list outputs; // swwm_output
+	struct wl_listener new_output;
+	// Per-output state that survives unplugging, looked up by output name.
+	// swwm_output::idx is the slot, so config.master_width[idx] follows the
+	// monitor rather than the order outputs were plugged in.
+	struct swwm_output_slot output_slots[MAX_MONITORS];
+	uint64_t output_slot_seq; // Stamps slots on release, oldest is recycled first
+
+    // Frame pacing: clients queue commits for the next refresh (fifo) or a
+    // target time (commit-timing); both are released by the output frame path.
+	struct wlr_presentation *presentation;
+	struct wlr_fifo_manager_v1 *fifo_manager;
+	struct wlr_commit_timing_manager_v1 *commit_timing_manager;
+	struct wl_listener new_commit_timer;
+
+    // --- sxwm features ---
+    Config config;
+    // gaps/master_width as the config file last set them; reload compares
+    // against these so values adjusted at runtime survive unrelated edits
+    int config_gaps;
+    float config_master_width[MAX_MONITORS]; // Per output slot
+    struct swwm_workspace workspaces[NUM_WORKSPACES];
+    int current_ws_idx; // Active workspace of the output with focus
+    struct swwm_toplevel *focused_toplevel; // Currently keyboard-focused toplevel
+    bool global_floating; // All new windows float, existing ones toggle
+    long last_motion_time_msec; // For motion throttle
+    // Border colours from the config, premultiplied RGBA for wlr_scene_rect
+    float border_focused[4];
+    float border_unfocused[4];
+    float border_swap[4];
+    // --- end sxwm features ---
+
+    // Startup profiling, logged once the backend is up
+    uint64_t startup_ns; // swwm_server_create entry
+    uint64_t startup_mark_ns; // End of the previous phase
+    struct swwm_startup_phase startup_phases[STARTUP_PHASES_MAX];
+    int startup_phasesn;
+    uint64_t first_frame_ns; // First output commit, 0 until then
+
+    struct wl_event_source *sigusr1_source; // Dumps frame stats
+    struct wl_event_source *sigusr2_source; // Toggles handler tracing, see trace.h
+    struct wl_event_source *sigchld_source; // Reaps children, see spawn.c
+
+    struct wl_list children; // swwm_child, launched and not yet reaped
+    uint64_t children_spawned;
+    uint64_t children_exited;
+    uint64_t children_failed; // Non-zero exit or killed by a signal
+    struct frame_histogram spawn_time; // Time the compositor spends per launch
+
+    // Launch tracking through xdg-activation tokens, see spawn.h
+    struct wlr_xdg_activation_v1 *xdg_activation;
+    struct wl_listener request_activate;
+    struct wl_list launches; // swwm_launch
+    uint64_t key_press_ns; // Set while a key press runs its binding, else 0
+    struct swwm_launch_stats launch_stats[LAUNCH_STATS_MAX];
+    int launch_statsn;
+    struct swwm_launch_stats launch_stats_other; // app_ids past LAUNCH_STATS_MAX
+
+    uint64_t configures_sent; // xdg_surface configures sent to clients (benchmarks)
+    uint64_t toplevels_mapped; // Toplevel map events handled (benchmarks)
+
+    // Devices behind swwm_inject_*, created on first use
+    struct wlr_keyboard virtual_keyboard;
+    struct wlr_pointer virtual_pointer;
+    bool virtual_keyboard_ready;
+    bool virtual_pointer_ready;
+
+    struct input_recorder *recorder; // Set while recording input (-R)
+    struct swwm_vnc *vnc; // Set while serving an output over VNC (-V), see vnc.c
+    struct swwm_config_watch *config_watch; // inotify reload, see config_watch.h
+    struct swwm_ipc *ipc; // Set while the IPC socket is open, see ipc.h
+    uint32_t next_toplevel_id; // IPC handle for the next toplevel, never reused
+    struct swwm_snapshot_writer *snapshot; // Shared-memory state for readers, see snapshot.h
+
+    // Inside swwm_arrange_begin/end, arrange_workspace only marks workspaces
+    // in arrange_pending, and they are laid out once at the end
+    int arrange_batch;
+    uint32_t arrange_pending;
+};
+
+struct swwm_output {
+	struct wl_list link;
+	struct swwm_server *server;
+	struct wlr_output *wlr_output;
+    struct wlr_scene_output *scene_output; // For rendering
+	struct wl_listener frame;
+	struct wl_listener request_state;
+	struct wl_listener destroy;
+    int idx; // Slot in server->output_slots (and config.master_width)
+    int active_ws; // Workspace shown on this output, -1 while it has none
+    struct wlr_box usable_area; // Geometry excluding panels/docks (future)
+    struct frame_stats frame_stats; // Commit duration / frame interval histograms
+};
+
+enum swwm_border_edge {
+	SWWM_BORDER_TOP,
+	SWWM_BORDER_BOTTOM,
+	SWWM_BORDER_LEFT,
+	SWWM_BORDER_RIGHT,
+};
+
+struct swwm_toplevel {
+	struct wl_list link; // Overall list in server (not used much now)
+    struct wl_list workspace_link; // For linking within a workspace's list
+	struct swwm_server *server;
+	struct wlr_xdg_toplevel *xdg_toplevel;
+	struct wlr_scene_tree *scene_tree; // Frame: borders + client surface, positioned at geom
+    struct wlr_scene_tree *surface_tree; // Client surface, inset by the border width
+    struct wlr_scene_rect *border[4]; // SWWM_BORDER_*, resized only by the layout pass
+	struct wl_listener map;
+	struct wl_listener unmap;
+	struct wl_listener commit; // Important for app_id
+	struct wl_listener destroy;
+	struct wl_listener request_move;
+	struct wl_listener request_resize;
+	struct wl_listener request_maximize;
+	struct wl_listener request_fullscreen;
+    struct wl_listener set_app_id; // To catch app_id changes
+    struct wl_listener set_title;
+    struct wl_listener set_parent; // Re-matches parent= rules
+    struct wl_listener configure; // Counts configures sent
+
+    struct wlr_xdg_toplevel_decoration_v1 *decoration; // NULL if the client didn't ask
+    struct wl_listener decoration_request_mode;
+    struct wl_listener decoration_destroy;
+
+    // --- sxwm features integrated ---
+    int ws_idx; // Workspace index it belongs to
+    bool floating;
+    bool fullscreen;
+    // xdg_toplevel->surface->mapped is the equivalent of sxwm client->mapped
+    struct wlr_box geom; // Last configured frame geometry, borders included (layout coords for tiling, absolute for floating)
+    struct wlr_box saved_geom_tile; // Geometry before floating/fullscreen (if it was tiled)
+    struct wlr_box saved_geom_float; // Geometry before fullscreen (if it was floating)
+    // int mon_idx; // Implicit from output_layout and geom
+    // --- end sxwm features ---
+
+    struct wlr_ext_foreign_toplevel_handle_v1 *foreign_handle; // While mapped; capture source
+    struct swwm_launch *launch; // Launch that created it, until its first frame
+    struct rule_cache rules; // Window rules it matches, see rules.h; valid while mapped
+    uint32_t id; // Stable handle for IPC clients
+    struct swwm_output *output; // Output the toplevel was last arranged on
+    struct wl_list commit_timers; // swwm_commit_timer::link
+};
+
+// wp_commit_timer_v1 objects need to know which output's refresh cycle their
+// target times are measured against; we track them per toplevel.
+struct swwm_commit_timer {
+	struct wl_list link; // swwm_toplevel::commit_timers
+	struct wlr_commit_timer_v1 *timer;
+	struct wl_listener destroy;
+};
+
+struct swwm_popup {
+    // Unchanged from original swwm
+	struct wlr_xdg_popup *xdg_popup;
+    struct wlr_scene_tree *scene_tree; // For rendering popups
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+struct swwm_keyboard {
+	struct wl_list link;
+	struct swwm_server *server;
+	struct wlr_keyboard *wlr_keyboard;
+
+	struct wl_listener modifiers;
+	struct wl_listener key;
+	struct wl_listener destroy;
+};
+
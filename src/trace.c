@@ -0,0 +1,98 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+
+#include "trace.h"
+
+struct trace_event {
+	const char *name; // String literal from TRACE_SCOPE
+	uint64_t start_ns;
+	uint64_t dur_ns;
+};
+
+bool trace_enabled;
+
+static struct trace_event *ring; // TRACE_RING_SIZE entries once allocated
+static uint64_t ring_total; // Events recorded since trace_start
+
+void trace_record(const char *name, uint64_t start_ns)
+{
+	if (!ring) {
+		return;
+	}
+	struct trace_event *e = &ring[ring_total++ & (TRACE_RING_SIZE - 1)];
+	e->name = name;
+	e->start_ns = start_ns;
+	e->dur_ns = frame_stats_now_ns() - start_ns;
+}
+
+bool trace_start(void)
+{
+	if (!ring) {
+		ring = calloc(TRACE_RING_SIZE, sizeof(*ring));
+		if (!ring) {
+			wlr_log(WLR_ERROR, "trace: cannot allocate the ring buffer");
+			return false;
+		}
+	}
+	ring_total = 0;
+	trace_enabled = true;
+	return true;
+}
+
+void trace_stop(void)
+{
+	trace_enabled = false;
+}
+
+const char *trace_default_path(void)
+{
+	static char path[4096];
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	snprintf(path, sizeof(path), "%s/swwm-trace.%ld.json", dir ? dir : "/tmp", (long)getpid());
+	return path;
+}
+
+bool trace_dump(const char *path)
+{
+	if (!path) {
+		path = trace_default_path();
+	}
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		wlr_log_errno(WLR_ERROR, "trace: cannot write %s", path);
+		return false;
+	}
+	// "X" (complete) events in microseconds; the viewer nests them by time
+	long pid = (long)getpid();
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"swwm\"}}",
+		pid, pid);
+	uint64_t n = ring_total < TRACE_RING_SIZE ? ring_total : TRACE_RING_SIZE;
+	for (uint64_t i = ring_total - n; ring && i < ring_total; i++) {
+		const struct trace_event *e = &ring[i & (TRACE_RING_SIZE - 1)];
+		fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+			e->name, pid, pid, (unsigned long long)(e->start_ns / 1000), (unsigned)(e->start_ns % 1000),
+			(unsigned long long)(e->dur_ns / 1000), (unsigned)(e->dur_ns % 1000));
+	}
+	fprintf(f, "\n]}\n");
+	bool ok = !ferror(f);
+	ok &= fclose(f) == 0;
+	if (!ok) {
+		wlr_log(WLR_ERROR, "trace: error writing %s", path);
+		return false;
+	}
+	wlr_log(WLR_INFO, "Trace: %llu events written to %s (%llu recorded)", (unsigned long long)n, path,
+		(unsigned long long)ring_total);
+	return true;
+}
+
+void trace_finish(void)
+{
+	trace_enabled = false;
+	free(ring);
+	ring = NULL;
+	ring_total = 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frame_stats.h"
+
+// Handler tracing (trace.c). TRACE_SCOPE at the top of a handler records
+// its name, start and duration into a per-process ring buffer when the
+// scope exits, early returns included. Tracing is off until trace_start,
+// and while off a scope costs two predicted-not-taken branches: a test of
+// trace_enabled on entry and of the saved start time on exit. Toggle with
+// kill -USR2 (stopping writes the dump) or the IPC "trace" command; the
+// dump is Chrome trace-event JSON, for chrome://tracing or ui.perfetto.dev.
+//
+// Event loop thread only: the ring is not locked.
+
+#define TRACE_RING_SIZE (1 << 16) // Events kept, the oldest are overwritten
+
+extern bool trace_enabled;
+
+struct trace_scope {
+	const char *name;
+	uint64_t start_ns; // 0 if tracing was off on entry
+};
+
+void trace_record(const char *name, uint64_t start_ns);
+
+static inline void trace_scope_end(struct trace_scope *scope)
+{
+	if (__builtin_expect(scope->start_ns != 0, 0)) {
+		trace_record(scope->name, scope->start_ns);
+	}
+}
+
+#define TRACE_SCOPE(name) \
+	struct trace_scope trace_scope_ __attribute__((cleanup(trace_scope_end))) = \
+		{ (name), __builtin_expect(trace_enabled, 0) ? frame_stats_now_ns() : 0 }
+
+// Clears the ring and starts recording; false if it could not be allocated
+bool trace_start(void);
+void trace_stop(void);
+// Writes what the ring holds; recording may continue. NULL path means
+// trace_default_path().
+bool trace_dump(const char *path);
+// $XDG_RUNTIME_DIR/swwm-trace.<pid>.json, /tmp without XDG_RUNTIME_DIR
+const char *trace_default_path(void);
+void trace_finish(void); // Frees the ring
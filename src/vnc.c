@@ -0,0 +1,1005 @@
+#define _POSIX_C_SOURCE 200809L
+#include <arpa/inet.h>
+#include <drm_fourcc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input-event-codes.h>
+#include <netinet/in.h>
+#include <pixman.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/log.h>
+#include <xkbcommon/xkbcommon.h>
+#include <xkbcommon/xkbcommon-keysyms.h>
+
+#include "frame_stats.h"
+#include "swwm.h"
+
+/*
+ * Built-in VNC server (swwm -V, or swwm_vnc_start from libswwm).
+ *
+ * A headless output is served over RFB 3.8 (3.3 and 3.7 clients work too)
+ * with no authentication, on a Unix socket or a loopback TCP port. Only Raw
+ * encoding is used, but only for damaged regions:
+ *
+ * - Event loop: on every commit of the VNC output, the damaged rects of the
+ *   committed buffer (the scene output's per-frame damage) are read back
+ *   into a shadow framebuffer and the damage is handed to the worker.
+ * - Worker thread: owns the sockets. It accumulates damage per client and
+ *   answers FramebufferUpdateRequests with just those rects. Key and pointer
+ *   messages are queued for the event loop, which feeds them through
+ *   swwm_inject_*, i.e. the same handlers as real devices.
+ *
+ * The shadow framebuffer, the pending damage and the input queue are the only
+ * shared state, all under vnc->lock. The lock is only held to memcpy damaged
+ * rows: readback goes into a buffer of the event loop's own first, and the
+ * worker encodes from its own copy. The two sides wake each other with
+ * eventfds, so neither blocks on the other's I/O.
+ */
+
+#define VNC_MAX_CLIENTS 8
+#define VNC_IN_BUF 4096      // Longest message we buffer (ClientCutText is skipped)
+#define VNC_SEND_TIMEOUT_MS 5000 // Drop clients that stop reading
+#define VNC_MAX_PRESSED 32
+
+struct vnc_pixel_format {
+	uint8_t bpp; // 8, 16 or 32
+	bool big_endian;
+	uint16_t red_max, green_max, blue_max;
+	uint8_t red_shift, green_shift, blue_shift;
+};
+
+// What we announce in ServerInit: XRGB8888 as stored in the shadow buffer
+static const struct vnc_pixel_format vnc_native_format = {
+	.bpp = 32,
+	.big_endian = false,
+	.red_max = 255, .green_max = 255, .blue_max = 255,
+	.red_shift = 16, .green_shift = 8, .blue_shift = 0,
+};
+
+enum vnc_client_state {
+	VNC_CLIENT_VERSION,  // Waiting for the ProtocolVersion reply
+	VNC_CLIENT_SECURITY, // Waiting for the chosen security type (3.7+)
+	VNC_CLIENT_INIT,     // Waiting for ClientInit
+	VNC_CLIENT_NORMAL,
+};
+
+struct vnc_client {
+	int fd; // -1 if the slot is free
+	enum vnc_client_state state;
+	int minor; // Negotiated RFB 3.x version: 3, 7 or 8
+	uint8_t in[VNC_IN_BUF];
+	size_t in_len;
+	uint32_t skip; // Bytes of ClientCutText still to discard
+	struct vnc_pixel_format format;
+	bool update_requested;
+	pixman_region32_t damage; // Damage not sent to this client yet
+};
+
+enum vnc_input_type {
+	VNC_INPUT_KEY,     // keysym, down
+	VNC_INPUT_POINTER, // x, y, buttons
+};
+
+struct vnc_input {
+	enum vnc_input_type type;
+	bool down;
+	uint8_t buttons;
+	uint16_t x, y;
+	uint32_t keysym;
+};
+
+struct swwm_vnc {
+	struct swwm_server *server;
+	struct wlr_output *output; // NULL once the output is gone
+	struct wl_listener output_commit;
+	struct wl_listener output_destroy;
+	struct wl_event_source *input_source;
+	int input_fd;  // eventfd, worker -> event loop: input queued
+	int wake_fd;   // eventfd, event loop -> worker: damage or stop
+	int listen_fd;
+	char *socket_path; // Unlinked on stop, NULL for TCP
+	pthread_t thread;
+	int width, height;
+
+	pthread_mutex_t lock; // Guards the fields up to `stop`
+	uint32_t *fb; // XRGB8888 shadow of the output, width * height
+	pixman_region32_t damage; // Damaged since the worker last looked
+	struct vnc_input *events;
+	size_t nevents, events_cap;
+	bool stop;
+
+	// Worker thread only
+	struct vnc_client clients[VNC_MAX_CLIENTS];
+	uint8_t *out;
+	size_t out_cap;
+	uint32_t *snap; // Damaged rects of fb, copied out to encode unlocked
+
+	// Event loop only
+	uint32_t *readback; // wlr_texture_read_pixels target, copied into fb
+
+	// Keysyms arrive from the client, swwm wants keycodes
+	struct xkb_context *xkb_context;
+	struct xkb_keymap *keymap;
+	struct { uint32_t keysym, keycode; } pressed[VNC_MAX_PRESSED];
+	int npressed;
+	int shift_down; // Shift keysyms the client holds
+	uint8_t buttons; // Last button mask
+};
+
+static void put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v & 0xff;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Copy the rects' rows between two width-wide XRGB8888 buffers
+static void copy_rects(uint32_t *dst, const uint32_t *src, int width,
+		const pixman_box32_t *rects, int nrects)
+{
+	for (int i = 0; i < nrects; i++) {
+		const pixman_box32_t *r = &rects[i];
+		for (int y = r->y1; y < r->y2; y++) {
+			size_t off = (size_t)y * (size_t)width + (size_t)r->x1;
+			memcpy(dst + off, src + off, (size_t)(r->x2 - r->x1) * 4);
+		}
+	}
+}
+
+static uint32_t msec_now(void)
+{
+	return (uint32_t)(frame_stats_now_ns() / 1000000ull);
+}
+
+// --- Worker thread: sockets and encoding ---
+
+static bool send_all(int fd, const uint8_t *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+		if (n > 0) {
+			data += n;
+			len -= (size_t)n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+			if (poll(&pfd, 1, VNC_SEND_TIMEOUT_MS) > 0) {
+				continue;
+			}
+		}
+		return false;
+	}
+	return true;
+}
+
+static void client_close(struct vnc_client *client)
+{
+	close(client->fd);
+	client->fd = -1;
+	pixman_region32_fini(&client->damage);
+}
+
+static uint8_t *out_reserve(struct swwm_vnc *vnc, size_t len)
+{
+	if (len > vnc->out_cap) {
+		uint8_t *out = realloc(vnc->out, len);
+		if (!out) {
+			return NULL;
+		}
+		vnc->out = out;
+		vnc->out_cap = len;
+	}
+	return vnc->out;
+}
+
+static void write_pixel(uint8_t *dst, uint32_t xrgb, const struct vnc_pixel_format *f)
+{
+	uint32_t r = (xrgb >> 16) & 0xff, g = (xrgb >> 8) & 0xff, b = xrgb & 0xff;
+	uint32_t v = (r * f->red_max / 255) << f->red_shift |
+		(g * f->green_max / 255) << f->green_shift |
+		(b * f->blue_max / 255) << f->blue_shift;
+	int bytes = f->bpp / 8;
+	for (int i = 0; i < bytes; i++) {
+		int shift = f->big_endian ? (bytes - 1 - i) * 8 : i * 8;
+		dst[i] = (v >> shift) & 0xff;
+	}
+}
+
+static bool format_is_native(const struct vnc_pixel_format *f)
+{
+	static const uint32_t probe = 1;
+	bool host_le = *(const uint8_t *)&probe == 1;
+	const struct vnc_pixel_format *n = &vnc_native_format;
+	return host_le && f->bpp == n->bpp && f->big_endian == n->big_endian &&
+		f->red_max == n->red_max && f->green_max == n->green_max && f->blue_max == n->blue_max &&
+		f->red_shift == n->red_shift && f->green_shift == n->green_shift && f->blue_shift == n->blue_shift;
+}
+
+// Send the client's accumulated damage as one FramebufferUpdate of Raw rects
+static bool client_send_update(struct swwm_vnc *vnc, struct vnc_client *client)
+{
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(&client->damage, &nrects);
+	if (nrects > 0xffff) {
+		// The count is 16 bits; degrade to the bounding box
+		pixman_box32_t extents = *pixman_region32_extents(&client->damage);
+		pixman_region32_fini(&client->damage);
+		pixman_region32_init_rect(&client->damage, extents.x1, extents.y1,
+			(unsigned)(extents.x2 - extents.x1), (unsigned)(extents.y2 - extents.y1));
+		rects = pixman_region32_rectangles(&client->damage, &nrects);
+	}
+
+	size_t bytes = (size_t)client->format.bpp / 8;
+	size_t len = 4;
+	for (int i = 0; i < nrects; i++) {
+		len += 12 + (size_t)(rects[i].x2 - rects[i].x1) * (size_t)(rects[i].y2 - rects[i].y1) * bytes;
+	}
+	uint8_t *out = out_reserve(vnc, len);
+	if (!out) {
+		return false;
+	}
+
+	out[0] = 0; // FramebufferUpdate
+	out[1] = 0;
+	put16(out + 2, (uint16_t)nrects);
+	uint8_t *p = out + 4;
+	bool native = format_is_native(&client->format);
+
+	// Take the rects and let the event loop go on while we convert
+	pthread_mutex_lock(&vnc->lock);
+	copy_rects(vnc->snap, vnc->fb, vnc->width, rects, nrects);
+	pthread_mutex_unlock(&vnc->lock);
+
+	for (int i = 0; i < nrects; i++) {
+		const pixman_box32_t *r = &rects[i];
+		int w = r->x2 - r->x1, h = r->y2 - r->y1;
+		put16(p, (uint16_t)r->x1);
+		put16(p + 2, (uint16_t)r->y1);
+		put16(p + 4, (uint16_t)w);
+		put16(p + 6, (uint16_t)h);
+		put32(p + 8, 0); // Raw
+		p += 12;
+		for (int y = r->y1; y < r->y2; y++) {
+			const uint32_t *row = vnc->snap + (size_t)y * vnc->width + r->x1;
+			if (native) {
+				memcpy(p, row, (size_t)w * 4);
+				p += (size_t)w * 4;
+				continue;
+			}
+			for (int x = 0; x < w; x++) {
+				write_pixel(p, row[x], &client->format);
+				p += bytes;
+			}
+		}
+	}
+
+	pixman_region32_clear(&client->damage);
+	client->update_requested = false;
+	return send_all(client->fd, out, len);
+}
+
+static bool parse_pixel_format(struct vnc_client *client, const uint8_t *p)
+{
+	struct vnc_pixel_format f = {
+		.bpp = p[0],
+		.big_endian = p[2] != 0,
+		.red_max = get16(p + 4),
+		.green_max = get16(p + 6),
+		.blue_max = get16(p + 8),
+		.red_shift = p[10],
+		.green_shift = p[11],
+		.blue_shift = p[12],
+	};
+	bool true_colour = p[3] != 0;
+	if (!true_colour || (f.bpp != 8 && f.bpp != 16 && f.bpp != 32)) {
+		wlr_log(WLR_ERROR, "vnc: unsupported pixel format (%u bpp, true colour %d)", f.bpp, true_colour);
+		return false;
+	}
+	client->format = f;
+	return true;
+}
+
+static void queue_input(struct swwm_vnc *vnc, const struct vnc_input *event)
+{
+	pthread_mutex_lock(&vnc->lock);
+	if (vnc->nevents == vnc->events_cap) {
+		size_t cap = vnc->events_cap ? vnc->events_cap * 2 : 64;
+		struct vnc_input *events = realloc(vnc->events, cap * sizeof(*events));
+		if (!events) {
+			pthread_mutex_unlock(&vnc->lock);
+			return;
+		}
+		vnc->events = events;
+		vnc->events_cap = cap;
+	}
+	vnc->events[vnc->nevents++] = *event;
+	pthread_mutex_unlock(&vnc->lock);
+	eventfd_write(vnc->input_fd, 1);
+}
+
+// Consume one message from client->in. Returns its length, 0 if incomplete,
+// -1 to drop the client.
+static ssize_t client_handle_message(struct swwm_vnc *vnc, struct vnc_client *client)
+{
+	const uint8_t *p = client->in;
+	size_t len = client->in_len;
+
+	switch (client->state) {
+	case VNC_CLIENT_VERSION: {
+		if (len < 12) {
+			return 0;
+		}
+		int major, minor;
+		if (memcmp(p, "RFB ", 4) != 0 || sscanf((const char *)p + 4, "%3d.%3d", &major, &minor) != 2) {
+			return -1;
+		}
+		// Anything newer than 3.8 gets 3.8, unknown 3.x minors get 3.3
+		client->minor = major > 3 || minor >= 8 ? 8 : minor == 7 ? 7 : 3;
+		if (client->minor == 3) {
+			// 3.3: the server picks the security type, None
+			uint8_t sec[4];
+			put32(sec, 1);
+			client->state = VNC_CLIENT_INIT;
+			return send_all(client->fd, sec, sizeof(sec)) ? 12 : -1;
+		}
+		static const uint8_t types[] = { 1, 1 }; // One type: None
+		client->state = VNC_CLIENT_SECURITY;
+		return send_all(client->fd, types, sizeof(types)) ? 12 : -1;
+	}
+	case VNC_CLIENT_SECURITY: {
+		if (len < 1) {
+			return 0;
+		}
+		if (p[0] != 1) {
+			return -1;
+		}
+		client->state = VNC_CLIENT_INIT;
+		if (client->minor == 7) {
+			return 1; // 3.7 has no SecurityResult after None
+		}
+		uint8_t result[4];
+		put32(result, 0); // OK
+		return send_all(client->fd, result, sizeof(result)) ? 1 : -1;
+	}
+	case VNC_CLIENT_INIT: {
+		if (len < 1) {
+			return 0;
+		}
+		static const char name[] = "swwm";
+		uint8_t init[24 + sizeof(name) - 1] = {0};
+		const struct vnc_pixel_format *f = &vnc_native_format;
+		put16(init, (uint16_t)vnc->width);
+		put16(init + 2, (uint16_t)vnc->height);
+		init[4] = f->bpp;
+		init[5] = 24; // depth
+		init[6] = f->big_endian;
+		init[7] = 1; // true colour
+		put16(init + 8, f->red_max);
+		put16(init + 10, f->green_max);
+		put16(init + 12, f->blue_max);
+		init[14] = f->red_shift;
+		init[15] = f->green_shift;
+		init[16] = f->blue_shift;
+		put32(init + 20, sizeof(name) - 1);
+		memcpy(init + 24, name, sizeof(name) - 1);
+		client->state = VNC_CLIENT_NORMAL;
+		client->format = vnc_native_format;
+		pixman_region32_union_rect(&client->damage, &client->damage,
+			0, 0, (unsigned)vnc->width, (unsigned)vnc->height); // First update is the full frame
+		return send_all(client->fd, init, sizeof(init)) ? 1 : -1;
+	}
+	case VNC_CLIENT_NORMAL:
+		break;
+	}
+
+	if (len < 1) {
+		return 0;
+	}
+	switch (p[0]) {
+	case 0: // SetPixelFormat
+		if (len < 20) {
+			return 0;
+		}
+		return parse_pixel_format(client, p + 4) ? 20 : -1;
+	case 2: { // SetEncodings: Raw is always allowed, nothing to negotiate
+		if (len < 4) {
+			return 0;
+		}
+		size_t need = 4 + (size_t)get16(p + 2) * 4;
+		if (need > sizeof(client->in)) {
+			return -1;
+		}
+		return len < need ? 0 : (ssize_t)need;
+	}
+	case 3: { // FramebufferUpdateRequest
+		if (len < 10) {
+			return 0;
+		}
+		if (!p[1]) {
+			// Non-incremental: the client wants this area whatever changed
+			pixman_region32_union_rect(&client->damage, &client->damage,
+				get16(p + 2), get16(p + 4), get16(p + 6), get16(p + 8));
+			pixman_region32_intersect_rect(&client->damage, &client->damage,
+				0, 0, (unsigned)vnc->width, (unsigned)vnc->height);
+		}
+		client->update_requested = true;
+		return 10;
+	}
+	case 4: { // KeyEvent
+		if (len < 8) {
+			return 0;
+		}
+		struct vnc_input event = {
+			.type = VNC_INPUT_KEY,
+			.down = p[1] != 0,
+			.keysym = get32(p + 4),
+		};
+		queue_input(vnc, &event);
+		return 8;
+	}
+	case 5: { // PointerEvent
+		if (len < 6) {
+			return 0;
+		}
+		struct vnc_input event = {
+			.type = VNC_INPUT_POINTER,
+			.buttons = p[1],
+			.x = get16(p + 2),
+			.y = get16(p + 4),
+		};
+		queue_input(vnc, &event);
+		return 6;
+	}
+	case 6: // ClientCutText: the text itself is skipped as it streams in
+		if (len < 8) {
+			return 0;
+		}
+		client->skip = get32(p + 4);
+		return 8;
+	default:
+		wlr_log(WLR_ERROR, "vnc: unknown client message %u", p[0]);
+		return -1;
+	}
+}
+
+static bool client_read(struct swwm_vnc *vnc, struct vnc_client *client)
+{
+	ssize_t n = recv(client->fd, client->in + client->in_len, sizeof(client->in) - client->in_len, 0);
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+		return false;
+	}
+	if (n < 0) {
+		return true;
+	}
+	client->in_len += (size_t)n;
+
+	size_t off = 0;
+	for (;;) {
+		if (client->skip) {
+			size_t k = client->in_len - off < client->skip ? client->in_len - off : client->skip;
+			client->skip -= (uint32_t)k;
+			off += k;
+			if (client->skip) {
+				break;
+			}
+		}
+		// Parse from the start of the buffer
+		memmove(client->in, client->in + off, client->in_len - off);
+		client->in_len -= off;
+		off = 0;
+		ssize_t used = client_handle_message(vnc, client);
+		if (used < 0) {
+			return false;
+		}
+		if (used == 0) {
+			break;
+		}
+		off = (size_t)used;
+	}
+	memmove(client->in, client->in + off, client->in_len - off);
+	client->in_len -= off;
+	return true;
+}
+
+static void accept_client(struct swwm_vnc *vnc)
+{
+	int fd = accept(vnc->listen_fd, NULL, NULL);
+	if (fd < 0) {
+		return;
+	}
+	struct vnc_client *client = NULL;
+	for (int i = 0; i < VNC_MAX_CLIENTS; i++) {
+		if (vnc->clients[i].fd < 0) {
+			client = &vnc->clients[i];
+			break;
+		}
+	}
+	static const char version[] = "RFB 003.008\n";
+	if (!client) {
+		wlr_log(WLR_ERROR, "vnc: too many clients");
+		close(fd);
+		return;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	*client = (struct vnc_client){ .fd = fd, .state = VNC_CLIENT_VERSION };
+	pixman_region32_init(&client->damage);
+	if (!send_all(fd, (const uint8_t *)version, sizeof(version) - 1)) {
+		client_close(client);
+	}
+}
+
+static void *vnc_worker(void *data)
+{
+	struct swwm_vnc *vnc = data;
+	struct pollfd pfds[2 + VNC_MAX_CLIENTS];
+
+	for (;;) {
+		pfds[0] = (struct pollfd){ .fd = vnc->wake_fd, .events = POLLIN };
+		pfds[1] = (struct pollfd){ .fd = vnc->listen_fd, .events = POLLIN };
+		for (int i = 0; i < VNC_MAX_CLIENTS; i++) {
+			pfds[2 + i] = (struct pollfd){ .fd = vnc->clients[i].fd, .events = POLLIN };
+		}
+		if (poll(pfds, LENGTH(pfds), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			wlr_log_errno(WLR_ERROR, "vnc: poll");
+			break;
+		}
+
+		if (pfds[0].revents & POLLIN) {
+			eventfd_t count;
+			eventfd_read(vnc->wake_fd, &count);
+			pthread_mutex_lock(&vnc->lock);
+			bool stop = vnc->stop;
+			for (int i = 0; i < VNC_MAX_CLIENTS; i++) {
+				struct vnc_client *client = &vnc->clients[i];
+				if (client->fd >= 0 && client->state == VNC_CLIENT_NORMAL) {
+					pixman_region32_union(&client->damage, &client->damage, &vnc->damage);
+				}
+			}
+			pixman_region32_clear(&vnc->damage);
+			pthread_mutex_unlock(&vnc->lock);
+			if (stop) {
+				break;
+			}
+		}
+		if (pfds[1].revents & POLLIN) {
+			accept_client(vnc);
+		}
+		for (int i = 0; i < VNC_MAX_CLIENTS; i++) {
+			struct vnc_client *client = &vnc->clients[i];
+			if (client->fd < 0 || pfds[2 + i].fd != client->fd) {
+				continue; // Accepted in this iteration
+			}
+			if ((pfds[2 + i].revents & (POLLIN | POLLHUP | POLLERR)) && !client_read(vnc, client)) {
+				client_close(client);
+				continue;
+			}
+			if (client->state == VNC_CLIENT_NORMAL && client->update_requested &&
+					pixman_region32_not_empty(&client->damage) && !client_send_update(vnc, client)) {
+				client_close(client);
+			}
+		}
+	}
+
+	for (int i = 0; i < VNC_MAX_CLIENTS; i++) {
+		if (vnc->clients[i].fd >= 0) {
+			client_close(&vnc->clients[i]);
+		}
+	}
+	return NULL;
+}
+
+// --- Event loop: framebuffer readback and input ---
+
+static void vnc_output_commit(struct wl_listener *listener, void *data)
+{
+	struct swwm_vnc *vnc = wl_container_of(listener, vnc, output_commit);
+	const struct wlr_output_event_commit *event = data;
+	const struct wlr_output_state *state = event->state;
+	if (!(state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+
+	// The scene only sets damage for what changed this frame; without it
+	// the whole buffer is new
+	pixman_region32_t damage;
+	pixman_region32_init_rect(&damage, 0, 0, (unsigned)vnc->width, (unsigned)vnc->height);
+	if (state->committed & WLR_OUTPUT_STATE_DAMAGE) {
+		pixman_region32_intersect(&damage, &damage, &state->damage);
+	}
+	pixman_region32_intersect_rect(&damage, &damage, 0, 0,
+		(unsigned)state->buffer->width, (unsigned)state->buffer->height);
+	if (!pixman_region32_not_empty(&damage)) {
+		pixman_region32_fini(&damage);
+		return;
+	}
+
+	struct wlr_texture *texture = wlr_texture_from_buffer(vnc->server->renderer, state->buffer);
+	if (!texture) {
+		pixman_region32_fini(&damage);
+		return;
+	}
+	// Read back without the lock, then publish the damaged rows
+	int nrects;
+	const pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
+	for (int i = 0; i < nrects; i++) {
+		struct wlr_texture_read_pixels_options options = {
+			.data = vnc->readback,
+			.format = DRM_FORMAT_XRGB8888,
+			.stride = (uint32_t)vnc->width * 4,
+			.dst_x = (uint32_t)rects[i].x1,
+			.dst_y = (uint32_t)rects[i].y1,
+			.src_box = {
+				.x = rects[i].x1,
+				.y = rects[i].y1,
+				.width = rects[i].x2 - rects[i].x1,
+				.height = rects[i].y2 - rects[i].y1,
+			},
+		};
+		if (!wlr_texture_read_pixels(texture, &options)) {
+			wlr_log(WLR_ERROR, "vnc: failed to read back output pixels");
+			break;
+		}
+	}
+	wlr_texture_destroy(texture);
+	pthread_mutex_lock(&vnc->lock);
+	copy_rects(vnc->fb, vnc->readback, vnc->width, rects, nrects);
+	pixman_region32_union(&vnc->damage, &vnc->damage, &damage);
+	pthread_mutex_unlock(&vnc->lock);
+	pixman_region32_fini(&damage);
+
+	eventfd_write(vnc->wake_fd, 1);
+}
+
+static void vnc_output_destroy(struct wl_listener *listener, void *data)
+{
+	struct swwm_vnc *vnc = wl_container_of(listener, vnc, output_destroy);
+	wl_list_remove(&vnc->output_commit.link);
+	wl_list_remove(&vnc->output_destroy.link);
+	vnc->output = NULL;
+}
+
+// Find the key producing keysym in the first layout, preferring unshifted
+static bool keysym_to_keycode(struct xkb_keymap *keymap, uint32_t keysym, uint32_t *keycode, bool *shifted)
+{
+	xkb_keycode_t min = xkb_keymap_min_keycode(keymap), max = xkb_keymap_max_keycode(keymap);
+	for (xkb_level_index_t level = 0; level < 2; level++) {
+		for (xkb_keycode_t kc = min; kc <= max; kc++) {
+			const xkb_keysym_t *syms;
+			int n = xkb_keymap_key_get_syms_by_level(keymap, kc, 0, level, &syms);
+			if (n == 1 && syms[0] == keysym) {
+				*keycode = kc - 8; // xkb to evdev
+				*shifted = level == 1;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void vnc_handle_key(struct swwm_vnc *vnc, uint32_t keysym, bool down)
+{
+	struct swwm_server *server = vnc->server;
+	uint32_t now = msec_now();
+	bool is_shift = keysym == XKB_KEY_Shift_L || keysym == XKB_KEY_Shift_R;
+
+	if (!down) {
+		// Release what we pressed for this keysym; modifiers may have changed since
+		for (int i = 0; i < vnc->npressed; i++) {
+			if (vnc->pressed[i].keysym == keysym) {
+				swwm_inject_key(server, now, vnc->pressed[i].keycode, false);
+				vnc->pressed[i] = vnc->pressed[--vnc->npressed];
+				if (is_shift && vnc->shift_down > 0) {
+					vnc->shift_down--;
+				}
+				return;
+			}
+		}
+		return;
+	}
+
+	uint32_t keycode;
+	bool shifted;
+	if (!keysym_to_keycode(vnc->keymap, keysym, &keycode, &shifted)) {
+		wlr_log(WLR_DEBUG, "vnc: no key for keysym 0x%x", keysym);
+		return;
+	}
+	if (vnc->npressed == VNC_MAX_PRESSED) {
+		return;
+	}
+	vnc->pressed[vnc->npressed].keysym = keysym;
+	vnc->pressed[vnc->npressed].keycode = keycode;
+	vnc->npressed++;
+	if (is_shift) {
+		vnc->shift_down++;
+	}
+
+	// Clients send the shifted keysym; hold shift for it if they don't already
+	bool add_shift = shifted && vnc->shift_down == 0;
+	if (add_shift) {
+		swwm_inject_key(server, now, KEY_LEFTSHIFT, true);
+	}
+	swwm_inject_key(server, now, keycode, true);
+	if (add_shift) {
+		swwm_inject_key(server, now, KEY_LEFTSHIFT, false);
+	}
+}
+
+static void vnc_handle_pointer(struct swwm_vnc *vnc, uint8_t buttons, uint16_t x, uint16_t y)
+{
+	struct swwm_server *server = vnc->server;
+	if (!vnc->output) {
+		return;
+	}
+	uint32_t now = msec_now();
+
+	// RFB coordinates are output pixels, injection wants 0..1 over the layout
+	struct wlr_box layout_box, output_box;
+	wlr_output_layout_get_box(server->output_layout, NULL, &layout_box);
+	wlr_output_layout_get_box(server->output_layout, vnc->output, &output_box);
+	if (wlr_box_empty(&layout_box) || wlr_box_empty(&output_box)) {
+		return;
+	}
+	double lx = output_box.x + (x + 0.5) * output_box.width / vnc->width;
+	double ly = output_box.y + (y + 0.5) * output_box.height / vnc->height;
+	swwm_inject_motion_absolute(server, now,
+		(lx - layout_box.x) / layout_box.width, (ly - layout_box.y) / layout_box.height);
+
+	static const uint32_t button_codes[3] = { BTN_LEFT, BTN_MIDDLE, BTN_RIGHT };
+	uint8_t changed = buttons ^ vnc->buttons;
+	for (int i = 0; i < 3; i++) {
+		if (changed & (1u << i)) {
+			swwm_inject_button(server, now, button_codes[i], buttons & (1u << i));
+		}
+	}
+	// Bits 3-6 are wheel up/down/left/right, sent as press + release
+	uint8_t wheel = changed & buttons;
+	if (wheel & (1u << 3)) swwm_inject_axis(server, now, false, -15, -1);
+	if (wheel & (1u << 4)) swwm_inject_axis(server, now, false, 15, 1);
+	if (wheel & (1u << 5)) swwm_inject_axis(server, now, true, -15, -1);
+	if (wheel & (1u << 6)) swwm_inject_axis(server, now, true, 15, 1);
+	vnc->buttons = buttons;
+	swwm_inject_frame(server);
+}
+
+static int vnc_handle_input(int fd, uint32_t mask, void *data)
+{
+	struct swwm_vnc *vnc = data;
+	eventfd_t count;
+	eventfd_read(fd, &count);
+
+	pthread_mutex_lock(&vnc->lock);
+	struct vnc_input *events = vnc->events;
+	size_t nevents = vnc->nevents;
+	vnc->events = NULL;
+	vnc->nevents = vnc->events_cap = 0;
+	pthread_mutex_unlock(&vnc->lock);
+
+	for (size_t i = 0; i < nevents; i++) {
+		const struct vnc_input *event = &events[i];
+		switch (event->type) {
+		case VNC_INPUT_KEY:
+			vnc_handle_key(vnc, event->keysym, event->down);
+			break;
+		case VNC_INPUT_POINTER:
+			vnc_handle_pointer(vnc, event->buttons, event->x, event->y);
+			break;
+		}
+	}
+	free(events);
+	return 0;
+}
+
+// `listen_on` is a TCP port (bound to loopback) if it is all digits,
+// otherwise a Unix socket path
+static int vnc_listen(struct swwm_vnc *vnc, const char *listen_on)
+{
+	bool tcp = listen_on[0] && strspn(listen_on, "0123456789") == strlen(listen_on);
+	int fd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "vnc: socket");
+		return -1;
+	}
+
+	int ret;
+	if (tcp) {
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		struct sockaddr_in addr = {
+			.sin_family = AF_INET,
+			.sin_port = htons((uint16_t)atoi(listen_on)),
+			.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+		};
+		ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	} else {
+		struct sockaddr_un addr = { .sun_family = AF_UNIX };
+		if (strlen(listen_on) >= sizeof(addr.sun_path)) {
+			wlr_log(WLR_ERROR, "vnc: socket path too long: %s", listen_on);
+			close(fd);
+			return -1;
+		}
+		strcpy(addr.sun_path, listen_on);
+		unlink(listen_on); // Stale socket from a previous run
+		ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+		if (ret == 0) {
+			vnc->socket_path = strdup(listen_on);
+		}
+	}
+	if (ret < 0 || listen(fd, VNC_MAX_CLIENTS) < 0) {
+		wlr_log_errno(WLR_ERROR, "vnc: cannot listen on %s", listen_on);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool swwm_vnc_start(struct swwm_server *server, const char *listen_on, int width, int height)
+{
+	if (server->vnc) {
+		return false;
+	}
+	if (!wlr_backend_is_headless(server->backend)) {
+		wlr_log(WLR_ERROR, "vnc: needs the headless backend");
+		return false;
+	}
+	if (width <= 0 || height <= 0 || width > 0xffff || height > 0xffff) {
+		wlr_log(WLR_ERROR, "vnc: bad output size %dx%d", width, height);
+		return false;
+	}
+
+	struct swwm_vnc *vnc = calloc(1, sizeof(*vnc));
+	if (!vnc) {
+		return false;
+	}
+	vnc->server = server;
+	vnc->width = width;
+	vnc->height = height;
+	vnc->input_fd = vnc->wake_fd = vnc->listen_fd = -1;
+	for (int i = 0; i < VNC_MAX_CLIENTS; i++) {
+		vnc->clients[i].fd = -1;
+	}
+	pthread_mutex_init(&vnc->lock, NULL);
+	pixman_region32_init(&vnc->damage);
+
+	// Same default keymap the virtual keyboard gets in server_new_input
+	struct xkb_rule_names rules = {0};
+	vnc->xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	vnc->keymap = vnc->xkb_context ?
+		xkb_keymap_new_from_names(vnc->xkb_context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS) : NULL;
+	vnc->fb = calloc((size_t)width * height, sizeof(*vnc->fb));
+	vnc->snap = calloc((size_t)width * height, sizeof(*vnc->snap));
+	vnc->readback = calloc((size_t)width * height, sizeof(*vnc->readback));
+	vnc->input_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	vnc->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (!vnc->keymap || !vnc->fb || !vnc->snap || !vnc->readback || vnc->input_fd < 0 || vnc->wake_fd < 0) {
+		wlr_log(WLR_ERROR, "vnc: failed to allocate server state");
+		goto error;
+	}
+	vnc->listen_fd = vnc_listen(vnc, listen_on);
+	if (vnc->listen_fd < 0) {
+		goto error;
+	}
+
+	// server_new_output runs synchronously, so the output is arranged and
+	// committing by the time this returns
+	vnc->output = wlr_headless_add_output(server->backend, (unsigned)width, (unsigned)height);
+	if (!vnc->output) {
+		wlr_log(WLR_ERROR, "vnc: failed to add headless output");
+		goto error;
+	}
+	vnc->output_commit.notify = vnc_output_commit;
+	wl_signal_add(&vnc->output->events.commit, &vnc->output_commit);
+	vnc->output_destroy.notify = vnc_output_destroy;
+	wl_signal_add(&vnc->output->events.destroy, &vnc->output_destroy);
+
+	vnc->input_source = wl_event_loop_add_fd(wl_display_get_event_loop(server->wl_display),
+		vnc->input_fd, WL_EVENT_READABLE, vnc_handle_input, vnc);
+	// Signals belong to the event loop, never to the encoder thread
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&vnc->thread, NULL, vnc_worker, vnc);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		wlr_log(WLR_ERROR, "vnc: failed to start worker thread");
+		wl_event_source_remove(vnc->input_source);
+		wlr_output_destroy(vnc->output);
+		goto error;
+	}
+
+	server->vnc = vnc;
+	wlr_log(WLR_INFO, "Serving %s (%dx%d) over VNC on %s", vnc->output->name, width, height, listen_on);
+	return true;
+
+error:
+	if (vnc->listen_fd >= 0) close(vnc->listen_fd);
+	if (vnc->socket_path) unlink(vnc->socket_path);
+	free(vnc->socket_path);
+	if (vnc->input_fd >= 0) close(vnc->input_fd);
+	if (vnc->wake_fd >= 0) close(vnc->wake_fd);
+	free(vnc->fb);
+	free(vnc->snap);
+	free(vnc->readback);
+	xkb_keymap_unref(vnc->keymap);
+	xkb_context_unref(vnc->xkb_context);
+	pixman_region32_fini(&vnc->damage);
+	pthread_mutex_destroy(&vnc->lock);
+	free(vnc);
+	return false;
+}
+
+void swwm_vnc_stop(struct swwm_server *server)
+{
+	struct swwm_vnc *vnc = server->vnc;
+	if (!vnc) {
+		return;
+	}
+	pthread_mutex_lock(&vnc->lock);
+	vnc->stop = true;
+	pthread_mutex_unlock(&vnc->lock);
+	eventfd_write(vnc->wake_fd, 1);
+	pthread_join(vnc->thread, NULL);
+
+	wl_event_source_remove(vnc->input_source);
+	if (vnc->output) {
+		wl_list_remove(&vnc->output_commit.link);
+		wl_list_remove(&vnc->output_destroy.link);
+	}
+	close(vnc->listen_fd);
+	if (vnc->socket_path) {
+		unlink(vnc->socket_path);
+		free(vnc->socket_path);
+	}
+	close(vnc->input_fd);
+	close(vnc->wake_fd);
+	free(vnc->fb);
+	free(vnc->snap);
+	free(vnc->readback);
+	free(vnc->events);
+	free(vnc->out);
+	xkb_keymap_unref(vnc->keymap);
+	xkb_context_unref(vnc->xkb_context);
+	pixman_region32_fini(&vnc->damage);
+	pthread_mutex_destroy(&vnc->lock);
+	free(vnc);
+	server->vnc = NULL;
+}
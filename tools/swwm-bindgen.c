@@ -0,0 +1,108 @@
+/*
+ * swwm-bindgen: the build-time half of STATIC_CONFIG=1. Reads binds[] from
+ * src/config.h and writes a header with a collision-free slot table over
+ * (mods, keysym), see static_config.h. Fails the build on a duplicate bind.
+ *
+ * Usage: swwm-bindgen out.h
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "defs.h"
+#include "config.h"
+#include "static_config.h"
+
+// config.h points at the compositor's functions; only the keys are read
+// here, so these stand in for them at link time
+#define STUB(fn) void fn(struct swwm_server *server, const void *arg) { (void)server; (void)arg; }
+STUB(quit_swwm)
+STUB(close_focused_swwm)
+STUB(focus_next_swwm)
+STUB(focus_prev_swwm)
+STUB(move_master_next_swwm)
+STUB(move_master_prev_swwm)
+STUB(resize_master_add_swwm)
+STUB(resize_master_sub_swwm)
+STUB(inc_gaps_swwm)
+STUB(dec_gaps_swwm)
+STUB(toggle_floating_swwm)
+STUB(toggle_floating_global_swwm)
+STUB(toggle_fullscreen_swwm)
+STUB(reload_config_swwm)
+
+#define NBINDS LENGTH(binds)
+#define MAX_SLOTS 4096
+
+static uint16_t slot[MAX_SLOTS]; // binds[] index + 1, 0 = empty
+
+static bool try_seed(uint32_t slots, uint32_t seed)
+{
+	memset(slot, 0, sizeof(slot));
+	for (size_t i = 0; i < NBINDS; i++) {
+		uint32_t s = static_binds_hash(binds[i].mods, binds[i].keysym, seed) & (slots - 1);
+		if (slot[s]) {
+			return false;
+		}
+		slot[s] = (uint16_t)(i + 1);
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s out.h\n", argv[0]);
+		return 1;
+	}
+	for (size_t i = 0; i < NBINDS; i++) {
+		for (size_t j = i + 1; j < NBINDS; j++) {
+			if (binds[i].mods == binds[j].mods && binds[i].keysym == binds[j].keysym) {
+				fprintf(stderr, "swwm-bindgen: config.h: binds %zu and %zu use the same keys\n", i, j);
+				return 1;
+			}
+		}
+	}
+
+	// Smallest power of two at least twice the binds that has a seed
+	uint32_t slots = 16, seed = 0;
+	while (slots < 2 * NBINDS) {
+		slots *= 2;
+	}
+	for (; slots <= MAX_SLOTS; slots *= 2) {
+		for (uint32_t s = 1; s < (1u << 16); s++) {
+			if (try_seed(slots, s)) {
+				seed = s;
+				break;
+			}
+		}
+		if (seed) {
+			break;
+		}
+	}
+	if (!seed) {
+		fprintf(stderr, "swwm-bindgen: no perfect hash for %zu binds\n", NBINDS);
+		return 1;
+	}
+
+	FILE *f = fopen(argv[1], "w");
+	if (!f) {
+		perror("swwm-bindgen: opening output");
+		return 1;
+	}
+	fprintf(f, "// Generated by swwm-bindgen from src/config.h, edit that instead\n");
+	fprintf(f, "#pragma once\n#include <stdint.h>\n\n");
+	fprintf(f, "#define STATIC_BINDS_SEED %uu\n", seed);
+	fprintf(f, "#define STATIC_BINDS_SLOTS %u\n\n", slots);
+	fprintf(f, "// binds[] index + 1, 0 = no binding\n");
+	fprintf(f, "static const uint16_t static_binds_slot[STATIC_BINDS_SLOTS] = {");
+	for (uint32_t i = 0; i < slots; i++) {
+		fprintf(f, "%s%u,", i % 16 ? " " : "\n\t", slot[i]);
+	}
+	fprintf(f, "\n};\n");
+	if (fclose(f) != 0) {
+		perror("swwm-bindgen: writing output");
+		return 1;
+	}
+	return 0;
+}
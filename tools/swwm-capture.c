@@ -0,0 +1,509 @@
+/*
+ * swwm-capture: ext-image-copy-capture client that checks frame damage.
+ *
+ * Captures an output (or the toplevel with a given app_id) N times. Every
+ * frame is copied in full into a fresh buffer, so the pixels can be compared
+ * with the previous frame: each pixel that changed must lie inside the damage
+ * the compositor reported for that frame. Run it next to swwm-loadgen on a
+ * headless swwm to check damage tracking against known surface updates.
+ *
+ * Prints per-frame damage with -v, and a summary at the end. Exits 1 if any
+ * changed pixel was not covered by the reported damage.
+ *
+ * Usage: swwm-capture [-o output index] [-a app_id] [-n frames] [-v]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "ext-foreign-toplevel-list-v1-client-protocol.h"
+#include "ext-image-capture-source-v1-client-protocol.h"
+#include "ext-image-copy-capture-v1-client-protocol.h"
+
+#define MAX_OUTPUTS 16
+#define MAX_DAMAGE 64
+
+struct rect {
+	int32_t x, y, w, h;
+};
+
+struct toplevel {
+	struct ext_foreign_toplevel_handle_v1 *handle;
+	char *app_id;
+	struct toplevel *next;
+};
+
+struct capture {
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_shm *shm;
+	struct wl_output *outputs[MAX_OUTPUTS];
+	int noutputs;
+	struct ext_output_image_capture_source_manager_v1 *output_sources;
+	struct ext_foreign_toplevel_image_capture_source_manager_v1 *toplevel_sources;
+	struct ext_foreign_toplevel_list_v1 *toplevel_list;
+	struct ext_image_copy_capture_manager_v1 *copy_manager;
+	struct toplevel *toplevels;
+
+	struct ext_image_capture_source_v1 *source;
+	struct ext_image_copy_capture_session_v1 *session;
+	uint32_t width, height;
+	uint32_t shm_format;
+	bool have_shm_format;
+	bool constraints_done;
+	bool stopped;
+
+	// Current frame
+	struct ext_image_copy_capture_frame_v1 *frame;
+	struct rect damage[MAX_DAMAGE];
+	int ndamage;
+	bool damage_overflow; // More rects than we keep: treat as full damage
+	bool ready, failed;
+
+	uint32_t *prev; // Previous frame's pixels, NULL before the first frame
+	bool verbose;
+
+	// Summary
+	int frames;
+	uint64_t damaged_px, changed_px, uncovered_px;
+};
+
+// --- shm ---
+
+static int create_shm_file(size_t size)
+{
+	static unsigned counter;
+	char name[64];
+	for (int tries = 0; tries < 100; tries++) {
+		snprintf(name, sizeof name, "/swwm-capture-%ld-%u", (long)getpid(), counter++);
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) {
+			shm_unlink(name);
+			if (ftruncate(fd, (off_t)size) < 0) {
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+		if (errno != EEXIST) {
+			break;
+		}
+	}
+	return -1;
+}
+
+// --- frame ---
+
+static void frame_transform(void *data, struct ext_image_copy_capture_frame_v1 *frame, uint32_t transform)
+{
+}
+
+static void frame_damage(void *data, struct ext_image_copy_capture_frame_v1 *frame,
+		int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	struct capture *c = data;
+	if (c->ndamage == MAX_DAMAGE) {
+		c->damage_overflow = true;
+		return;
+	}
+	c->damage[c->ndamage++] = (struct rect){ x, y, w, h };
+}
+
+static void frame_presentation_time(void *data, struct ext_image_copy_capture_frame_v1 *frame,
+		uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec)
+{
+}
+
+static void frame_ready(void *data, struct ext_image_copy_capture_frame_v1 *frame)
+{
+	struct capture *c = data;
+	c->ready = true;
+}
+
+static void frame_failed(void *data, struct ext_image_copy_capture_frame_v1 *frame, uint32_t reason)
+{
+	struct capture *c = data;
+	fprintf(stderr, "swwm-capture: frame failed (reason %u)\n", reason);
+	c->failed = true;
+}
+
+static const struct ext_image_copy_capture_frame_v1_listener frame_listener = {
+	.transform = frame_transform,
+	.damage = frame_damage,
+	.presentation_time = frame_presentation_time,
+	.ready = frame_ready,
+	.failed = frame_failed,
+};
+
+static bool in_damage(const struct capture *c, uint32_t x, uint32_t y)
+{
+	if (c->damage_overflow) {
+		return true;
+	}
+	for (int i = 0; i < c->ndamage; i++) {
+		const struct rect *r = &c->damage[i];
+		if ((int64_t)x >= r->x && (int64_t)x < (int64_t)r->x + r->w &&
+				(int64_t)y >= r->y && (int64_t)y < (int64_t)r->y + r->h) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Compare against the previous frame; every changed pixel must be damaged
+static void check_frame(struct capture *c, const uint32_t *pixels)
+{
+	uint64_t damaged = 0, changed = 0, uncovered = 0;
+	for (int i = 0; i < c->ndamage; i++) {
+		damaged += (uint64_t)c->damage[i].w * (uint64_t)c->damage[i].h;
+	}
+	if (c->prev) {
+		for (uint32_t y = 0; y < c->height; y++) {
+			const uint32_t *row = pixels + (size_t)y * c->width;
+			const uint32_t *prev_row = c->prev + (size_t)y * c->width;
+			for (uint32_t x = 0; x < c->width; x++) {
+				// Ignore the X channel of XRGB formats
+				if ((row[x] ^ prev_row[x]) & 0x00ffffff) {
+					changed++;
+					if (!in_damage(c, x, y)) {
+						uncovered++;
+					}
+				}
+			}
+		}
+	}
+
+	if (c->verbose) {
+		printf("frame %d: %d damage rects, %llu px damaged, %llu px changed, %llu uncovered\n",
+			c->frames, c->ndamage, (unsigned long long)damaged,
+			(unsigned long long)changed, (unsigned long long)uncovered);
+		for (int i = 0; i < c->ndamage; i++) {
+			printf("  %d,%d %dx%d\n", c->damage[i].x, c->damage[i].y, c->damage[i].w, c->damage[i].h);
+		}
+	}
+	if (c->frames > 0) { // The first frame is full damage by definition
+		c->damaged_px += damaged;
+		c->changed_px += changed;
+		c->uncovered_px += uncovered;
+	}
+	c->frames++;
+}
+
+// Capture one frame into a fresh buffer with full buffer damage, so the
+// compositor copies everything and the comparison sees real pixels
+static bool capture_frame(struct capture *c)
+{
+	int stride = (int)c->width * 4;
+	size_t size = (size_t)stride * c->height;
+	int fd = create_shm_file(size);
+	if (fd < 0) {
+		perror("swwm-capture: shm");
+		return false;
+	}
+	uint32_t *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		perror("swwm-capture: mmap");
+		close(fd);
+		return false;
+	}
+	struct wl_shm_pool *pool = wl_shm_create_pool(c->shm, fd, (int32_t)size);
+	struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0, (int32_t)c->width,
+		(int32_t)c->height, stride, c->shm_format);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	c->ndamage = 0;
+	c->damage_overflow = false;
+	c->ready = c->failed = false;
+	c->frame = ext_image_copy_capture_session_v1_create_frame(c->session);
+	ext_image_copy_capture_frame_v1_add_listener(c->frame, &frame_listener, c);
+	ext_image_copy_capture_frame_v1_attach_buffer(c->frame, buffer);
+	ext_image_copy_capture_frame_v1_damage_buffer(c->frame, 0, 0, (int32_t)c->width, (int32_t)c->height);
+	ext_image_copy_capture_frame_v1_capture(c->frame);
+
+	while (!c->ready && !c->failed && !c->stopped) {
+		if (wl_display_dispatch(c->display) < 0) {
+			break;
+		}
+	}
+	bool ok = c->ready;
+	if (ok) {
+		check_frame(c, data);
+		if (!c->prev) {
+			c->prev = malloc(size);
+		}
+		if (c->prev) {
+			memcpy(c->prev, data, size);
+		}
+	}
+
+	ext_image_copy_capture_frame_v1_destroy(c->frame);
+	c->frame = NULL;
+	wl_buffer_destroy(buffer);
+	munmap(data, size);
+	return ok;
+}
+
+// --- session ---
+
+static void session_buffer_size(void *data, struct ext_image_copy_capture_session_v1 *session,
+		uint32_t width, uint32_t height)
+{
+	struct capture *c = data;
+	if ((c->width != width || c->height != height) && c->prev) {
+		free(c->prev); // Size changed: nothing to compare against
+		c->prev = NULL;
+	}
+	c->width = width;
+	c->height = height;
+}
+
+static void session_shm_format(void *data, struct ext_image_copy_capture_session_v1 *session,
+		uint32_t format)
+{
+	struct capture *c = data;
+	// Prefer the 32-bit formats every compositor supports
+	if (format == WL_SHM_FORMAT_XRGB8888 || format == WL_SHM_FORMAT_ARGB8888 || !c->have_shm_format) {
+		if (!c->have_shm_format || c->shm_format != WL_SHM_FORMAT_XRGB8888) {
+			c->shm_format = format;
+		}
+		c->have_shm_format = true;
+	}
+}
+
+static void session_dmabuf_device(void *data, struct ext_image_copy_capture_session_v1 *session,
+		struct wl_array *device)
+{
+}
+
+static void session_dmabuf_format(void *data, struct ext_image_copy_capture_session_v1 *session,
+		uint32_t format, struct wl_array *modifiers)
+{
+}
+
+static void session_done(void *data, struct ext_image_copy_capture_session_v1 *session)
+{
+	struct capture *c = data;
+	c->constraints_done = true;
+}
+
+static void session_stopped(void *data, struct ext_image_copy_capture_session_v1 *session)
+{
+	struct capture *c = data;
+	c->stopped = true;
+}
+
+static const struct ext_image_copy_capture_session_v1_listener session_listener = {
+	.buffer_size = session_buffer_size,
+	.shm_format = session_shm_format,
+	.dmabuf_device = session_dmabuf_device,
+	.dmabuf_format = session_dmabuf_format,
+	.done = session_done,
+	.stopped = session_stopped,
+};
+
+// --- foreign toplevels (to pick a toplevel source by app_id) ---
+
+static void handle_closed(void *data, struct ext_foreign_toplevel_handle_v1 *handle)
+{
+}
+
+static void handle_done(void *data, struct ext_foreign_toplevel_handle_v1 *handle)
+{
+}
+
+static void handle_title(void *data, struct ext_foreign_toplevel_handle_v1 *handle, const char *title)
+{
+}
+
+static void handle_app_id(void *data, struct ext_foreign_toplevel_handle_v1 *handle, const char *app_id)
+{
+	struct toplevel *t = data;
+	free(t->app_id);
+	t->app_id = strdup(app_id);
+}
+
+static void handle_identifier(void *data, struct ext_foreign_toplevel_handle_v1 *handle,
+		const char *identifier)
+{
+}
+
+static const struct ext_foreign_toplevel_handle_v1_listener handle_listener = {
+	.closed = handle_closed,
+	.done = handle_done,
+	.title = handle_title,
+	.app_id = handle_app_id,
+	.identifier = handle_identifier,
+};
+
+static void list_toplevel(void *data, struct ext_foreign_toplevel_list_v1 *list,
+		struct ext_foreign_toplevel_handle_v1 *handle)
+{
+	struct capture *c = data;
+	struct toplevel *t = calloc(1, sizeof(*t));
+	if (!t) {
+		return;
+	}
+	t->handle = handle;
+	t->next = c->toplevels;
+	c->toplevels = t;
+	ext_foreign_toplevel_handle_v1_add_listener(handle, &handle_listener, t);
+}
+
+static void list_finished(void *data, struct ext_foreign_toplevel_list_v1 *list)
+{
+}
+
+static const struct ext_foreign_toplevel_list_v1_listener list_listener = {
+	.toplevel = list_toplevel,
+	.finished = list_finished,
+};
+
+// --- registry ---
+
+static void registry_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	struct capture *c = data;
+	if (!strcmp(interface, wl_shm_interface.name)) {
+		c->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (!strcmp(interface, wl_output_interface.name) && c->noutputs < MAX_OUTPUTS) {
+		c->outputs[c->noutputs++] = wl_registry_bind(registry, name, &wl_output_interface, 1);
+	} else if (!strcmp(interface, ext_output_image_capture_source_manager_v1_interface.name)) {
+		c->output_sources = wl_registry_bind(registry, name,
+			&ext_output_image_capture_source_manager_v1_interface, 1);
+	} else if (!strcmp(interface, ext_foreign_toplevel_image_capture_source_manager_v1_interface.name)) {
+		c->toplevel_sources = wl_registry_bind(registry, name,
+			&ext_foreign_toplevel_image_capture_source_manager_v1_interface, 1);
+	} else if (!strcmp(interface, ext_foreign_toplevel_list_v1_interface.name)) {
+		c->toplevel_list = wl_registry_bind(registry, name, &ext_foreign_toplevel_list_v1_interface, 1);
+		ext_foreign_toplevel_list_v1_add_listener(c->toplevel_list, &list_listener, c);
+	} else if (!strcmp(interface, ext_image_copy_capture_manager_v1_interface.name)) {
+		c->copy_manager = wl_registry_bind(registry, name, &ext_image_copy_capture_manager_v1_interface, 1);
+	}
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-o output index] [-a app_id] [-n frames] [-v]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct capture c = {0};
+	int output_idx = 0;
+	int nframes = 60;
+	const char *app_id = NULL;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "o:a:n:vh")) != -1) {
+		switch (opt) {
+		case 'o': output_idx = atoi(optarg); break;
+		case 'a': app_id = optarg; break;
+		case 'n': nframes = atoi(optarg); break;
+		case 'v': c.verbose = true; break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (nframes <= 0 || output_idx < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	c.display = wl_display_connect(NULL);
+	if (!c.display) {
+		fprintf(stderr, "swwm-capture: cannot connect to Wayland display\n");
+		return 1;
+	}
+	c.registry = wl_display_get_registry(c.display);
+	wl_registry_add_listener(c.registry, &registry_listener, &c);
+	wl_display_roundtrip(c.display);
+	wl_display_roundtrip(c.display); // Toplevel handles and their app_ids
+	if (!c.shm || !c.copy_manager) {
+		fprintf(stderr, "swwm-capture: compositor lacks wl_shm or ext_image_copy_capture_manager_v1\n");
+		return 1;
+	}
+
+	if (app_id) {
+		struct toplevel *t;
+		for (t = c.toplevels; t; t = t->next) {
+			if (t->app_id && !strcmp(t->app_id, app_id)) {
+				break;
+			}
+		}
+		if (!t || !c.toplevel_sources) {
+			fprintf(stderr, "swwm-capture: no capturable toplevel with app_id '%s'\n", app_id);
+			return 1;
+		}
+		c.source = ext_foreign_toplevel_image_capture_source_manager_v1_create_source(
+			c.toplevel_sources, t->handle);
+	} else {
+		if (output_idx >= c.noutputs || !c.output_sources) {
+			fprintf(stderr, "swwm-capture: no capturable output %d\n", output_idx);
+			return 1;
+		}
+		c.source = ext_output_image_capture_source_manager_v1_create_source(
+			c.output_sources, c.outputs[output_idx]);
+	}
+
+	c.session = ext_image_copy_capture_manager_v1_create_session(c.copy_manager, c.source, 0);
+	ext_image_copy_capture_session_v1_add_listener(c.session, &session_listener, &c);
+	while (!c.constraints_done && !c.stopped) {
+		if (wl_display_dispatch(c.display) < 0) {
+			break;
+		}
+	}
+	if (!c.constraints_done || !c.have_shm_format || c.width == 0 || c.height == 0) {
+		fprintf(stderr, "swwm-capture: session offers no usable shm buffer\n");
+		return 1;
+	}
+
+	for (int i = 0; i < nframes && !c.stopped; i++) {
+		if (!capture_frame(&c)) {
+			break;
+		}
+	}
+
+	int compared = c.frames > 1 ? c.frames - 1 : 0;
+	printf("frames %d (%d compared), %ux%u\n", c.frames, compared, c.width, c.height);
+	printf("damaged px/frame %.1f, changed px/frame %.1f, uncovered px %llu\n",
+		compared ? (double)c.damaged_px / compared : 0.0,
+		compared ? (double)c.changed_px / compared : 0.0,
+		(unsigned long long)c.uncovered_px);
+	if (c.uncovered_px) {
+		fprintf(stderr, "swwm-capture: FAIL: changed pixels outside the reported damage\n");
+	}
+
+	ext_image_copy_capture_session_v1_destroy(c.session);
+	ext_image_capture_source_v1_destroy(c.source);
+	while (c.toplevels) {
+		struct toplevel *t = c.toplevels;
+		c.toplevels = t->next;
+		ext_foreign_toplevel_handle_v1_destroy(t->handle);
+		free(t->app_id);
+		free(t);
+	}
+	free(c.prev);
+	wl_display_disconnect(c.display);
+	return c.uncovered_px ? 1 : 0;
+}
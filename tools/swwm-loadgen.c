@@ -0,0 +1,760 @@
+/*
+ * swwm-loadgen: synthetic Wayland client load for stress-testing swwm.
+ *
+ * Opens N xdg toplevels backed by wl_shm buffers, commits damage at a fixed
+ * rate and size, acks configures after a configurable delay (to simulate slow
+ * resizers) and can open/close popups at a fixed rate. On exit it prints the
+ * configure-to-commit latency and frame-callback interval/jitter per window.
+ *
+ * Usage: swwm-loadgen [-n windows] [-r damage Hz] [-d WxH damage] [-s WxH size]
+ *                     [-D ack delay ms] [-P popups Hz] [-t seconds] [-a app_id]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "xdg-shell-client-protocol.h"
+
+#define POPUP_WIDTH 120
+#define POPUP_HEIGHT 80
+
+struct samples {
+	uint64_t *v; // nanoseconds
+	size_t n, cap;
+};
+
+struct buffer {
+	struct wl_buffer *wl_buffer;
+	uint32_t *data;
+	int width, height;
+	size_t size;
+	bool busy;
+};
+
+struct client;
+
+struct window {
+	struct client *client;
+	int id;
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	struct buffer buffers[2];
+	int width, height;
+
+	// Configure currently being "processed" by the simulated slow client
+	bool configure_pending;
+	uint32_t configure_serial;
+	int configure_width, configure_height; // From xdg_toplevel.configure, 0 = our choice
+	uint64_t configure_ns; // When the oldest unacked configure arrived
+	uint64_t ack_at_ns;
+	bool resize_pending; // Acked, but no buffer of the new size committed yet
+	bool mapped; // First configure acked and a buffer committed
+
+	struct wl_callback *frame_cb;
+	uint64_t last_frame_ns;
+	uint32_t frame_counter;
+	int damage_x, damage_y;
+	uint64_t skipped; // Damage ticks dropped because both buffers were busy
+
+	struct wl_surface *popup_surface;
+	struct xdg_surface *popup_xdg_surface;
+	struct xdg_popup *popup;
+	struct buffer popup_buffer;
+	uint64_t popups;
+
+	struct samples configure_latency;
+	struct samples frame_interval;
+	bool closed;
+};
+
+struct client {
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+
+	struct window *windows;
+	int nwindows;
+
+	int width, height;
+	int damage_w, damage_h;
+	int damage_hz;
+	int ack_delay_ms;
+	int popup_hz;
+	const char *app_id;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void samples_add(struct samples *s, uint64_t ns)
+{
+	if (s->n == s->cap) {
+		size_t cap = s->cap ? s->cap * 2 : 256;
+		uint64_t *v = realloc(s->v, cap * sizeof(*v));
+		if (!v) {
+			return;
+		}
+		s->v = v;
+		s->cap = cap;
+	}
+	s->v[s->n++] = ns;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+// Sorts in place; returns the nearest-rank percentile in ms
+static double samples_percentile_ms(struct samples *s, unsigned pct)
+{
+	if (s->n == 0) {
+		return 0.0;
+	}
+	qsort(s->v, s->n, sizeof(*s->v), cmp_u64);
+	size_t rank = (s->n * pct + 99) / 100;
+	return s->v[rank ? rank - 1 : 0] / 1e6;
+}
+
+static double samples_stddev_ms(const struct samples *s)
+{
+	if (s->n < 2) {
+		return 0.0;
+	}
+	double mean = 0.0, m2 = 0.0;
+	for (size_t i = 0; i < s->n; i++) {
+		double x = s->v[i] / 1e6;
+		double d = x - mean;
+		mean += d / (double)(i + 1);
+		m2 += d * (x - mean);
+	}
+	return sqrt(m2 / (double)(s->n - 1));
+}
+
+// --- shm buffers ---
+
+static void buffer_release(void *data, struct wl_buffer *wl_buffer)
+{
+	struct buffer *buf = data;
+	buf->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_release,
+};
+
+static int create_shm_file(size_t size)
+{
+	static unsigned counter;
+	char name[64];
+	for (int tries = 0; tries < 100; tries++) {
+		snprintf(name, sizeof name, "/swwm-loadgen-%ld-%u", (long)getpid(), counter++);
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) {
+			shm_unlink(name);
+			if (ftruncate(fd, (off_t)size) < 0) {
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+		if (errno != EEXIST) {
+			break;
+		}
+	}
+	return -1;
+}
+
+static void buffer_finish(struct buffer *buf)
+{
+	if (buf->wl_buffer) {
+		wl_buffer_destroy(buf->wl_buffer);
+		munmap(buf->data, buf->size);
+	}
+	memset(buf, 0, sizeof(*buf));
+}
+
+static bool buffer_init(struct client *c, struct buffer *buf, int width, int height)
+{
+	buffer_finish(buf);
+	int stride = width * 4;
+	size_t size = (size_t)stride * (size_t)height;
+	int fd = create_shm_file(size);
+	if (fd < 0) {
+		perror("swwm-loadgen: shm");
+		return false;
+	}
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		perror("swwm-loadgen: mmap");
+		close(fd);
+		return false;
+	}
+	struct wl_shm_pool *pool = wl_shm_create_pool(c->shm, fd, (int32_t)size);
+	buf->wl_buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride,
+		WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	buf->data = data;
+	buf->size = size;
+	buf->width = width;
+	buf->height = height;
+	buf->busy = false;
+	wl_buffer_add_listener(buf->wl_buffer, &buffer_listener, buf);
+	return true;
+}
+
+static void fill_rect(struct buffer *buf, int x, int y, int w, int h, uint32_t colour)
+{
+	for (int j = y; j < y + h && j < buf->height; j++) {
+		uint32_t *row = buf->data + (size_t)j * (size_t)buf->width;
+		for (int i = x; i < x + w && i < buf->width; i++) {
+			row[i] = colour;
+		}
+	}
+}
+
+static struct buffer *window_next_buffer(struct window *win)
+{
+	for (int i = 0; i < 2; i++) {
+		struct buffer *buf = &win->buffers[i];
+		if (!buf->busy) {
+			if (buf->width != win->width || buf->height != win->height) {
+				if (!buffer_init(win->client, buf, win->width, win->height)) {
+					return NULL;
+				}
+				fill_rect(buf, 0, 0, buf->width, buf->height, 0xff202020 + (uint32_t)win->id * 0x101010);
+			}
+			return buf;
+		}
+	}
+	return NULL;
+}
+
+// --- frame callbacks ---
+
+static void frame_done(void *data, struct wl_callback *cb, uint32_t time);
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_done,
+};
+
+static void frame_done(void *data, struct wl_callback *cb, uint32_t time)
+{
+	struct window *win = data;
+	uint64_t now = now_ns();
+	if (win->last_frame_ns) {
+		samples_add(&win->frame_interval, now - win->last_frame_ns);
+	}
+	win->last_frame_ns = now;
+	wl_callback_destroy(cb);
+	win->frame_cb = NULL;
+}
+
+// Attach a buffer with the given damage (full when w == 0) and commit
+static bool window_commit(struct window *win, int x, int y, int w, int h)
+{
+	struct buffer *buf = window_next_buffer(win);
+	if (!buf) {
+		win->skipped++;
+		return false;
+	}
+	if (w == 0) {
+		x = 0;
+		y = 0;
+		w = buf->width;
+		h = buf->height;
+		fill_rect(buf, 0, 0, w, h, 0xff202020 + (uint32_t)win->id * 0x101010);
+	} else {
+		fill_rect(buf, x, y, w, h, 0xff000000 | (win->frame_counter * 2654435761u));
+	}
+	win->frame_counter++;
+
+	wl_surface_attach(win->surface, buf->wl_buffer, 0, 0);
+	wl_surface_damage_buffer(win->surface, x, y, w, h);
+	if (!win->frame_cb) {
+		win->frame_cb = wl_surface_frame(win->surface);
+		wl_callback_add_listener(win->frame_cb, &frame_listener, win);
+	}
+	wl_surface_commit(win->surface);
+	buf->busy = true;
+	return true;
+}
+
+static void window_damage_tick(struct window *win)
+{
+	struct client *c = win->client;
+	if (!win->mapped || win->closed || win->resize_pending) {
+		return;
+	}
+	int w = c->damage_w < win->width ? c->damage_w : win->width;
+	int h = c->damage_h < win->height ? c->damage_h : win->height;
+	// Sweep the damage rect across the window so consecutive frames differ
+	win->damage_x += w;
+	if (win->damage_x + w > win->width) {
+		win->damage_x = 0;
+		win->damage_y += h;
+		if (win->damage_y + h > win->height) {
+			win->damage_y = 0;
+		}
+	}
+	window_commit(win, win->damage_x, win->damage_y, w, h);
+}
+
+// Commit a full frame at the acked size; retried until a buffer is free
+static void window_commit_resize(struct window *win)
+{
+	if (window_commit(win, 0, 0, 0, 0)) {
+		samples_add(&win->configure_latency, now_ns() - win->configure_ns);
+		win->resize_pending = false;
+		win->mapped = true;
+	}
+}
+
+static void window_ack_configure(struct window *win)
+{
+	struct client *c = win->client;
+	win->configure_pending = false;
+	xdg_surface_ack_configure(win->xdg_surface, win->configure_serial);
+
+	win->width = win->configure_width > 0 ? win->configure_width : c->width;
+	win->height = win->configure_height > 0 ? win->configure_height : c->height;
+	win->damage_x = win->damage_y = 0;
+	win->resize_pending = true;
+	window_commit_resize(win);
+}
+
+// --- popups ---
+
+static void popup_destroy(struct window *win)
+{
+	if (!win->popup) {
+		return;
+	}
+	xdg_popup_destroy(win->popup);
+	xdg_surface_destroy(win->popup_xdg_surface);
+	wl_surface_destroy(win->popup_surface);
+	win->popup = NULL;
+	win->popup_xdg_surface = NULL;
+	win->popup_surface = NULL;
+}
+
+static void popup_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial)
+{
+	struct window *win = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	if (!win->popup_buffer.wl_buffer) {
+		if (!buffer_init(win->client, &win->popup_buffer, POPUP_WIDTH, POPUP_HEIGHT)) {
+			return;
+		}
+		fill_rect(&win->popup_buffer, 0, 0, POPUP_WIDTH, POPUP_HEIGHT, 0xffc0cbff);
+	}
+	wl_surface_attach(win->popup_surface, win->popup_buffer.wl_buffer, 0, 0);
+	wl_surface_damage_buffer(win->popup_surface, 0, 0, POPUP_WIDTH, POPUP_HEIGHT);
+	wl_surface_commit(win->popup_surface);
+}
+
+static const struct xdg_surface_listener popup_xdg_surface_listener = {
+	.configure = popup_xdg_surface_configure,
+};
+
+static void popup_configure(void *data, struct xdg_popup *popup, int32_t x, int32_t y,
+		int32_t width, int32_t height)
+{
+}
+
+static void popup_done(void *data, struct xdg_popup *popup)
+{
+	popup_destroy(data);
+}
+
+static void popup_repositioned(void *data, struct xdg_popup *popup, uint32_t token)
+{
+}
+
+static const struct xdg_popup_listener popup_listener = {
+	.configure = popup_configure,
+	.popup_done = popup_done,
+	.repositioned = popup_repositioned,
+};
+
+// Replace the window's popup with a new one at a different anchor
+static void window_popup_tick(struct window *win)
+{
+	struct client *c = win->client;
+	if (!win->mapped || win->closed) {
+		return;
+	}
+	popup_destroy(win);
+
+	struct xdg_positioner *positioner = xdg_wm_base_create_positioner(c->wm_base);
+	int ax = (int)(win->popups * 37 % (uint64_t)(win->width > 1 ? win->width - 1 : 1));
+	int ay = (int)(win->popups * 53 % (uint64_t)(win->height > 1 ? win->height - 1 : 1));
+	xdg_positioner_set_size(positioner, POPUP_WIDTH, POPUP_HEIGHT);
+	xdg_positioner_set_anchor_rect(positioner, ax, ay, 1, 1);
+	xdg_positioner_set_anchor(positioner, XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT);
+	xdg_positioner_set_gravity(positioner, XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT);
+
+	win->popup_surface = wl_compositor_create_surface(c->compositor);
+	win->popup_xdg_surface = xdg_wm_base_get_xdg_surface(c->wm_base, win->popup_surface);
+	xdg_surface_add_listener(win->popup_xdg_surface, &popup_xdg_surface_listener, win);
+	win->popup = xdg_surface_get_popup(win->popup_xdg_surface, win->xdg_surface, positioner);
+	xdg_popup_add_listener(win->popup, &popup_listener, win);
+	xdg_positioner_destroy(positioner);
+	wl_surface_commit(win->popup_surface);
+	win->popups++;
+}
+
+// --- xdg toplevel ---
+
+static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial)
+{
+	struct window *win = data;
+	if (!win->configure_pending) {
+		win->configure_ns = now_ns();
+		win->ack_at_ns = win->configure_ns + (uint64_t)win->client->ack_delay_ms * 1000000ull;
+	}
+	win->configure_pending = true;
+	win->configure_serial = serial;
+	if (win->client->ack_delay_ms == 0) {
+		window_ack_configure(win);
+	}
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+static void xdg_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states)
+{
+	struct window *win = data;
+	win->configure_width = width;
+	win->configure_height = height;
+}
+
+static void xdg_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+	struct window *win = data;
+	win->closed = true;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	.configure = xdg_toplevel_configure,
+	.close = xdg_toplevel_close,
+};
+
+static void window_init(struct client *c, struct window *win, int id)
+{
+	win->client = c;
+	win->id = id;
+	win->width = c->width;
+	win->height = c->height;
+	win->surface = wl_compositor_create_surface(c->compositor);
+	win->xdg_surface = xdg_wm_base_get_xdg_surface(c->wm_base, win->surface);
+	xdg_surface_add_listener(win->xdg_surface, &xdg_surface_listener, win);
+	win->xdg_toplevel = xdg_surface_get_toplevel(win->xdg_surface);
+	xdg_toplevel_add_listener(win->xdg_toplevel, &xdg_toplevel_listener, win);
+
+	char title[64];
+	snprintf(title, sizeof title, "swwm-loadgen %d", id);
+	xdg_toplevel_set_title(win->xdg_toplevel, title);
+	xdg_toplevel_set_app_id(win->xdg_toplevel, c->app_id);
+	wl_surface_commit(win->surface); // Initial commit, no buffer
+}
+
+static void window_finish(struct window *win)
+{
+	popup_destroy(win);
+	if (win->frame_cb) {
+		wl_callback_destroy(win->frame_cb);
+	}
+	xdg_toplevel_destroy(win->xdg_toplevel);
+	xdg_surface_destroy(win->xdg_surface);
+	wl_surface_destroy(win->surface);
+	buffer_finish(&win->buffers[0]);
+	buffer_finish(&win->buffers[1]);
+	buffer_finish(&win->popup_buffer);
+	free(win->configure_latency.v);
+	free(win->frame_interval.v);
+}
+
+// --- registry ---
+
+static void wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void registry_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	struct client *c = data;
+	if (!strcmp(interface, wl_compositor_interface.name)) {
+		c->compositor = wl_registry_bind(registry, name, &wl_compositor_interface,
+			version < 4 ? version : 4);
+	} else if (!strcmp(interface, wl_shm_interface.name)) {
+		c->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+		c->wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(c->wm_base, &wm_base_listener, c);
+	}
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+// --- main loop ---
+
+static void handle_signal(int sig)
+{
+	running = 0;
+}
+
+static void report(struct client *c, FILE *f)
+{
+	struct samples all_cfg = {0}, all_frame = {0};
+	uint64_t skipped = 0;
+
+	fprintf(f, "%-6s %8s %9s %9s %9s %8s %11s %11s %9s %8s\n", "window", "configs",
+		"cfg_p50", "cfg_p99", "cfg_max", "frames", "intvl_p50", "intvl_p99",
+		"jitter", "skipped");
+	for (int i = 0; i < c->nwindows; i++) {
+		struct window *win = &c->windows[i];
+		for (size_t k = 0; k < win->configure_latency.n; k++) {
+			samples_add(&all_cfg, win->configure_latency.v[k]);
+		}
+		for (size_t k = 0; k < win->frame_interval.n; k++) {
+			samples_add(&all_frame, win->frame_interval.v[k]);
+		}
+		skipped += win->skipped;
+		fprintf(f, "%-6d %8zu %9.3f %9.3f %9.3f %8zu %11.3f %11.3f %9.3f %8llu\n", win->id,
+			win->configure_latency.n,
+			samples_percentile_ms(&win->configure_latency, 50),
+			samples_percentile_ms(&win->configure_latency, 99),
+			samples_percentile_ms(&win->configure_latency, 100),
+			win->frame_interval.n,
+			samples_percentile_ms(&win->frame_interval, 50),
+			samples_percentile_ms(&win->frame_interval, 99),
+			samples_stddev_ms(&win->frame_interval),
+			(unsigned long long)win->skipped);
+	}
+	fprintf(f, "%-6s %8zu %9.3f %9.3f %9.3f %8zu %11.3f %11.3f %9.3f %8llu\n", "all",
+		all_cfg.n,
+		samples_percentile_ms(&all_cfg, 50),
+		samples_percentile_ms(&all_cfg, 99),
+		samples_percentile_ms(&all_cfg, 100),
+		all_frame.n,
+		samples_percentile_ms(&all_frame, 50),
+		samples_percentile_ms(&all_frame, 99),
+		samples_stddev_ms(&all_frame),
+		(unsigned long long)skipped);
+	fprintf(f, "(times in ms; jitter is the stddev of frame callback intervals)\n");
+	free(all_cfg.v);
+	free(all_frame.v);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-n windows] [-r damage Hz] [-d WxH damage] [-s WxH size]\n"
+		"       [-D ack delay ms] [-P popups Hz] [-t seconds] [-a app_id]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct client c = {
+		.nwindows = 1,
+		.width = 640,
+		.height = 480,
+		.damage_w = 64,
+		.damage_h = 64,
+		.damage_hz = 60,
+		.app_id = "swwm-loadgen",
+	};
+	int duration_s = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:d:s:D:P:t:a:h")) != -1) {
+		switch (opt) {
+		case 'n': c.nwindows = atoi(optarg); break;
+		case 'r': c.damage_hz = atoi(optarg); break;
+		case 'd':
+			if (sscanf(optarg, "%dx%d", &c.damage_w, &c.damage_h) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 's':
+			if (sscanf(optarg, "%dx%d", &c.width, &c.height) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'D': c.ack_delay_ms = atoi(optarg); break;
+		case 'P': c.popup_hz = atoi(optarg); break;
+		case 't': duration_s = atoi(optarg); break;
+		case 'a': c.app_id = optarg; break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (c.nwindows <= 0 || c.width <= 0 || c.height <= 0 || c.damage_w <= 0 ||
+			c.damage_h <= 0 || c.damage_hz < 0 || c.ack_delay_ms < 0 || c.popup_hz < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	c.display = wl_display_connect(NULL);
+	if (!c.display) {
+		fprintf(stderr, "swwm-loadgen: cannot connect to Wayland display\n");
+		return 1;
+	}
+	c.registry = wl_display_get_registry(c.display);
+	wl_registry_add_listener(c.registry, &registry_listener, &c);
+	wl_display_roundtrip(c.display);
+	if (!c.compositor || !c.shm || !c.wm_base) {
+		fprintf(stderr, "swwm-loadgen: compositor lacks wl_compositor, wl_shm or xdg_wm_base\n");
+		return 1;
+	}
+
+	c.windows = calloc((size_t)c.nwindows, sizeof(*c.windows));
+	if (!c.windows) {
+		perror("swwm-loadgen: calloc");
+		return 1;
+	}
+	for (int i = 0; i < c.nwindows; i++) {
+		window_init(&c, &c.windows[i], i);
+	}
+
+	struct sigaction sa = { .sa_handler = handle_signal };
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	uint64_t start = now_ns();
+	uint64_t end = duration_s > 0 ? start + (uint64_t)duration_s * 1000000000ull : 0;
+	uint64_t damage_period = c.damage_hz > 0 ? 1000000000ull / (uint64_t)c.damage_hz : 0;
+	uint64_t popup_period = c.popup_hz > 0 ? 1000000000ull / (uint64_t)c.popup_hz : 0;
+	uint64_t next_damage = start + damage_period;
+	uint64_t next_popup = start + popup_period;
+
+	while (running) {
+		uint64_t now = now_ns();
+		if (end && now >= end) {
+			break;
+		}
+
+		for (int i = 0; i < c.nwindows; i++) {
+			struct window *win = &c.windows[i];
+			if (win->configure_pending && now >= win->ack_at_ns) {
+				window_ack_configure(win);
+			} else if (win->resize_pending) {
+				window_commit_resize(win);
+			}
+		}
+		if (damage_period && now >= next_damage) {
+			for (int i = 0; i < c.nwindows; i++) {
+				window_damage_tick(&c.windows[i]);
+			}
+			// Stay on the original cadence; drop ticks we were too slow for
+			do {
+				next_damage += damage_period;
+			} while (next_damage <= now);
+		}
+		if (popup_period && now >= next_popup) {
+			for (int i = 0; i < c.nwindows; i++) {
+				window_popup_tick(&c.windows[i]);
+			}
+			do {
+				next_popup += popup_period;
+			} while (next_popup <= now);
+		}
+
+		bool all_closed = true;
+		uint64_t deadline = end ? end : now + 1000000000ull;
+		if (damage_period && next_damage < deadline) {
+			deadline = next_damage;
+		}
+		if (popup_period && next_popup < deadline) {
+			deadline = next_popup;
+		}
+		for (int i = 0; i < c.nwindows; i++) {
+			struct window *win = &c.windows[i];
+			all_closed &= win->closed;
+			if (win->configure_pending && win->ack_at_ns < deadline) {
+				deadline = win->ack_at_ns;
+			}
+		}
+		if (all_closed) {
+			break;
+		}
+
+		while (wl_display_prepare_read(c.display) != 0) {
+			wl_display_dispatch_pending(c.display);
+		}
+		wl_display_flush(c.display);
+
+		now = now_ns();
+		int timeout = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+		struct pollfd pfd = { .fd = wl_display_get_fd(c.display), .events = POLLIN };
+		if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+			if (wl_display_read_events(c.display) < 0) {
+				break;
+			}
+		} else {
+			wl_display_cancel_read(c.display);
+		}
+		if (wl_display_dispatch_pending(c.display) < 0) {
+			fprintf(stderr, "swwm-loadgen: connection lost\n");
+			break;
+		}
+	}
+
+	report(&c, stdout);
+
+	for (int i = 0; i < c.nwindows; i++) {
+		window_finish(&c.windows[i]);
+	}
+	free(c.windows);
+	xdg_wm_base_destroy(c.wm_base);
+	wl_shm_destroy(c.shm);
+	wl_compositor_destroy(c.compositor);
+	wl_registry_destroy(c.registry);
+	wl_display_disconnect(c.display);
+	return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * swwm-msg: talk to a running swwm over its IPC socket (see src/ipc.h).
+ *
+ * Sends one message and prints the reply. For commands, the remaining
+ * arguments are joined into one command per argument, so
+ *
+ *   swwm-msg 'workspace move 3' 'call toggle_floating'
+ *
+ * runs both with a single relayout. -m subscribes to the given events and
+ * prints each one as "<event>\t<payload>" until the compositor goes away.
+ * -S prints the shared-memory state snapshot (src/snapshot.h) instead, in
+ * the get_outputs / get_toplevels format, without talking to swwm at all.
+ *
+ * Usage: swwm-msg [-s socket] [-t type] [-m] [-S] [args...]
+ *   type: command (default), get_outputs, get_workspaces, get_toplevels, subscribe
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ipc.h"
+#include "snapshot.h"
+
+static const struct {
+	const char *name;
+	uint32_t type;
+} types[] = {
+	{"command", IPC_COMMAND},
+	{"get_outputs", IPC_GET_OUTPUTS},
+	{"get_workspaces", IPC_GET_WORKSPACES},
+	{"get_toplevels", IPC_GET_TOPLEVELS},
+	{"subscribe", IPC_SUBSCRIBE},
+};
+
+static const char *event_name(uint32_t event)
+{
+	switch (event) {
+	case IPC_EVENT_FOCUS:
+		return "focus";
+	case IPC_EVENT_WORKSPACE:
+		return "workspace";
+	case IPC_EVENT_WINDOW:
+		return "window";
+	case IPC_EVENT_CONFIG:
+		return "config";
+	}
+	return "unknown";
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+	const char *p = data;
+	while (len) {
+		ssize_t n = write(fd, p, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		p += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+static bool read_all(int fd, void *data, size_t len)
+{
+	char *p = data;
+	while (len) {
+		ssize_t n = read(fd, p, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		p += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+// Reads one message; the payload is NUL-terminated and must be freed
+static char *read_message(int fd, uint32_t *type, uint32_t *len)
+{
+	uint8_t header[IPC_HEADER_SIZE];
+	if (!read_all(fd, header, sizeof(header))) {
+		return NULL;
+	}
+	*len = get32(header);
+	*type = get32(header + 4);
+	char *payload = malloc((size_t)*len + 1);
+	if (!payload || !read_all(fd, payload, *len)) {
+		free(payload);
+		return NULL;
+	}
+	payload[*len] = '\0';
+	return payload;
+}
+
+static int print_snapshot(void)
+{
+	const char *path = getenv("SWWMSTATE");
+	int fd = path ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+	if (fd < 0) {
+		fprintf(stderr, "cannot open the state snapshot (SWWMSTATE=%s)\n", path ? path : "");
+		return 1;
+	}
+	const struct swwm_snapshot *shared = mmap(NULL, sizeof(*shared), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	static struct swwm_snapshot s;
+	if (shared == MAP_FAILED || !swwm_snapshot_read(shared, &s)) {
+		fprintf(stderr, "no valid snapshot in %s\n", path);
+		return 1;
+	}
+	for (uint32_t i = 0; i < s.noutputs; i++) {
+		const struct swwm_snapshot_output *o = &s.outputs[i];
+		printf("%s\t%d\t%d\t%d\t%d\t%.2f\t%d\n", o->name, o->x, o->y, o->width, o->height,
+			o->scale, o->workspace + 1);
+	}
+	for (uint32_t i = 0; i < s.ntoplevels; i++) {
+		const struct swwm_snapshot_toplevel *t = &s.toplevels[i];
+		printf("%u\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%s\t%s\n", t->id, t->workspace + 1, t->floating,
+			t->fullscreen, t->focused, t->x, t->y, t->width, t->height, t->app_id, t->title);
+	}
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-s socket] [-t type] [-m] [args...]\n"
+		"  -s  socket path (default: $SWWMSOCK)\n"
+		"  -t  command, get_outputs, get_workspaces, get_toplevels or subscribe\n"
+		"  -m  monitor: subscribe to the events in args and print them\n"
+		"  -S  print the shared-memory state snapshot ($SWWMSTATE)\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = getenv("SWWMSOCK");
+	uint32_t type = IPC_COMMAND;
+	bool monitor = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "s:t:mSh")) != -1) {
+		switch (opt) {
+		case 's':
+			path = optarg;
+			break;
+		case 't': {
+			size_t i = 0;
+			while (i < sizeof(types) / sizeof(types[0]) && strcmp(optarg, types[i].name) != 0) {
+				i++;
+			}
+			if (i == sizeof(types) / sizeof(types[0])) {
+				fprintf(stderr, "unknown message type '%s'\n", optarg);
+				return 1;
+			}
+			type = types[i].type;
+			break;
+		}
+		case 'm':
+			monitor = true;
+			type = IPC_SUBSCRIBE;
+			break;
+		case 'S':
+			return print_snapshot();
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!path) {
+		fprintf(stderr, "SWWMSOCK is not set and no -s given\n");
+		return 1;
+	}
+
+	// Commands go one per line, everything else space-separated
+	size_t len = 0;
+	for (int i = optind; i < argc; i++) {
+		len += strlen(argv[i]) + 1;
+	}
+	if (len > IPC_MAX_PAYLOAD) {
+		fprintf(stderr, "message too long\n");
+		return 1;
+	}
+	char *payload = malloc(len + 1);
+	if (!payload) {
+		return 1;
+	}
+	size_t off = 0;
+	for (int i = optind; i < argc; i++) {
+		off += (size_t)sprintf(payload + off, "%s%c", argv[i], type == IPC_COMMAND ? '\n' : ' ');
+	}
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long\n");
+		return 1;
+	}
+	strcpy(addr.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "cannot connect to %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	uint8_t header[IPC_HEADER_SIZE];
+	put32(header, (uint32_t)off);
+	put32(header + 4, type);
+	if (!write_all(fd, header, sizeof(header)) || !write_all(fd, payload, off)) {
+		fprintf(stderr, "write failed: %s\n", strerror(errno));
+		return 1;
+	}
+	free(payload);
+
+	int ret = 0;
+	for (;;) {
+		uint32_t reply_type, reply_len;
+		char *reply = read_message(fd, &reply_type, &reply_len);
+		if (!reply) {
+			if (!monitor) {
+				fprintf(stderr, "no reply from swwm\n");
+				ret = 1;
+			}
+			break;
+		}
+		if (reply_type & IPC_EVENT_FLAG) {
+			if (reply_len && reply[reply_len - 1] == '\n') {
+				reply[reply_len - 1] = '\0';
+			}
+			printf("%s\t%s\n", event_name(reply_type & ~IPC_EVENT_FLAG), reply);
+			fflush(stdout);
+			free(reply);
+			continue; // Caused by our command; its reply follows
+		}
+		fputs(reply, stdout);
+		if (strstr(reply, "error:")) {
+			ret = 1;
+		}
+		free(reply);
+		if (!monitor || ret) {
+			break;
+		}
+	}
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,527 @@
+/*
+ * swwm-pacing: checks that swwm honours wp_fifo_v1 and wp_commit_timing_v1.
+ *
+ * Meant to run against a headless swwm (WLR_BACKENDS=headless). Opens one
+ * xdg toplevel and never asks for frame callbacks; pacing comes only from
+ * the two protocols, and wp_presentation feedback says when each commit
+ * reached the screen.
+ *
+ *   fifo:          N commits sent back to back, each setting and waiting on
+ *                  the fifo barrier. None may be discarded and consecutive
+ *                  presentations must be at least about one refresh apart.
+ *   commit-timing: N commits sent back to back with target times spaced -i ms
+ *                  apart on the presentation clock. None may be presented
+ *                  before its target, nor more than a few refreshes after.
+ *
+ * Prints one line per test and exits non-zero if either fails.
+ *
+ * Usage: swwm-pacing [-n commits] [-i interval ms] [-R fallback refresh Hz]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "commit-timing-v1-client-protocol.h"
+#include "fifo-v1-client-protocol.h"
+#include "presentation-time-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#define WIDTH 256
+#define HEIGHT 256
+#define NBUFFERS 4
+#define TIMEOUT_NS 10000000000ull
+
+// One commit under test
+struct sample {
+	struct wp_presentation_feedback *feedback;
+	uint64_t target_ns; // commit-timing target, 0 for fifo
+	uint64_t presented_ns;
+	uint32_t refresh_ns;
+	bool done, discarded;
+};
+
+struct buffer {
+	struct wl_buffer *wl_buffer;
+	uint32_t *data;
+	size_t size;
+};
+
+struct client {
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+	struct wp_presentation *presentation;
+	struct wp_fifo_manager_v1 *fifo_manager;
+	struct wp_commit_timing_manager_v1 *timing_manager;
+	clockid_t clock_id;
+
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	struct wp_fifo_v1 *fifo;
+	struct wp_commit_timer_v1 *timer;
+	struct buffer buffers[NBUFFERS];
+	bool configured, closed;
+
+	struct sample *samples;
+	int nsamples;
+};
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// --- shm buffers ---
+
+static int create_shm_file(size_t size)
+{
+	static unsigned counter;
+	char name[64];
+	for (int tries = 0; tries < 100; tries++) {
+		snprintf(name, sizeof name, "/swwm-pacing-%ld-%u", (long)getpid(), counter++);
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) {
+			shm_unlink(name);
+			if (ftruncate(fd, (off_t)size) < 0) {
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+		if (errno != EEXIST) {
+			break;
+		}
+	}
+	return -1;
+}
+
+// Buffers are never waited on: their contents are fixed at creation, so
+// attaching one the compositor still holds is harmless
+static bool buffer_init(struct client *c, struct buffer *buf, uint32_t colour)
+{
+	int stride = WIDTH * 4;
+	size_t size = (size_t)stride * HEIGHT;
+	int fd = create_shm_file(size);
+	if (fd < 0) {
+		perror("swwm-pacing: shm");
+		return false;
+	}
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		perror("swwm-pacing: mmap");
+		close(fd);
+		return false;
+	}
+	struct wl_shm_pool *pool = wl_shm_create_pool(c->shm, fd, (int32_t)size);
+	buf->wl_buffer = wl_shm_pool_create_buffer(pool, 0, WIDTH, HEIGHT, stride,
+		WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	buf->data = data;
+	buf->size = size;
+	for (size_t i = 0; i < size / 4; i++) {
+		buf->data[i] = colour;
+	}
+	return true;
+}
+
+static void buffer_finish(struct buffer *buf)
+{
+	if (buf->wl_buffer) {
+		wl_buffer_destroy(buf->wl_buffer);
+		munmap(buf->data, buf->size);
+	}
+	memset(buf, 0, sizeof(*buf));
+}
+
+// --- presentation feedback ---
+
+static void feedback_sync_output(void *data, struct wp_presentation_feedback *feedback,
+		struct wl_output *output)
+{
+}
+
+static void feedback_presented(void *data, struct wp_presentation_feedback *feedback,
+		uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+		uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+	struct sample *s = data;
+	s->presented_ns = (((uint64_t)tv_sec_hi << 32) | tv_sec_lo) * 1000000000ull + tv_nsec;
+	s->refresh_ns = refresh;
+	s->done = true;
+	wp_presentation_feedback_destroy(feedback);
+	s->feedback = NULL;
+}
+
+static void feedback_discarded(void *data, struct wp_presentation_feedback *feedback)
+{
+	struct sample *s = data;
+	s->discarded = true;
+	s->done = true;
+	wp_presentation_feedback_destroy(feedback);
+	s->feedback = NULL;
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	.sync_output = feedback_sync_output,
+	.presented = feedback_presented,
+	.discarded = feedback_discarded,
+};
+
+static void presentation_clock_id(void *data, struct wp_presentation *presentation, uint32_t clk_id)
+{
+	struct client *c = data;
+	c->clock_id = (clockid_t)clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	.clock_id = presentation_clock_id,
+};
+
+// --- xdg toplevel ---
+
+static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial)
+{
+	struct client *c = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	if (!c->configured) {
+		wl_surface_attach(c->surface, c->buffers[0].wl_buffer, 0, 0);
+		wl_surface_damage_buffer(c->surface, 0, 0, WIDTH, HEIGHT);
+	}
+	wl_surface_commit(c->surface);
+	c->configured = true;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+static void xdg_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states)
+{
+}
+
+static void xdg_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+	struct client *c = data;
+	c->closed = true;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	.configure = xdg_toplevel_configure,
+	.close = xdg_toplevel_close,
+};
+
+// --- registry ---
+
+static void wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void registry_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	struct client *c = data;
+	if (!strcmp(interface, wl_compositor_interface.name)) {
+		c->compositor = wl_registry_bind(registry, name, &wl_compositor_interface,
+			version < 4 ? version : 4);
+	} else if (!strcmp(interface, wl_shm_interface.name)) {
+		c->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+		c->wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(c->wm_base, &wm_base_listener, c);
+	} else if (!strcmp(interface, wp_presentation_interface.name)) {
+		c->presentation = wl_registry_bind(registry, name, &wp_presentation_interface, 1);
+		wp_presentation_add_listener(c->presentation, &presentation_listener, c);
+	} else if (!strcmp(interface, wp_fifo_manager_v1_interface.name)) {
+		c->fifo_manager = wl_registry_bind(registry, name, &wp_fifo_manager_v1_interface, 1);
+	} else if (!strcmp(interface, wp_commit_timing_manager_v1_interface.name)) {
+		c->timing_manager = wl_registry_bind(registry, name,
+			&wp_commit_timing_manager_v1_interface, 1);
+	}
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+// --- tests ---
+
+// Attaches the next buffer, asks for feedback into s and commits
+static void commit_sample(struct client *c, int i, struct sample *s)
+{
+	wl_surface_attach(c->surface, c->buffers[i % NBUFFERS].wl_buffer, 0, 0);
+	wl_surface_damage_buffer(c->surface, 0, 0, WIDTH, HEIGHT);
+	s->feedback = wp_presentation_feedback(c->presentation, c->surface);
+	wp_presentation_feedback_add_listener(s->feedback, &feedback_listener, s);
+	wl_surface_commit(c->surface);
+}
+
+// Dispatches until every sample has feedback; false on timeout or error
+static bool wait_samples(struct client *c)
+{
+	uint64_t deadline = clock_ns(CLOCK_MONOTONIC) + TIMEOUT_NS;
+	for (;;) {
+		bool all = true;
+		for (int i = 0; i < c->nsamples; i++) {
+			all &= c->samples[i].done;
+		}
+		if (all) {
+			return true;
+		}
+		uint64_t now = clock_ns(CLOCK_MONOTONIC);
+		if (c->closed || now >= deadline) {
+			return false;
+		}
+
+		while (wl_display_prepare_read(c->display) != 0) {
+			wl_display_dispatch_pending(c->display);
+		}
+		wl_display_flush(c->display);
+		int timeout = (int)((deadline - now + 999999) / 1000000);
+		struct pollfd pfd = { .fd = wl_display_get_fd(c->display), .events = POLLIN };
+		if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+			if (wl_display_read_events(c->display) < 0) {
+				return false;
+			}
+		} else {
+			wl_display_cancel_read(c->display);
+		}
+		if (wl_display_dispatch_pending(c->display) < 0) {
+			return false;
+		}
+	}
+}
+
+// Refresh period reported by the compositor, or the -R fallback (headless
+// outputs may report 0 for "unknown")
+static uint64_t sample_refresh(struct client *c, uint64_t fallback_ns)
+{
+	for (int i = 0; i < c->nsamples; i++) {
+		if (c->samples[i].refresh_ns) {
+			return c->samples[i].refresh_ns;
+		}
+	}
+	return fallback_ns;
+}
+
+static bool test_fifo(struct client *c, uint64_t fallback_ns)
+{
+	memset(c->samples, 0, (size_t)c->nsamples * sizeof(*c->samples));
+	c->fifo = wp_fifo_manager_v1_get_fifo(c->fifo_manager, c->surface);
+	for (int i = 0; i < c->nsamples; i++) {
+		wp_fifo_v1_wait_barrier(c->fifo);
+		wp_fifo_v1_set_barrier(c->fifo);
+		commit_sample(c, i + 1, &c->samples[i]);
+	}
+	wl_display_flush(c->display);
+	if (!wait_samples(c)) {
+		printf("fifo: FAIL (timed out waiting for presentation feedback)\n");
+		return false;
+	}
+
+	uint64_t refresh = sample_refresh(c, fallback_ns);
+	int discarded = 0, early = 0;
+	uint64_t min_gap = UINT64_MAX;
+	for (int i = 0; i < c->nsamples; i++) {
+		struct sample *s = &c->samples[i];
+		if (s->discarded) {
+			discarded++;
+			continue;
+		}
+		if (i > 0 && !c->samples[i - 1].discarded) {
+			uint64_t prev = c->samples[i - 1].presented_ns;
+			uint64_t gap = s->presented_ns > prev ? s->presented_ns - prev : 0;
+			if (gap < min_gap) {
+				min_gap = gap;
+			}
+			// Allow for timestamp jitter of a quarter refresh
+			if (gap * 4 < refresh * 3) {
+				early++;
+			}
+		}
+	}
+	bool ok = discarded == 0 && early == 0;
+	printf("fifo: %s (%d commits, %d discarded, %d presented early, min gap %.3f ms, refresh %.3f ms)\n",
+		ok ? "ok" : "FAIL", c->nsamples, discarded, early,
+		min_gap == UINT64_MAX ? 0.0 : min_gap / 1e6, refresh / 1e6);
+	wp_fifo_v1_destroy(c->fifo);
+	c->fifo = NULL;
+	return ok;
+}
+
+static bool test_commit_timing(struct client *c, uint64_t interval_ns, uint64_t fallback_ns)
+{
+	memset(c->samples, 0, (size_t)c->nsamples * sizeof(*c->samples));
+	c->timer = wp_commit_timing_manager_v1_get_timer(c->timing_manager, c->surface);
+	uint64_t start = clock_ns(c->clock_id) + interval_ns;
+	for (int i = 0; i < c->nsamples; i++) {
+		struct sample *s = &c->samples[i];
+		s->target_ns = start + (uint64_t)i * interval_ns;
+		uint64_t sec = s->target_ns / 1000000000ull;
+		wp_commit_timer_v1_set_timestamp(c->timer, (uint32_t)(sec >> 32), (uint32_t)sec,
+			(uint32_t)(s->target_ns % 1000000000ull));
+		commit_sample(c, i + 1, s);
+	}
+	wl_display_flush(c->display);
+	if (!wait_samples(c)) {
+		printf("commit-timing: FAIL (timed out waiting for presentation feedback)\n");
+		return false;
+	}
+
+	// Early is a hard error; late only beyond a few refreshes of slack
+	uint64_t late_ns = 3 * sample_refresh(c, fallback_ns);
+	int discarded = 0, early = 0, late = 0;
+	int64_t worst = 0;
+	for (int i = 0; i < c->nsamples; i++) {
+		struct sample *s = &c->samples[i];
+		if (s->discarded) {
+			discarded++;
+			continue;
+		}
+		int64_t delta = (int64_t)(s->presented_ns - s->target_ns);
+		if (delta < 0) {
+			early++;
+		} else if ((uint64_t)delta > late_ns) {
+			late++;
+		}
+		if (delta > worst || -delta > worst) {
+			worst = delta < 0 ? -delta : delta;
+		}
+	}
+	bool ok = discarded == 0 && early == 0 && late == 0;
+	printf("commit-timing: %s (%d commits, %d discarded, %d early, %d late, worst |error| %.3f ms)\n",
+		ok ? "ok" : "FAIL", c->nsamples, discarded, early, late, worst / 1e6);
+	wp_commit_timer_v1_destroy(c->timer);
+	c->timer = NULL;
+	return ok;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-n commits] [-i interval ms] [-R fallback refresh Hz]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct client c = {
+		.clock_id = CLOCK_MONOTONIC,
+		.nsamples = 30,
+	};
+	int interval_ms = 50;
+	int fallback_hz = 60;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:i:R:h")) != -1) {
+		switch (opt) {
+		case 'n': c.nsamples = atoi(optarg); break;
+		case 'i': interval_ms = atoi(optarg); break;
+		case 'R': fallback_hz = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (c.nsamples < 2 || interval_ms <= 0 || fallback_hz <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	uint64_t fallback_ns = 1000000000ull / (uint64_t)fallback_hz;
+
+	c.display = wl_display_connect(NULL);
+	if (!c.display) {
+		fprintf(stderr, "swwm-pacing: cannot connect to Wayland display\n");
+		return 1;
+	}
+	c.registry = wl_display_get_registry(c.display);
+	wl_registry_add_listener(c.registry, &registry_listener, &c);
+	wl_display_roundtrip(c.display);
+	wl_display_roundtrip(c.display); // wp_presentation.clock_id
+	if (!c.compositor || !c.shm || !c.wm_base || !c.presentation) {
+		fprintf(stderr, "swwm-pacing: compositor lacks wl_compositor, wl_shm, xdg_wm_base or wp_presentation\n");
+		return 1;
+	}
+	if (!c.fifo_manager || !c.timing_manager) {
+		fprintf(stderr, "swwm-pacing: compositor lacks wp_fifo_manager_v1 or wp_commit_timing_manager_v1\n");
+		return 1;
+	}
+
+	c.samples = calloc((size_t)c.nsamples, sizeof(*c.samples));
+	if (!c.samples) {
+		perror("swwm-pacing: calloc");
+		return 1;
+	}
+	for (int i = 0; i < NBUFFERS; i++) {
+		if (!buffer_init(&c, &c.buffers[i], 0xff202020 + (uint32_t)i * 0x303030)) {
+			return 1;
+		}
+	}
+
+	c.surface = wl_compositor_create_surface(c.compositor);
+	c.xdg_surface = xdg_wm_base_get_xdg_surface(c.wm_base, c.surface);
+	xdg_surface_add_listener(c.xdg_surface, &xdg_surface_listener, &c);
+	c.xdg_toplevel = xdg_surface_get_toplevel(c.xdg_surface);
+	xdg_toplevel_add_listener(c.xdg_toplevel, &xdg_toplevel_listener, &c);
+	xdg_toplevel_set_title(c.xdg_toplevel, "swwm-pacing");
+	xdg_toplevel_set_app_id(c.xdg_toplevel, "swwm-pacing");
+	wl_surface_commit(c.surface); // Initial commit, no buffer
+	while (!c.configured && !c.closed) {
+		if (wl_display_dispatch(c.display) < 0) {
+			fprintf(stderr, "swwm-pacing: connection lost\n");
+			return 1;
+		}
+	}
+	wl_display_roundtrip(c.display);
+
+	bool ok = test_fifo(&c, fallback_ns);
+	ok &= test_commit_timing(&c, (uint64_t)interval_ms * 1000000ull, fallback_ns);
+
+	for (int i = 0; i < c.nsamples; i++) {
+		if (c.samples[i].feedback) {
+			wp_presentation_feedback_destroy(c.samples[i].feedback);
+		}
+	}
+	free(c.samples);
+	xdg_toplevel_destroy(c.xdg_toplevel);
+	xdg_surface_destroy(c.xdg_surface);
+	wl_surface_destroy(c.surface);
+	for (int i = 0; i < NBUFFERS; i++) {
+		buffer_finish(&c.buffers[i]);
+	}
+	wp_commit_timing_manager_v1_destroy(c.timing_manager);
+	wp_fifo_manager_v1_destroy(c.fifo_manager);
+	wp_presentation_destroy(c.presentation);
+	xdg_wm_base_destroy(c.wm_base);
+	wl_shm_destroy(c.shm);
+	wl_compositor_destroy(c.compositor);
+	wl_registry_destroy(c.registry);
+	wl_display_disconnect(c.display);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/*
+ * swwm-parsebench: time the swwmrc parser on large configs.
+ *
+ * With a config path it times parse_config_file() (open, read, parse) on that
+ * file; otherwise it generates an in-memory config of -l lines mixing
+ * comments, options, binds, calls, workspace binds, should_float entries and
+ * window rules, and times parse_config_buffer() on it. -w writes the
+ * generated config out so the same input can be fed back as a file. Each run
+ * parses into a fresh Config and frees it again, like a reload does.
+ *
+ * Usage: swwm-parsebench [-n runs] [-l lines] [-w out] [config]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parser.h"
+
+static const char *const keys[] = {
+	"a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+	"n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z",
+	"0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "Return", "space",
+	"F1", "F2", "F3", "F4", "F5", "F6", "F7", "F8", "F9", "F10",
+};
+static const char *const mods[] = { "mod", "mod + shift", "mod + ctrl", "mod + alt" };
+static const char *const calls[] = {
+	"focus_next", "focus_prev", "master_next", "master_previous",
+	"increase_gaps", "decrease_gaps", "toggle_floating", "fullscreen",
+};
+
+#define NKEYS (sizeof(keys) / sizeof(keys[0]))
+#define NMODS (sizeof(mods) / sizeof(mods[0]))
+
+struct buf {
+	char *data;
+	size_t len, cap;
+};
+
+static void buf_printf(struct buf *b, const char *fmt, ...)
+{
+	for (;;) {
+		va_list ap;
+		va_start(ap, fmt);
+		int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+		va_end(ap);
+		if (n < 0) {
+			return;
+		}
+		if ((size_t)n < b->cap - b->len) {
+			b->len += (size_t)n;
+			return;
+		}
+		size_t cap = b->cap ? b->cap * 2 : 1 << 16;
+		while (cap - b->len <= (size_t)n) {
+			cap *= 2;
+		}
+		char *data = realloc(b->data, cap);
+		if (!data) {
+			perror("swwm-parsebench: realloc");
+			exit(1);
+		}
+		b->data = data;
+		b->cap = cap;
+	}
+}
+
+// Binds cycle through NKEYS * NMODS combos, so later lines overwrite earlier
+// ones the way a generated config that layers profiles does.
+static void generate(struct buf *b, int lines)
+{
+	int binds = 0, floats = 0, rules = 0;
+	for (int i = 0; i < lines; i++) {
+		const char *key = keys[binds % NKEYS];
+		const char *mod = mods[(binds / NKEYS) % NMODS];
+		switch (i % 10) {
+		case 0:
+			buf_printf(b, "# generated section %d\n", i / 10);
+			break;
+		case 1:
+			buf_printf(b, "\n");
+			break;
+		case 2:
+		case 6:
+			buf_printf(b, "bind : %s + %s : \"foot -e sh -c 'echo %d'\"\n", mod, key, i);
+			binds++;
+			break;
+		case 3:
+		case 8:
+			buf_printf(b, "call : %s + %s : %s\n", mod, key, calls[i % (sizeof(calls) / sizeof(calls[0]))]);
+			binds++;
+			break;
+		case 4:
+			buf_printf(b, "workspace : %s + %s : %s %d\n", mod, key, (i / 10) % 2 ? "swap" : "move", i % 9 + 1);
+			binds++;
+			break;
+		case 5:
+			buf_printf(b, "gaps                    : %d # trailing comment\n", i % 20);
+			break;
+		case 7:
+			buf_printf(b, "focused_border_colour    : #%06x\n", (unsigned)(i * 2654435761u) & 0xffffff);
+			break;
+		default:
+			if (floats < 200) {
+				buf_printf(b, "should_float            : app-%d, app-%d-dialog\n", floats, floats);
+				floats += 2;
+			} else if (rules < 50) {
+				buf_printf(b, "rule : app_id=tool-%d* title=\"/^(edit|view) %d/\" : float size %dx%d\n",
+					rules, rules, 400 + rules, 300 + rules);
+				rules++;
+			} else {
+				buf_printf(b, "master_width            : %d\n", 40 + i % 30);
+			}
+			break;
+		}
+	}
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-n runs] [-l lines] [-w out] [config]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	int runs = 200;
+	int lines = 5000;
+	const char *out_path = NULL;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:l:w:h")) != -1) {
+		switch (opt) {
+		case 'n': runs = atoi(optarg); break;
+		case 'l': lines = atoi(optarg); break;
+		case 'w': out_path = optarg; break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (runs <= 0 || lines <= 0 || argc - optind > 1) {
+		usage(argv[0]);
+		return 1;
+	}
+	const char *path = optind < argc ? argv[optind] : NULL;
+
+	struct buf b = {0};
+	size_t bytes = 0;
+	long nlines = 0;
+	if (!path) {
+		generate(&b, lines);
+		bytes = b.len;
+		nlines = lines;
+		if (out_path) {
+			FILE *f = fopen(out_path, "w");
+			if (!f || fwrite(b.data, 1, b.len, f) != b.len || fclose(f) != 0) {
+				perror("swwm-parsebench: writing generated config");
+				return 1;
+			}
+		}
+	} else {
+		FILE *f = fopen(path, "r");
+		if (!f) {
+			perror("swwm-parsebench: opening config");
+			return 1;
+		}
+		int c;
+		while ((c = getc(f)) != EOF) {
+			bytes++;
+			nlines += c == '\n';
+		}
+		fclose(f);
+	}
+
+	uint64_t *samples = calloc((size_t)runs, sizeof(*samples));
+	Config *cfg = calloc(1, sizeof(*cfg));
+	if (!samples || !cfg) {
+		perror("swwm-parsebench: calloc");
+		return 1;
+	}
+	for (int i = 0; i < runs; i++) {
+		memset(cfg, 0, sizeof(*cfg));
+		cfg->modkey = SWM_MOD_LOGO;
+		uint64_t t0 = now_ns();
+		int ret = path ? parse_config_file(path, cfg) : parse_config_buffer(b.data, b.len, cfg);
+		samples[i] = now_ns() - t0;
+		if (ret != 0) {
+			fprintf(stderr, "swwm-parsebench: parse failed\n");
+			return 1;
+		}
+		if (i == runs - 1) {
+			printf("config: %ld lines, %zu bytes, %d binds, %d rules\n",
+				nlines, bytes, cfg->bindsn, cfg->rulesn);
+		}
+		config_free(cfg);
+	}
+
+	qsort(samples, (size_t)runs, sizeof(*samples), cmp_u64);
+	uint64_t median = samples[runs / 2];
+	printf("%-6s %10s %10s %10s %10s %12s %9s\n", "runs", "min", "median", "p99", "max", "lines/s", "MB/s");
+	printf("%-6d %10.3f %10.3f %10.3f %10.3f %12.0f %9.1f\n", runs,
+		samples[0] / 1e6, median / 1e6, samples[(size_t)runs * 99 / 100] / 1e6, samples[runs - 1] / 1e6,
+		median ? nlines * 1e9 / median : 0.0, median ? bytes * 1e3 / median : 0.0);
+	printf("(times in ms; rates at the median)\n");
+
+	free(samples);
+	free(cfg);
+	free(b.data);
+	return 0;
+}